@@ -0,0 +1,99 @@
+#include "alloc_audit.h"
+#include <execinfo.h>
+#include <stdio.h>
+
+// The build links with -Wl,--wrap=malloc and so on, which sends calls to
+// malloc() from our objects to __wrap_malloc(), and makes __real_malloc() the
+// actual malloc().
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+enum { Alloc_audit_max_frames = 32 };
+
+static FILE *audit_log;
+// Only the thread that called alloc_audit_begin() is watched, so the I/O
+// worker's allocations don't count against the main loop.
+static __thread bool audit_watching;
+static __thread bool audit_reporting;
+static __thread Usz audit_count;
+static __thread char const *audit_what;
+static __thread Usz audit_tick_number;
+
+void alloc_audit_open_log(char const *path) {
+  if (path)
+    audit_log = fopen(path, "a");
+  // backtrace() can load libgcc the first time it's called, which allocates.
+  // Get that out of the way now instead of in the middle of a report.
+  void *frames[1];
+  (void)backtrace(frames, 1);
+}
+
+void alloc_audit_close_log(void) {
+  if (audit_log)
+    fclose(audit_log);
+  audit_log = NULL;
+}
+
+void alloc_audit_begin(char const *what, Usz tick_number) {
+  audit_what = what;
+  audit_tick_number = tick_number;
+  audit_count = 0;
+  audit_watching = true;
+}
+
+Usz alloc_audit_end(void) {
+  audit_watching = false;
+  return audit_count;
+}
+
+ORCA_NOINLINE static void alloc_audit_report(char const *fn_name, size_t size) {
+  ++audit_count;
+  // stdio and backtrace_symbols_fd() are inside of libc, so they don't come
+  // back through here, but guard against it anyway.
+  if (audit_reporting)
+    return;
+  audit_reporting = true;
+  FILE *out = audit_log ? audit_log : stderr;
+  fprintf(out, "%s(%zu) during %s, tick %zu:\n", fn_name, size, audit_what,
+          audit_tick_number);
+  fflush(out);
+  void *frames[Alloc_audit_max_frames];
+  int count = backtrace(frames, Alloc_audit_max_frames);
+  // Skip this function. The next frame is the __wrap_ function.
+  if (count > 1)
+    backtrace_symbols_fd(frames + 1, count - 1, fileno(out));
+  fputc('\n', out);
+  fflush(out);
+  audit_reporting = false;
+}
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void __wrap_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+  if (audit_watching)
+    alloc_audit_report("malloc", size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  if (audit_watching)
+    alloc_audit_report("calloc", count * size);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  if (audit_watching)
+    alloc_audit_report("realloc", size);
+  return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+  if (audit_watching && ptr)
+    alloc_audit_report("free", 0);
+  __real_free(ptr);
+}
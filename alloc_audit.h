@@ -0,0 +1,34 @@
+#pragma once
+#include "base.h"
+
+// With `tool build --alloc-audit`, the calls that orca's own code makes to
+// malloc(), calloc(), realloc() and free() are routed through alloc_audit.c
+// by the linker. Calls made on the same thread between alloc_audit_begin()
+// and alloc_audit_end() are counted, and each one is written to the log with
+// a backtrace. This is for making sure that the parts of a tick that have to
+// keep time, like ged_do_stuff() and orca_run(), don't touch the heap once
+// they've warmed up.
+//
+// Calls made from inside of other libraries, like curses, aren't seen.
+//
+// Without --alloc-audit, these do nothing, and alloc_audit_end() returns 0.
+
+#ifdef FEAT_ALLOC_AUDIT
+// The log is appended to. If `path` is NULL, or the file can't be opened, the
+// reports go to stderr instead.
+void alloc_audit_open_log(char const *path);
+void alloc_audit_close_log(void);
+// `what` should be a string literal, and names the code being watched in the
+// reports.
+void alloc_audit_begin(char const *what, Usz tick_number);
+// Returns the number of heap calls since alloc_audit_begin().
+Usz alloc_audit_end(void);
+#else
+static inline void alloc_audit_open_log(char const *path) { (void)path; }
+static inline void alloc_audit_close_log(void) {}
+static inline void alloc_audit_begin(char const *what, Usz tick_number) {
+  (void)what;
+  (void)tick_number;
+}
+static inline Usz alloc_audit_end(void) { return 0; }
+#endif
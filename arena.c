@@ -0,0 +1,89 @@
+#include "arena.h"
+
+enum { Arena_block_min_size = 64 * 1024 };
+
+struct Arena_block {
+  Arena_block *next;
+  Usz size; // Usable bytes after the header
+};
+
+// Keeps the data after the header aligned for any type.
+typedef union {
+  Arena_block block;
+  long double ld;
+  void *p;
+  U64 u;
+} Arena_block_header;
+
+static U8 *arena_block_data(Arena_block *block) {
+  return (U8 *)block + sizeof(Arena_block_header);
+}
+
+void arena_init(Arena *arena) {
+  arena->first = NULL;
+  arena->current = NULL;
+  arena->used = 0;
+  arena->heap_calls = 0;
+}
+
+void arena_deinit(Arena *arena) {
+  Arena_block *block = arena->first;
+  while (block) {
+    Arena_block *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena_init(arena);
+}
+
+static Arena_block *arena_new_block(Arena *arena, Usz size) {
+  Usz block_size = size < Arena_block_min_size ? Arena_block_min_size : size;
+  Arena_block *block = malloc(sizeof(Arena_block_header) + block_size);
+  block->next = NULL;
+  block->size = block_size;
+  ++arena->heap_calls;
+  return block;
+}
+
+void *arena_alloc(Arena *arena, Usz size) {
+  enum { Align = sizeof(Arena_block_header) };
+  size = (size + Align - 1) / Align * Align;
+  Arena_block *block = arena->current;
+  if (block && block->size - arena->used >= size) {
+    void *result = arena_block_data(block) + arena->used;
+    arena->used += size;
+    return result;
+  }
+  // Move on to the next block that was kept from before the last reset, if
+  // it's big enough. Blocks that are too small are skipped until the reset.
+  Arena_block *prev = block;
+  Arena_block *next = block ? block->next : arena->first;
+  while (next && next->size < size) {
+    prev = next;
+    next = next->next;
+  }
+  if (!next) {
+    next = arena_new_block(arena, size);
+    if (prev)
+      prev->next = next;
+    else
+      arena->first = next;
+  }
+  arena->current = next;
+  arena->used = size;
+  return arena_block_data(next);
+}
+
+void arena_reset(Arena *arena) {
+  arena->current = arena->first;
+  arena->used = 0;
+}
+
+void arena_reserve(Arena *arena, Usz size) {
+  if (arena->first && arena->first->size >= size)
+    return;
+  // The new block goes in front, where allocations start after a reset.
+  Arena_block *block = arena_new_block(arena, size);
+  block->next = arena->first;
+  arena->first = block;
+}
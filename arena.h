@@ -0,0 +1,31 @@
+#pragma once
+#include "base.h"
+
+// Arena is a bump allocator for memory that all goes away at the same time,
+// like the scratch memory of one tick. Allocating is a pointer bump, and
+// arena_reset() frees everything at once in O(1) by rewinding to the first
+// block. The blocks are kept for reuse instead of being freed, so an arena
+// that's reset every tick stops calling malloc() once it has grown to fit the
+// busiest tick.
+//
+// `heap_calls` counts the blocks that had to be malloc'd, which is how the
+// TUI checks that playback isn't touching the heap.
+
+typedef struct Arena_block Arena_block;
+
+typedef struct {
+  Arena_block *first, *current;
+  Usz used; // Bytes used in `current`
+  Usz heap_calls;
+} Arena;
+
+void arena_init(Arena *arena);
+void arena_deinit(Arena *arena);
+// Returns `size` bytes, aligned for any type. Never returns NULL.
+void *arena_alloc(Arena *arena, Usz size);
+// Everything allocated from the arena becomes invalid.
+void arena_reset(Arena *arena);
+// Makes sure that `size` bytes can be allocated right after a reset without
+// calling malloc(), so that the first tick which needs memory doesn't have to
+// either.
+void arena_reserve(Arena *arena, Usz size);
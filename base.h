@@ -75,6 +75,11 @@ typedef ssize_t Isz;
 
 typedef char Glyph;
 typedef U8 Mark;
+// A glyph and its mark side by side, for the interleaved layout in gbuffer.h.
+typedef struct {
+  Glyph glyph;
+  Mark mark;
+} Cell;
 
 ORCA_FORCEINLINE static Usz orca_round_up_power2(Usz x) {
   assert(x <= SIZE_MAX / 2 + 1);
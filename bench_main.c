@@ -0,0 +1,726 @@
+#include "base.h"
+#include "field.h"
+#include "gbuffer.h"
+#include "operators.h"
+#include "sim.h"
+#include "sparse.h"
+#include "vmio.h"
+#include <getopt.h>
+#include <time.h>
+
+static ORCA_NOINLINE void usage(void) { // clang-format off
+fprintf(stderr,
+"Usage: bench [options] infile...\n"
+"       bench --operators [options]\n\n"
+"Runs each .orca file for a number of ticks and reports how long the\n"
+"ticks took. For example:\n"
+"    build/bench examples/benchmarks/*.orca\n\n"
+"With --operators, no files are read. Instead, each operator is measured\n"
+"on its own, on a grid packed with copies of it.\n\n"
+"Options:\n"
+"    -t <number>   Number of ticks to measure.\n"
+"                  Default: 1000\n"
+"    -w <number>   Number of ticks to run before measuring.\n"
+"                  Default: 100\n"
+"    --size <height>x<width>\n"
+"                  Repeat each file's grid to fill a grid of this size,\n"
+"                  like 256x1024. Default: the file's own size.\n"
+"    --layout <name>\n"
+"                  How the grid is stored while simulating: dense, tiled,\n"
+"                  interleaved or sparse. See cli --help.\n"
+"                  Default: dense\n"
+"    --operators   Measure each operator, in each of its forms, on a grid\n"
+"                  packed with it. --size sets the grid size.\n"
+"                  Default size: 128x256\n"
+"    --json <file> Also write the results to this file as JSON. Use - for\n"
+"                  stdout, in which case the table isn't printed.\n"
+"    -h or --help  Print this message and exit.\n"
+"\n"
+"For each file, the time per tick, the number of output events per tick,\n"
+"and the number of operators on the grid per tick are measured, and their\n"
+"minimum, median, 99th percentile and mean are reported. Cells/s and ops/s\n"
+"are from the median time per tick.\n"
+"\n"
+"For --operators, each operator is in a stamp like 112X345, with typical\n"
+"arguments on both sides. Letters are measured in uppercase (plain), in\n"
+"lowercase without a bang (idle), and in lowercase with a '*' above them\n"
+"(banged). The other operators are measured plain and banged. The grid is\n"
+"restored before every tick, outside of the timing. The median time per\n"
+"tick is divided by the number of operators, both when running only the\n"
+"operator cells (isolated), and when running the tick with orca_run(),\n"
+"which also walks past the arguments and the empty cells. Times are in\n"
+"TSC cycles on x86, and in nanoseconds elsewhere.\n"
+);} // clang-format on
+
+typedef enum {
+  Layout_dense,
+  Layout_tiled,
+  Layout_interleaved,
+  Layout_sparse,
+} Layout;
+
+static char const *const layout_names[] = {"dense", "tiled", "interleaved",
+                                           "sparse"};
+
+// The grid in whichever layout is being measured. Only the members for that
+// layout are used.
+typedef struct {
+  Layout layout;
+  Usz height, width;
+  Field field;
+  Mark *mbuf;
+  Glyph *tiled_gbuf;
+  Mark *tiled_mbuf;
+  Usz tiled_cells;
+  Cell *cbuf;
+  Sparse_field sfield;
+} Bench_grid;
+
+// Copies of `src` repeated to fill `dest`, starting from the top left.
+static void bench_fill_with_repeats(Field const *src, Field *dest) {
+  for (Usz y = 0; y < dest->height; ++y) {
+    Glyph const *src_row = src->buffer + (y % src->height) * src->stride;
+    Glyph *dest_row = dest->buffer + y * dest->stride;
+    for (Usz x = 0; x < dest->width; ++x)
+      dest_row[x] = src_row[x % src->width];
+  }
+}
+
+static void bench_grid_init(Bench_grid *bg, Layout layout, Field *field) {
+  Usz height = field->height, width = field->width;
+  bg->layout = layout;
+  bg->height = height;
+  bg->width = width;
+  bg->field = *field;
+  field_init(field);
+  bg->mbuf = malloc(height * width * sizeof(Mark));
+  bg->tiled_gbuf = NULL;
+  bg->tiled_mbuf = NULL;
+  bg->tiled_cells = 0;
+  bg->cbuf = NULL;
+  sparse_field_init(&bg->sfield);
+  mbuffer_clear(bg->mbuf, height, width);
+  switch (layout) {
+  case Layout_dense:
+    break;
+  case Layout_tiled:
+    bg->tiled_cells = gbuffer_tiled_cells(height, width);
+    bg->tiled_gbuf = malloc(bg->tiled_cells * sizeof(Glyph));
+    bg->tiled_mbuf = malloc(bg->tiled_cells * sizeof(Mark));
+    gbuffer_to_tiled(bg->field.buffer, height, width, bg->field.stride,
+                     bg->tiled_gbuf);
+    break;
+  case Layout_interleaved:
+    bg->cbuf = malloc(height * width * sizeof(Cell));
+    cbuffer_interleave(bg->field.buffer, bg->mbuf, height, width,
+                       bg->field.stride, bg->cbuf);
+    break;
+  case Layout_sparse:
+    sparse_field_reset(&bg->sfield, height, width);
+    for (Usz y = 0; y < height; ++y) {
+      for (Usz x = 0; x < width; ++x) {
+        Glyph g = bg->field.buffer[y * bg->field.stride + x];
+        if (g != '.')
+          sparse_field_poke(&bg->sfield, y, x, g);
+      }
+    }
+    break;
+  }
+}
+
+static void bench_grid_deinit(Bench_grid *bg) {
+  field_deinit(&bg->field);
+  free(bg->mbuf);
+  free(bg->tiled_gbuf);
+  free(bg->tiled_mbuf);
+  free(bg->cbuf);
+  sparse_field_deinit(&bg->sfield);
+}
+
+// One tick, including clearing the marks, which every layout has to do.
+static void bench_grid_tick(Bench_grid *bg, Usz tick_number,
+                            Oevent_list *oevent_list) {
+  Usz height = bg->height, width = bg->width;
+  switch (bg->layout) {
+  case Layout_dense:
+    mbuffer_clear(bg->mbuf, height, width);
+    orca_run(bg->field.buffer, bg->mbuf, height, width, tick_number,
+             oevent_list, 0);
+    break;
+  case Layout_tiled:
+    mbuffer_clear(bg->tiled_mbuf, 1, bg->tiled_cells);
+    orca_run_tiled(bg->tiled_gbuf, bg->tiled_mbuf, height, width, tick_number,
+                   oevent_list, 0);
+    break;
+  case Layout_interleaved:
+    cbuffer_clear_marks(bg->cbuf, height, width);
+    orca_run_interleaved(bg->cbuf, height, width, tick_number, oevent_list, 0);
+    break;
+  case Layout_sparse:
+    orca_run_sparse(&bg->sfield, tick_number, oevent_list, 0);
+    break;
+  }
+}
+
+static bool glyph_is_operator(Glyph g) {
+  switch (g) {
+  case '!':
+  case '#':
+  case '%':
+  case '*':
+  case ':':
+  case ';':
+  case '=':
+  case '?':
+    return true;
+  }
+  return (g >= 'A' && g <= 'Z') || (g >= 'a' && g <= 'z');
+}
+
+static Usz count_operators(Glyph const *gbuf, Usz count, Usz step) {
+  Usz n = 0;
+  for (Usz i = 0; i < count; ++i)
+    n += glyph_is_operator(gbuf[i * step]);
+  return n;
+}
+
+// The number of operator glyphs on the grid. Lowercase letters are counted
+// even though they only run when banged, so this is an upper bound on how
+// many operators a tick runs.
+static Usz bench_grid_operators(Bench_grid const *bg) {
+  switch (bg->layout) {
+  case Layout_dense:
+    return count_operators(bg->field.buffer, bg->height * bg->width, 1);
+  case Layout_tiled:
+    return count_operators(bg->tiled_gbuf, bg->tiled_cells, 1);
+  case Layout_interleaved:
+    return count_operators(&bg->cbuf->glyph, bg->height * bg->width,
+                           sizeof(Cell));
+  case Layout_sparse: {
+    Usz n = 0;
+    Usz tile_rows =
+        (bg->height + Sparse_tile_size - 1) >> Sparse_tile_shift;
+    for (Usz ty = 0; ty < tile_rows; ++ty) {
+      Sparse_tile_row const *row = bg->sfield.rows + ty;
+      for (Usz i = 0; i < row->count; ++i)
+        n += count_operators(row->tiles[i]->glyphs, Sparse_tile_cells, 1);
+    }
+    return n;
+  }
+  }
+  return 0;
+}
+
+static U64 bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (U64)ts.tv_sec * UINT64_C(1000000000) + (U64)ts.tv_nsec;
+}
+
+typedef struct {
+  double min, median, p99, mean;
+} Bench_stats;
+
+static int bench_compare_u64(void const *a, void const *b) {
+  U64 x = *(U64 const *)a, y = *(U64 const *)b;
+  return (x > y) - (x < y);
+}
+
+// Sorts `values` in place. Percentiles are nearest-rank.
+static Bench_stats bench_stats_of(U64 *values, Usz count) {
+  Bench_stats st = {0, 0, 0, 0};
+  if (count == 0)
+    return st;
+  qsort(values, count, sizeof(U64), bench_compare_u64);
+  double sum = 0;
+  for (Usz i = 0; i < count; ++i)
+    sum += (double)values[i];
+  st.min = (double)values[0];
+  st.median = (double)values[(count - 1) / 2];
+  st.p99 = (double)values[(count * 99 + 99) / 100 - 1];
+  st.mean = sum / (double)count;
+  return st;
+}
+
+typedef struct {
+  char const *file;
+  Usz height, width;
+  Bench_stats ns_per_tick, events_per_tick, operators_per_tick;
+  double cells_per_sec, ops_per_sec;
+} Bench_result;
+
+static void bench_run(Bench_grid *bg, Usz warmup_ticks, Usz ticks,
+                      Bench_result *out) {
+  Oevent_list oevent_list;
+  oevent_list_init(&oevent_list);
+  U64 *ns = malloc(ticks * sizeof(U64));
+  U64 *events = malloc(ticks * sizeof(U64));
+  U64 *operators = malloc(ticks * sizeof(U64));
+  for (Usz i = 0; i < warmup_ticks; ++i) {
+    oevent_list_clear(&oevent_list);
+    bench_grid_tick(bg, i, &oevent_list);
+  }
+  for (Usz i = 0; i < ticks; ++i) {
+    operators[i] = bench_grid_operators(bg);
+    oevent_list_clear(&oevent_list);
+    U64 start = bench_now_ns();
+    bench_grid_tick(bg, warmup_ticks + i, &oevent_list);
+    ns[i] = bench_now_ns() - start;
+    events[i] = oevent_list.count;
+  }
+  out->height = bg->height;
+  out->width = bg->width;
+  out->ns_per_tick = bench_stats_of(ns, ticks);
+  out->events_per_tick = bench_stats_of(events, ticks);
+  out->operators_per_tick = bench_stats_of(operators, ticks);
+  double median_secs = out->ns_per_tick.median / 1e9;
+  if (median_secs > 0) {
+    out->cells_per_sec = (double)(bg->height * bg->width) / median_secs;
+    out->ops_per_sec = out->operators_per_tick.mean / median_secs;
+  } else {
+    out->cells_per_sec = out->ops_per_sec = 0;
+  }
+  free(ns);
+  free(events);
+  free(operators);
+  oevent_list_deinit(&oevent_list);
+}
+
+static void bench_print_table_header(void) {
+  printf("%-24s %11s %10s %10s %10s %9s %9s %7s\n", "file", "size",
+         "min ns", "median ns", "p99 ns", "Mcells/s", "Mops/s", "ev/tick");
+}
+
+static void bench_print_table_row(Bench_result const *r) {
+  char const *name = strrchr(r->file, '/');
+  name = name ? name + 1 : r->file;
+  char size[32];
+  snprintf(size, sizeof size, "%zux%zu", r->height, r->width);
+  printf("%-24s %11s %10.0f %10.0f %10.0f %9.1f %9.1f %7.1f\n", name, size,
+         r->ns_per_tick.min, r->ns_per_tick.median, r->ns_per_tick.p99,
+         r->cells_per_sec / 1e6, r->ops_per_sec / 1e6,
+         r->events_per_tick.mean);
+}
+
+static void bench_json_string(FILE *f, char const *s) {
+  fputc('"', f);
+  for (; *s; ++s) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+static void bench_json_stats(FILE *f, char const *name, Bench_stats const *st) {
+  fprintf(f,
+          "      \"%s\": {\"min\": %.1f, \"median\": %.1f, \"p99\": %.1f, "
+          "\"mean\": %.1f},\n",
+          name, st->min, st->median, st->p99, st->mean);
+}
+
+static void bench_write_json(FILE *f, Layout layout, Usz warmup_ticks,
+                             Usz ticks, Bench_result const *results,
+                             Usz count) {
+  fprintf(f, "{\n  \"layout\": \"%s\",\n  \"warmup_ticks\": %zu,\n"
+             "  \"ticks\": %zu,\n  \"benchmarks\": [\n",
+          layout_names[layout], warmup_ticks, ticks);
+  for (Usz i = 0; i < count; ++i) {
+    Bench_result const *r = results + i;
+    fprintf(f, "    {\n      \"file\": ");
+    bench_json_string(f, r->file);
+    fprintf(f, ",\n      \"height\": %zu,\n      \"width\": %zu,\n", r->height,
+            r->width);
+    bench_json_stats(f, "ns_per_tick", &r->ns_per_tick);
+    bench_json_stats(f, "events_per_tick", &r->events_per_tick);
+    bench_json_stats(f, "operators_per_tick", &r->operators_per_tick);
+    fprintf(f,
+            "      \"cells_per_sec\": %.0f,\n      \"ops_per_sec\": %.0f\n"
+            "    }%s\n",
+            r->cells_per_sec, r->ops_per_sec, i + 1 < count ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+// Cycles from the time stamp counter on x86. It ticks at a fixed rate on
+// recent CPUs, which may not be the core clock, but it's cheaper and finer
+// than clock_gettime() for timing a single tick of a small grid.
+#if defined(__x86_64__) || defined(__i386__)
+#define BENCH_CYCLE_UNIT "cycles"
+static U64 bench_cycles(void) { return __builtin_ia32_rdtsc(); }
+#else
+#define BENCH_CYCLE_UNIT "ns"
+static U64 bench_cycles(void) { return bench_now_ns(); }
+#endif
+
+typedef enum {
+  Oper_form_plain,  // Uppercase, or a non-letter without a bang
+  Oper_form_idle,   // Lowercase without a bang, so it only looks for one
+  Oper_form_banged, // With a '*' above it
+} Oper_form;
+
+static char const *const oper_form_names[] = {"plain", "idle", "banged"};
+
+typedef struct {
+  Glyph glyph;
+  char const *name;
+} Bench_oper;
+
+#define BENCH_OPER(_oper_char, _oper_name) {_oper_char, #_oper_name},
+static Bench_oper const bench_opers[] = {
+    UNIQUE_OPERATORS(BENCH_OPER) ALPHA_OPERATORS(BENCH_OPER)};
+#undef BENCH_OPER
+
+enum {
+  Oper_stamp_height = 4,
+  Oper_stamp_width = 8,
+  Oper_stamp_x = 3, // Column of the operator in its stamp
+};
+
+typedef struct {
+  Glyph glyph;
+  char const *name;
+  Oper_form form;
+  double isolated, via_orca_run; // Median per operator, in BENCH_CYCLE_UNIT
+  double events_per_tick;
+} Oper_result;
+
+// Fills the grid with stamps of the operator. Row 0 of a stamp has the bang,
+// if there is one, row 1 the operator and its arguments, and rows 2 and 3 are
+// left empty for its outputs. The bangs are marked as sleeping, like a bang
+// that was just output, so that they're still there when the operator below
+// them runs. Returns the number of operators, and writes their indices to
+// `cells`.
+static Usz bench_oper_stamp(Glyph *gbuf, Mark *mbuf, Usz height, Usz width,
+                            Glyph glyph, Oper_form form, Usz *cells) {
+  // MIDI operators need a note letter. The rest take any digits.
+  char const *left = "112";
+  char const *right = glyph == ':' || glyph == '%' ? "04C" : "345";
+  bool is_letter = glyph >= 'A' && glyph <= 'Z';
+  if (form != Oper_form_plain && is_letter)
+    glyph = (Glyph)(glyph - 'A' + 'a');
+  memset(gbuf, '.', height * width);
+  memset(mbuf, 0, height * width);
+  Usz count = 0;
+  for (Usz sy = 0; sy + Oper_stamp_height <= height;
+       sy += Oper_stamp_height) {
+    for (Usz sx = 0; sx + Oper_stamp_width <= width; sx += Oper_stamp_width) {
+      Usz oper_i = (sy + 1) * width + sx + Oper_stamp_x;
+      memcpy(gbuf + oper_i - 3, left, 3);
+      gbuf[oper_i] = glyph;
+      memcpy(gbuf + oper_i + 1, right, 3);
+      if (form == Oper_form_banged) {
+        gbuf[oper_i - width] = '*';
+        mbuf[oper_i - width] = Mark_flag_sleep;
+      }
+      cells[count++] = oper_i;
+    }
+  }
+  return count;
+}
+
+static void bench_oper_run(Usz height, Usz width, Usz warmup_ticks,
+                           Usz ticks, Oper_result *out) {
+  Usz cell_count = height * width;
+  Glyph *pristine_gbuf = malloc(cell_count * sizeof(Glyph));
+  Mark *pristine_mbuf = malloc(cell_count * sizeof(Mark));
+  Glyph *gbuf = malloc(cell_count * sizeof(Glyph));
+  Mark *mbuf = malloc(cell_count * sizeof(Mark));
+  Usz *cells = malloc(cell_count * sizeof(Usz));
+  U64 *isolated = malloc(ticks * sizeof(U64));
+  U64 *via_orca_run = malloc(ticks * sizeof(U64));
+  Usz oper_count = bench_oper_stamp(pristine_gbuf, pristine_mbuf, height,
+                                    width, out->glyph, out->form, cells);
+  Oevent_list oevent_list;
+  oevent_list_init(&oevent_list);
+  Usz events = 0;
+  for (Usz i = 0; i < warmup_ticks + ticks; ++i) {
+    memcpy(gbuf, pristine_gbuf, cell_count * sizeof(Glyph));
+    memcpy(mbuf, pristine_mbuf, cell_count * sizeof(Mark));
+    oevent_list_clear(&oevent_list);
+    U64 start = bench_cycles();
+    orca_run_cells(gbuf, mbuf, height, width, cells, oper_count, i,
+                   &oevent_list, 0);
+    U64 isolated_time = bench_cycles() - start;
+    memcpy(gbuf, pristine_gbuf, cell_count * sizeof(Glyph));
+    memcpy(mbuf, pristine_mbuf, cell_count * sizeof(Mark));
+    oevent_list_clear(&oevent_list);
+    start = bench_cycles();
+    orca_run(gbuf, mbuf, height, width, i, &oevent_list, 0);
+    U64 orca_run_time = bench_cycles() - start;
+    if (i < warmup_ticks)
+      continue;
+    isolated[i - warmup_ticks] = isolated_time;
+    via_orca_run[i - warmup_ticks] = orca_run_time;
+    events += oevent_list.count;
+  }
+  double per_oper = oper_count ? 1.0 / (double)oper_count : 0;
+  out->isolated = bench_stats_of(isolated, ticks).median * per_oper;
+  out->via_orca_run = bench_stats_of(via_orca_run, ticks).median * per_oper;
+  out->events_per_tick = (double)events / (double)ticks;
+  oevent_list_deinit(&oevent_list);
+  free(pristine_gbuf);
+  free(pristine_mbuf);
+  free(gbuf);
+  free(mbuf);
+  free(cells);
+  free(isolated);
+  free(via_orca_run);
+}
+
+static void bench_oper_print_table_header(Usz height, Usz width,
+                                          Usz oper_count) {
+  printf("Median " BENCH_CYCLE_UNIT " per operator, on a %zux%zu grid with "
+         "%zu operators.\n",
+         height, width, oper_count);
+  printf("%-2s %-10s %-7s %10s %10s %7s\n", "op", "name", "form", "isolated",
+         "orca_run", "ev/tick");
+}
+
+static void bench_oper_print_table_row(Oper_result const *r) {
+  printf("%-2c %-10s %-7s %10.1f %10.1f %7.1f\n", r->glyph, r->name,
+         oper_form_names[r->form], r->isolated, r->via_orca_run,
+         r->events_per_tick);
+}
+
+static void bench_oper_write_json(FILE *f, Usz height, Usz width,
+                                  Usz oper_count, Usz warmup_ticks, Usz ticks,
+                                  Oper_result const *results, Usz count) {
+  fprintf(f,
+          "{\n  \"unit\": \"" BENCH_CYCLE_UNIT "\",\n  \"height\": %zu,\n"
+          "  \"width\": %zu,\n  \"operators_per_tick\": %zu,\n"
+          "  \"warmup_ticks\": %zu,\n  \"ticks\": %zu,\n  \"operators\": [\n",
+          height, width, oper_count, warmup_ticks, ticks);
+  for (Usz i = 0; i < count; ++i) {
+    Oper_result const *r = results + i;
+    char glyph_str[2] = {r->glyph, '\0'};
+    fprintf(f, "    {\"op\": ");
+    bench_json_string(f, glyph_str);
+    fprintf(f,
+            ", \"name\": \"%s\", \"form\": \"%s\", \"isolated\": %.2f, "
+            "\"orca_run\": %.2f, \"events_per_tick\": %.1f}%s\n",
+            r->name, oper_form_names[r->form], r->isolated, r->via_orca_run,
+            r->events_per_tick, i + 1 < count ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+static int bench_operators(Usz height, Usz width, Usz warmup_ticks, Usz ticks,
+                           char const *json_file) {
+  if (height < Oper_stamp_height || width < Oper_stamp_width) {
+    fprintf(stderr, "Grid must be at least %dx%d for --operators.\n",
+            Oper_stamp_height, Oper_stamp_width);
+    return 1;
+  }
+  Usz oper_count =
+      (height / Oper_stamp_height) * (width / Oper_stamp_width);
+  bool print_table = !json_file || strcmp(json_file, "-") != 0;
+  Oper_result *results =
+      calloc(ORCA_ARRAY_COUNTOF(bench_opers) * 3, sizeof(Oper_result));
+  Usz result_count = 0;
+  if (print_table)
+    bench_oper_print_table_header(height, width, oper_count);
+  for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(bench_opers); ++i) {
+    for (Usz form = 0; form < ORCA_ARRAY_COUNTOF(oper_form_names); ++form) {
+      Glyph g = bench_opers[i].glyph;
+      if (form == Oper_form_idle && !(g >= 'A' && g <= 'Z'))
+        continue;
+      Oper_result *r = results + result_count++;
+      r->glyph = g;
+      r->name = bench_opers[i].name;
+      r->form = (Oper_form)form;
+      bench_oper_run(height, width, warmup_ticks, ticks, r);
+      if (print_table) {
+        bench_oper_print_table_row(r);
+        fflush(stdout);
+      }
+    }
+  }
+  int exit_code = 0;
+  if (json_file) {
+    bool to_stdout = strcmp(json_file, "-") == 0;
+    FILE *f = to_stdout ? stdout : fopen(json_file, "w");
+    if (f) {
+      bench_oper_write_json(f, height, width, oper_count, warmup_ticks, ticks,
+                            results, result_count);
+      if (!to_stdout)
+        fclose(f);
+    } else {
+      fprintf(stderr, "Can't open %s for writing.\n", json_file);
+      exit_code = 1;
+    }
+  }
+  free(results);
+  return exit_code;
+}
+
+static bool read_grid_size(char const *str, Usz *out_height, Usz *out_width) {
+  unsigned long h, w;
+  char x;
+  if (sscanf(str, "%lu%c%lu", &h, &x, &w) != 3 || x != 'x')
+    return false;
+  if (h == 0 || w == 0 || h > ORCA_Y_MAX || w > ORCA_X_MAX)
+    return false;
+  *out_height = (Usz)h;
+  *out_width = (Usz)w;
+  return true;
+}
+
+static bool read_count(char const *str, Usz *out) {
+  char *end;
+  long n = strtol(str, &end, 10);
+  if (end == str || *end != '\0' || n < 0)
+    return false;
+  *out = (Usz)n;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  enum { Opt_size = 256, Opt_layout, Opt_operators, Opt_json };
+  static struct option bench_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"size", required_argument, 0, Opt_size},
+      {"layout", required_argument, 0, Opt_layout},
+      {"operators", no_argument, 0, Opt_operators},
+      {"json", required_argument, 0, Opt_json},
+      {NULL, 0, NULL, 0}};
+
+  Usz ticks = 1000, warmup_ticks = 100;
+  Usz size_h = 0, size_w = 0;
+  Layout layout = Layout_dense;
+  bool operators = false;
+  char const *json_file = NULL;
+
+  for (;;) {
+    int c = getopt_long(argc, argv, "t:w:h", bench_options, NULL);
+    if (c == -1)
+      break;
+    switch (c) {
+    case 't':
+      if (!read_count(optarg, &ticks) || ticks == 0) {
+        fprintf(stderr, "Bad tick count %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case 'w':
+      if (!read_count(optarg, &warmup_ticks)) {
+        fprintf(stderr, "Bad warm-up tick count %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case Opt_size:
+      if (!read_grid_size(optarg, &size_h, &size_w)) {
+        fprintf(stderr,
+                "Bad size argument %s.\n"
+                "Must be <height>x<width>, like 256x1024.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case Opt_layout: {
+      bool found = false;
+      for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(layout_names); ++i) {
+        if (strcmp(optarg, layout_names[i]) == 0) {
+          layout = (Layout)i;
+          found = true;
+        }
+      }
+      if (!found) {
+        fprintf(stderr,
+                "Bad layout argument %s.\n"
+                "Must be dense, tiled, interleaved or sparse.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    }
+    case Opt_operators:
+      operators = true;
+      break;
+    case Opt_json:
+      json_file = optarg;
+      break;
+    case 'h':
+      usage();
+      return 0;
+    case '?':
+      usage();
+      return 1;
+    }
+  }
+  if (operators) {
+    if (optind != argc) {
+      fprintf(stderr, "--operators doesn't take input files.\n");
+      return 1;
+    }
+    if (layout != Layout_dense) {
+      fprintf(stderr, "--operators only measures the dense layout.\n");
+      return 1;
+    }
+    if (size_h == 0) {
+      size_h = 128;
+      size_w = 256;
+    }
+    return bench_operators(size_h, size_w, warmup_ticks, ticks, json_file);
+  }
+  if (optind == argc) {
+    fprintf(stderr, "No input files.\n");
+    usage();
+    return 1;
+  }
+
+  bool print_table = !json_file || strcmp(json_file, "-") != 0;
+  Usz file_count = (Usz)(argc - optind);
+  Bench_result *results = calloc(file_count, sizeof(Bench_result));
+  Usz result_count = 0;
+  int exit_code = 0;
+  if (print_table)
+    bench_print_table_header();
+  for (Usz i = 0; i < file_count; ++i) {
+    char const *file = argv[optind + (int)i];
+    Field field;
+    field_init(&field);
+    Field_load_error fle = field_load_file(file, &field);
+    if (fle != Field_load_error_ok) {
+      field_deinit(&field);
+      fprintf(stderr, "%s: %s.\n", file, field_load_error_string(fle));
+      exit_code = 1;
+      continue;
+    }
+    if (size_h != 0) {
+      Field repeated;
+      field_init_fill(&repeated, size_h, size_w, '.');
+      bench_fill_with_repeats(&field, &repeated);
+      field_deinit(&field);
+      field = repeated;
+    }
+    Bench_grid bg;
+    bench_grid_init(&bg, layout, &field);
+    Bench_result *r = results + result_count++;
+    r->file = file;
+    bench_run(&bg, warmup_ticks, ticks, r);
+    bench_grid_deinit(&bg);
+    if (print_table) {
+      bench_print_table_row(r);
+      fflush(stdout);
+    }
+  }
+  if (json_file) {
+    bool to_stdout = strcmp(json_file, "-") == 0;
+    FILE *f = to_stdout ? stdout : fopen(json_file, "w");
+    if (f) {
+      bench_write_json(f, layout, warmup_ticks, ticks, results, result_count);
+      if (!to_stdout)
+        fclose(f);
+    } else {
+      fprintf(stderr, "Can't open %s for writing.\n", json_file);
+      exit_code = 1;
+    }
+  }
+  free(results);
+  return exit_code;
+}
@@ -0,0 +1,269 @@
+#include "checkpoint.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+enum {
+  Ckpt_header_size = 64,
+  Ckpt_susnote_size = 6,
+  Ckpt_header_crc_offset = 60,
+};
+
+static char const ckpt_magic[8] = {'O', 'R', 'C', 'A', 'S', 'N', 'A', 'P'};
+
+static void ckpt_put_u16(U8 *p, U16 v) {
+  p[0] = (U8)v;
+  p[1] = (U8)(v >> 8);
+}
+static void ckpt_put_u32(U8 *p, U32 v) {
+  for (Usz i = 0; i < 4; ++i)
+    p[i] = (U8)(v >> (i * 8));
+}
+static void ckpt_put_u64(U8 *p, U64 v) {
+  for (Usz i = 0; i < 8; ++i)
+    p[i] = (U8)(v >> (i * 8));
+}
+static U16 ckpt_get_u16(U8 const *p) { return (U16)(p[0] | p[1] << 8); }
+static U32 ckpt_get_u32(U8 const *p) {
+  U32 v = 0;
+  for (Usz i = 0; i < 4; ++i)
+    v |= (U32)p[i] << (i * 8);
+  return v;
+}
+static U64 ckpt_get_u64(U8 const *p) {
+  U64 v = 0;
+  for (Usz i = 0; i < 8; ++i)
+    v |= (U64)p[i] << (i * 8);
+  return v;
+}
+
+// Adler-32, the same checksum used by zlib. The modulo is only taken once
+// every Nmax bytes, which is the most that can be summed without overflowing.
+static U32 ckpt_adler32(U8 const *data, Usz size) {
+  enum { Base = 65521, Nmax = 5552 };
+  U32 a = 1, b = 0;
+  while (size > 0) {
+    Usz n = size < Nmax ? size : Nmax;
+    size -= n;
+    for (Usz i = 0; i < n; ++i) {
+      a += data[i];
+      b += a;
+    }
+    data += n;
+    a %= Base;
+    b %= Base;
+  }
+  return b << 16 | a;
+}
+
+Checkpoint_error checkpoint_save(char const *filepath, Field const *field,
+                                 Mark const *mbuf,
+                                 Susnote_list const *susnote_list,
+                                 Checkpoint_vars const *vars) {
+  Usz cells = (Usz)field->height * (Usz)field->width;
+  Usz sn_count = susnote_list ? susnote_list->count : 0;
+  U8 *sn_bytes = NULL;
+  if (sn_count > 0) {
+    sn_bytes = malloc(sn_count * Ckpt_susnote_size);
+    for (Usz i = 0; i < sn_count; ++i) {
+      Susnote sn = susnote_list->buffer[i];
+      U32 bits;
+      memcpy(&bits, &sn.remaining, sizeof bits);
+      ckpt_put_u32(sn_bytes + i * Ckpt_susnote_size, bits);
+      ckpt_put_u16(sn_bytes + i * Ckpt_susnote_size + 4, sn.chan_note);
+    }
+  }
+  Glyph const *glyphs = field->buffer;
+  Mark const *marks = mbuf;
+  U8 *packed = NULL;
+  if (field->stride != field->width) {
+    packed = malloc(2 * cells);
+    for (Usz iy = 0; iy < field->height; ++iy) {
+      memcpy(packed + iy * field->width, glyphs + iy * field->stride,
+             field->width);
+      memcpy(packed + cells + iy * field->width, marks + iy * field->stride,
+             field->width);
+    }
+    glyphs = (Glyph const *)packed;
+    marks = packed + cells;
+  }
+  U8 header[Ckpt_header_size];
+  memcpy(header, ckpt_magic, sizeof ckpt_magic);
+  ckpt_put_u32(header + 8, Checkpoint_version);
+  ckpt_put_u32(header + 12, Ckpt_header_size);
+  ckpt_put_u16(header + 16, field->height);
+  ckpt_put_u16(header + 18, field->width);
+  ckpt_put_u32(header + 20, (U32)sn_count);
+  ckpt_put_u64(header + 24, vars->tick_num);
+  ckpt_put_u64(header + 32, vars->random_seed);
+  ckpt_put_u64(header + 40, vars->bpm);
+  ckpt_put_u32(header + 48, ckpt_adler32((U8 const *)glyphs, cells));
+  ckpt_put_u32(header + 52, ckpt_adler32(marks, cells));
+  ckpt_put_u32(header + 56,
+               ckpt_adler32(sn_bytes, sn_count * Ckpt_susnote_size));
+  ckpt_put_u32(header + Ckpt_header_crc_offset,
+               ckpt_adler32(header, Ckpt_header_crc_offset));
+
+  Checkpoint_error err = Checkpoint_error_ok;
+  int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    err = Checkpoint_error_cant_open_file;
+    goto done;
+  }
+  struct iovec iov[4] = {
+      {.iov_base = header, .iov_len = Ckpt_header_size},
+      {.iov_base = (void *)glyphs, .iov_len = cells},
+      {.iov_base = (void *)marks, .iov_len = cells},
+      {.iov_base = sn_bytes, .iov_len = sn_count * Ckpt_susnote_size},
+  };
+  // One writev() normally writes everything. If it comes up short (large
+  // files, signals), advance through the iovecs and keep going.
+  struct iovec *cur = iov;
+  int iovcnt = (int)ORCA_ARRAY_COUNTOF(iov);
+  while (iovcnt > 0) {
+    ssize_t n = writev(fd, cur, iovcnt);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      err = Checkpoint_error_write_failed;
+      break;
+    }
+    Usz written = (Usz)n;
+    while (iovcnt > 0 && written >= cur->iov_len) {
+      written -= cur->iov_len;
+      ++cur;
+      --iovcnt;
+    }
+    if (iovcnt > 0) {
+      cur->iov_base = (U8 *)cur->iov_base + written;
+      cur->iov_len -= written;
+    }
+  }
+  if (close(fd) != 0 && err == Checkpoint_error_ok)
+    err = Checkpoint_error_write_failed;
+done:
+  free(packed);
+  free(sn_bytes);
+  return err;
+}
+
+static Checkpoint_error ckpt_parse(U8 const *data, Usz size, Field *field,
+                                   Mbuf_reusable *mbuf_r,
+                                   Susnote_list *susnote_list,
+                                   Checkpoint_vars *vars) {
+  if (size < sizeof ckpt_magic || memcmp(data, ckpt_magic, sizeof ckpt_magic))
+    return Checkpoint_error_not_a_checkpoint;
+  if (size < Ckpt_header_size)
+    return Checkpoint_error_truncated;
+  U32 version = ckpt_get_u32(data + 8);
+  if (version == 0 || version > Checkpoint_version)
+    return Checkpoint_error_unsupported_version;
+  if (ckpt_get_u32(data + Ckpt_header_crc_offset) !=
+      ckpt_adler32(data, Ckpt_header_crc_offset))
+    return Checkpoint_error_checksum_mismatch;
+  Usz header_size = ckpt_get_u32(data + 12);
+  Usz height = ckpt_get_u16(data + 16);
+  Usz width = ckpt_get_u16(data + 18);
+  Usz sn_count = ckpt_get_u32(data + 20);
+  if (header_size < Ckpt_header_size)
+    return Checkpoint_error_truncated;
+  if (height == 0 || width == 0)
+    return Checkpoint_error_bad_dimensions;
+  Usz cells = height * width;
+  Usz sn_size = sn_count * Ckpt_susnote_size;
+  if (size < header_size || (size - header_size) / 2 < cells ||
+      size - header_size - 2 * cells != sn_size)
+    return Checkpoint_error_truncated;
+  U8 const *glyphs = data + header_size;
+  U8 const *marks = glyphs + cells;
+  U8 const *susnotes = marks + cells;
+  if (ckpt_get_u32(data + 48) != ckpt_adler32(glyphs, cells) ||
+      ckpt_get_u32(data + 52) != ckpt_adler32(marks, cells) ||
+      ckpt_get_u32(data + 56) != ckpt_adler32(susnotes, sn_size))
+    return Checkpoint_error_checksum_mismatch;
+
+  field_resize_raw(field, height, width);
+  memcpy(field->buffer, glyphs, cells);
+  mbuf_reusable_ensure_size(mbuf_r, height, width);
+  memcpy(mbuf_r->buffer, marks, cells);
+  if (susnote_list) {
+    if (susnote_list->capacity < sn_count) {
+      susnote_list->buffer =
+          realloc(susnote_list->buffer, sn_count * sizeof(Susnote));
+      susnote_list->capacity = sn_count;
+    }
+    for (Usz i = 0; i < sn_count; ++i) {
+      U8 const *p = susnotes + i * Ckpt_susnote_size;
+      U32 bits = ckpt_get_u32(p);
+      Susnote *sn = susnote_list->buffer + i;
+      memcpy(&sn->remaining, &bits, sizeof bits);
+      sn->chan_note = ckpt_get_u16(p + 4);
+    }
+    susnote_list->count = sn_count;
+  }
+  vars->tick_num = (Usz)ckpt_get_u64(data + 24);
+  vars->random_seed = (Usz)ckpt_get_u64(data + 32);
+  vars->bpm = (Usz)ckpt_get_u64(data + 40);
+  return Checkpoint_error_ok;
+}
+
+Checkpoint_error checkpoint_load(char const *filepath, Field *field,
+                                 Mbuf_reusable *mbuf_r,
+                                 Susnote_list *susnote_list,
+                                 Checkpoint_vars *vars) {
+  int fd = open(filepath, O_RDONLY);
+  if (fd < 0)
+    return Checkpoint_error_cant_open_file;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return Checkpoint_error_cant_open_file;
+  }
+  // Pipes and other things that can't be mapped can't be checkpoints.
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return Checkpoint_error_not_a_checkpoint;
+  }
+  Usz size = (Usz)st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return Checkpoint_error_cant_open_file;
+  Checkpoint_error err =
+      ckpt_parse(map, size, field, mbuf_r, susnote_list, vars);
+  munmap(map, size);
+  return err;
+}
+
+char const *checkpoint_error_string(Checkpoint_error err) {
+  char const *errstr = "Unknown";
+  switch (err) {
+  case Checkpoint_error_ok:
+    errstr = "OK";
+    break;
+  case Checkpoint_error_cant_open_file:
+    errstr = "Unable to open file";
+    break;
+  case Checkpoint_error_write_failed:
+    errstr = "Unable to write file";
+    break;
+  case Checkpoint_error_not_a_checkpoint:
+    errstr = "Not a checkpoint file";
+    break;
+  case Checkpoint_error_unsupported_version:
+    errstr = "Checkpoint is from an unsupported version";
+    break;
+  case Checkpoint_error_truncated:
+    errstr = "Checkpoint file is truncated";
+    break;
+  case Checkpoint_error_bad_dimensions:
+    errstr = "Checkpoint has a bad grid size";
+    break;
+  case Checkpoint_error_checksum_mismatch:
+    errstr = "Checkpoint file is corrupted";
+    break;
+  }
+  return errstr;
+}
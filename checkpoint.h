@@ -0,0 +1,72 @@
+#pragma once
+#include "base.h"
+#include "field.h"
+#include "osc_out.h" // Susnote_list
+
+// Binary snapshot of everything needed to resume a running orca: the grid,
+// the mark buffer, the tick number, the random seed, the BPM and the MIDI
+// notes that are currently sustained. Unlike the text .orca format, loading
+// one doesn't need any parsing, so it's quick even for huge grids.
+//
+// Layout (all integers little-endian):
+//
+//   offset  size
+//        0     8  magic "ORCASNAP"
+//        8     4  format version (Checkpoint_version)
+//       12     4  header size in bytes
+//       16     2  height
+//       18     2  width
+//       20     4  number of sustained notes
+//       24     8  tick number
+//       32     8  random seed
+//       40     8  BPM
+//       48     4  Adler-32 of the glyphs
+//       52     4  Adler-32 of the marks
+//       56     4  Adler-32 of the sustained notes
+//       60     4  Adler-32 of bytes 0..59 of the header
+//       64        glyphs, height * width bytes, row-major
+//                 marks, height * width bytes, row-major
+//                 sustained notes, 6 bytes each: remaining seconds as an IEEE
+//                 754 float, then the channel and note number as a U16
+//
+// Bump Checkpoint_version when the layout changes. Files with a newer version
+// than the one this build knows about are refused.
+
+enum { Checkpoint_version = 1 };
+
+typedef enum {
+  Checkpoint_error_ok = 0,
+  Checkpoint_error_cant_open_file,
+  Checkpoint_error_write_failed,
+  Checkpoint_error_not_a_checkpoint,
+  Checkpoint_error_unsupported_version,
+  Checkpoint_error_truncated,
+  Checkpoint_error_bad_dimensions,
+  Checkpoint_error_checksum_mismatch,
+} Checkpoint_error;
+
+typedef struct {
+  Usz tick_num;
+  Usz random_seed;
+  Usz bpm;
+} Checkpoint_vars;
+
+// Writes the checkpoint with a single writev(). `susnote_list` may be NULL.
+// The mark buffer has the same stride as the field. Strided fields are packed
+// into a temporary buffer first.
+Checkpoint_error checkpoint_save(char const *filepath, Field const *field,
+                                 Mark const *mbuf,
+                                 Susnote_list const *susnote_list,
+                                 Checkpoint_vars const *vars);
+
+// Maps the file and checks all of its checksums before changing anything. On
+// error, none of the outputs are modified. Returns
+// Checkpoint_error_not_a_checkpoint if the file doesn't start with the magic
+// bytes, so that callers can fall back to loading it as a text file.
+// `susnote_list` may be NULL, in which case the sustained notes are ignored.
+Checkpoint_error checkpoint_load(char const *filepath, Field *field,
+                                 Mbuf_reusable *mbuf_r,
+                                 Susnote_list *susnote_list,
+                                 Checkpoint_vars *vars);
+
+char const *checkpoint_error_string(Checkpoint_error err);
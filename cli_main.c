@@ -1,32 +1,346 @@
+#include "alloc_audit.h"
 #include "base.h"
+#include "checkpoint.h"
+#include "cost.h"
 #include "field.h"
 #include "gbuffer.h"
+#include "osc_out.h"
 #include "sim.h"
+#include "sparse.h"
+#include "trace.h"
 #include "vmio.h"
 #include <getopt.h>
 
 static ORCA_NOINLINE void usage(void) { // clang-format off
 fprintf(stderr,
 "Usage: cli [options] infile\n\n"
+"The infile can be an .orca file or a checkpoint. A checkpoint resumes\n"
+"from its saved tick number and random seed.\n\n"
 "Options:\n"
 "    -t <number>   Number of timesteps to simulate.\n"
 "                  Must be 0 or a positive integer.\n"
 "                  Default: 1\n"
 "    -q or --quiet Don't print the result to stdout.\n"
+"    -c <file> or --checkpoint <file>\n"
+"                  After simulating, save a checkpoint to this file.\n"
+"    --layout <name>\n"
+"                  How the grid is stored in memory while simulating.\n"
+"                  dense:  One row after another.\n"
+"                  tiled:  In 32x32 tiles. Only faster on grids with\n"
+"                          large areas of nothing but '.'.\n"
+"                  interleaved:\n"
+"                          One row after another, with each cell's\n"
+"                          glyph and mark stored together.\n"
+"                  sparse: In 64x64 tiles, keeping only the ones that\n"
+"                          have something in them. For very large grids\n"
+"                          that are mostly empty. Doesn't work with\n"
+"                          checkpoints.\n"
+"                  The result is the same for all of them.\n"
+"                  Default: dense\n"
+"    --profile     Count and time each operator and each type of\n"
+"                  output event, and print a table of where the time\n"
+"                  went to stderr. Only for the dense layout.\n"
+"    --trace <file>\n"
+"                  Record each tick and the file I/O, and write them\n"
+"                  as a Chrome trace for Perfetto or chrome://tracing.\n"
+"    --estimate    Instead of simulating, print an estimate of the\n"
+"                  worst-case cost of one tick of the grid, and warn\n"
+"                  about cells that could make ticks late or go over\n"
+"                  orca's event limits. Only for the dense layout.\n"
+"    --bpm <number>\n"
+"                  The tempo to check against with --estimate.\n"
+"                  Default: the checkpoint's, or 120\n"
 "    -h or --help  Print this message and exit.\n"
 );} // clang-format on
 
+// The events aren't used, so the list is cleared every so many ticks and
+// reused, instead of growing it for the whole run.
+enum { Ticks_per_batch = 256 };
+
+// Runs the ticks on a copy of the grid in the tiled layout, then copies the
+// glyphs and marks back.
+static void run_tiled(Field *field, Mark *mbuf, Usz tick_num, Usz ticks,
+                      Usz random_seed) {
+  Usz height = field->height, width = field->width;
+  Usz cells = gbuffer_tiled_cells(height, width);
+  Glyph *tiled_gbuf = malloc(cells * sizeof(Glyph));
+  Mark *tiled_mbuf = malloc(cells * sizeof(Mark));
+  gbuffer_to_tiled(field->buffer, height, width, field->stride, tiled_gbuf);
+  mbuffer_clear(tiled_mbuf, 1, cells);
+  Oevent_list oevent_list;
+  oevent_list_init(&oevent_list);
+  for (Usz i = 0; i < ticks; ++i) {
+    if (i % Ticks_per_batch == 0)
+      oevent_list_clear(&oevent_list);
+    mbuffer_clear(tiled_mbuf, 1, cells);
+    orca_run_tiled(tiled_gbuf, tiled_mbuf, height, width, tick_num + i,
+                   &oevent_list, random_seed);
+  }
+  oevent_list_deinit(&oevent_list);
+  gbuffer_from_tiled(tiled_gbuf, height, width, field->buffer, field->stride);
+  mbuffer_from_tiled(tiled_mbuf, height, width, mbuf, width);
+  free(tiled_gbuf);
+  free(tiled_mbuf);
+}
+
+// Same as run_tiled(), for the interleaved layout.
+static void run_interleaved(Field *field, Mark *mbuf, Usz tick_num, Usz ticks,
+                            Usz random_seed) {
+  Usz height = field->height, width = field->width;
+  Cell *cbuf = malloc(height * width * sizeof(Cell));
+  cbuffer_interleave(field->buffer, mbuf, height, width, field->stride, cbuf);
+  Oevent_list oevent_list;
+  oevent_list_init(&oevent_list);
+  for (Usz i = 0; i < ticks; ++i) {
+    if (i % Ticks_per_batch == 0)
+      oevent_list_clear(&oevent_list);
+    cbuffer_clear_marks(cbuf, height, width);
+    orca_run_interleaved(cbuf, height, width, tick_num + i, &oevent_list,
+                         random_seed);
+  }
+  oevent_list_deinit(&oevent_list);
+  cbuffer_deinterleave(cbuf, height, width, field->buffer, mbuf,
+                       field->stride);
+  free(cbuf);
+}
+
+static int run_sparse(char const *input_file, Usz ticks, bool print_output) {
+  Sparse_field sfield;
+  sparse_field_init(&sfield);
+  Field_load_error fle = sparse_field_load_file(input_file, &sfield);
+  if (fle != Field_load_error_ok) {
+    sparse_field_deinit(&sfield);
+    fprintf(stderr, "File load error: %s.\n", field_load_error_string(fle));
+    return 1;
+  }
+  Oevent_list oevent_list;
+  oevent_list_init(&oevent_list);
+  for (Usz i = 0; i < ticks; ++i) {
+    if (i % Ticks_per_batch == 0)
+      oevent_list_clear(&oevent_list);
+    orca_run_sparse(&sfield, i, &oevent_list, 0);
+  }
+  oevent_list_deinit(&oevent_list);
+  if (print_output)
+    sparse_field_fput(&sfield, stdout);
+  sparse_field_deinit(&sfield);
+  return 0;
+}
+
+// Ends the span of each tick run by orca_run_ticks(), and starts the next.
+static void trace_tick_callback(void *user, Usz tick_number,
+                                Glyph const *gbuffer, Mark const *mbuffer,
+                                Usz height, Usz width) {
+  (void)gbuffer, (void)mbuffer, (void)height, (void)width;
+  Trace_span *span = user;
+  trace_end_arg(*span, "tick", (I64)tick_number);
+  *span = trace_begin("orca_run");
+}
+
+// Operators sorted by the most time first, then the event types.
+static void print_profile(Oprofile const *prof, FILE *stream) {
+  Oprofile_summary sum;
+  oprofile_summarize(prof, &sum);
+  fprintf(stream,
+          "Profile of %llu ticks, in %s. %.1f per tick, %.1f%% in "
+          "operators.\n\n",
+          (unsigned long long)sum.ticks, orca_profile_unit, sum.tick_time,
+          sum.oper_share);
+  fprintf(stream, "%-10s%12s%12s%8s%12s\n", "Operator", "calls/tick",
+          "time/tick", "share", "time/call");
+  for (Usz i = 0; i < sum.oper_count; ++i) {
+    Oprofile_row const *r = &sum.opers[i];
+    fprintf(stream, "%-10c%12.2f%12.1f%7.1f%%%12.1f\n", (char)r->key,
+            r->count, r->time, r->share, r->time_per_call);
+  }
+  fprintf(stream, "\n%-10s%12s%12s%8s\n", "Event", "count/tick", "time/tick",
+          "share");
+  for (Usz i = 0; i < sum.event_count; ++i) {
+    Oprofile_row const *r = &sum.events[i];
+    fprintf(stream, "%-10s%12.2f%12.1f%7.1f%%\n",
+            oevent_type_name((Oevent_types)r->key), r->count, r->time,
+            r->share);
+  }
+}
+
+typedef enum {
+  Layout_dense,
+  Layout_tiled,
+  Layout_interleaved,
+  Layout_sparse,
+} Layout;
+
+// Prints the estimate from cost.h, checked against the limits orca uses by
+// default.
+static void print_estimate(Field const *field, Usz bpm, FILE *stream) {
+  Cost_limits limits = {
+      .bpm = bpm,
+      .event_budget = Oguard_default_tick_budget,
+      .midi_rate = Oguard_default_rate,
+      .osc_rate = Oguard_default_rate,
+      .udp_rate = Oguard_default_rate,
+  };
+  Cost_estimate est;
+  cost_estimate(field->buffer, field->height, field->width, field->stride,
+                &limits, &est);
+  char buf[2048];
+  cost_report(&est, &limits, buf, sizeof buf);
+  fputs(buf, stream);
+}
+
+// Everything after the options are read. If `estimate` is set, the grid is
+// estimated at `bpm`, or at the checkpoint's tempo if that's 0, instead of
+// being simulated.
+static int run(char const *input_file, char const *checkpoint_file,
+               Usz max_ticks, Layout layout, bool print_output, bool profile,
+               bool estimate, Usz bpm) {
+  if (layout == Layout_sparse) {
+    Trace_span span = trace_begin("run_sparse");
+    int exit_code = run_sparse(input_file, max_ticks, print_output);
+    trace_end(span);
+    return exit_code;
+  }
+
+  Field field;
+  field_init(&field);
+  Mbuf_reusable mbuf_r;
+  mbuf_reusable_init(&mbuf_r);
+  Checkpoint_vars vars = {.tick_num = 0, .random_seed = 0, .bpm = 120};
+  Trace_span span = trace_begin("load file");
+  Checkpoint_error cke =
+      checkpoint_load(input_file, &field, &mbuf_r, NULL, &vars);
+  Field_load_error fle = Field_load_error_ok;
+  if (cke == Checkpoint_error_not_a_checkpoint)
+    fle = field_load_file(input_file, &field);
+  trace_end(span);
+  if (cke == Checkpoint_error_not_a_checkpoint) {
+    if (fle != Field_load_error_ok) {
+      field_deinit(&field);
+      mbuf_reusable_deinit(&mbuf_r);
+      fprintf(stderr, "File load error: %s.\n", field_load_error_string(fle));
+      return 1;
+    }
+  } else if (cke != Checkpoint_error_ok) {
+    field_deinit(&field);
+    mbuf_reusable_deinit(&mbuf_r);
+    fprintf(stderr, "Checkpoint load error: %s.\n",
+            checkpoint_error_string(cke));
+    return 1;
+  }
+  if (estimate) {
+    print_estimate(&field, bpm ? bpm : vars.bpm, stdout);
+    field_deinit(&field);
+    mbuf_reusable_deinit(&mbuf_r);
+    return 0;
+  }
+  mbuf_reusable_ensure_size(&mbuf_r, field.height, field.width);
+  if (layout == Layout_tiled && max_ticks > 0) {
+    span = trace_begin("run_tiled");
+    run_tiled(&field, mbuf_r.buffer, vars.tick_num, max_ticks,
+              vars.random_seed);
+    trace_end(span);
+  } else if (layout == Layout_interleaved && max_ticks > 0) {
+    span = trace_begin("run_interleaved");
+    run_interleaved(&field, mbuf_r.buffer, vars.tick_num, max_ticks,
+                    vars.random_seed);
+    trace_end(span);
+  } else if (profile) {
+    Oprofile prof = {0};
+    Oevent_list oevent_list;
+    oevent_list_init(&oevent_list);
+    for (Usz i = 0; i < max_ticks; ++i) {
+      if (i % Ticks_per_batch == 0)
+        oevent_list_clear(&oevent_list);
+      span = trace_begin("orca_run");
+      mbuffer_clear(mbuf_r.buffer, field.height, field.stride);
+      orca_run_profiled(field.buffer, mbuf_r.buffer, field.height,
+                        field.width, field.stride, vars.tick_num + i,
+                        &oevent_list, vars.random_seed, &prof, NULL);
+      trace_end_arg(span, "tick", (I64)(vars.tick_num + i));
+    }
+    oevent_list_deinit(&oevent_list);
+    print_profile(&prof, stderr);
+  } else {
+    alloc_audit_open_log(NULL);
+    Oevent_list oevent_list;
+    oevent_list_init(&oevent_list);
+    for (Usz i = 0; i < max_ticks;) {
+      Usz batch = max_ticks - i;
+      if (batch > Ticks_per_batch)
+        batch = Ticks_per_batch;
+      oevent_list_clear(&oevent_list);
+      // The first batch grows the event list to fit, and the rest should
+      // reuse it.
+      if (i > 0)
+        alloc_audit_begin("orca_run_ticks", vars.tick_num + i);
+      // The span started after the last tick is never ended.
+      span = trace_begin("orca_run");
+      orca_run_ticks(field.buffer, mbuf_r.buffer, field.height, field.width,
+                     vars.tick_num + i, batch, &oevent_list, NULL,
+                     vars.random_seed,
+                     trace_is_on ? trace_tick_callback : NULL, &span);
+      alloc_audit_end();
+      i += batch;
+    }
+    oevent_list_deinit(&oevent_list);
+  }
+  int exit_code = 0;
+  if (checkpoint_file) {
+    vars.tick_num += max_ticks;
+    span = trace_begin("save checkpoint");
+    cke = checkpoint_save(checkpoint_file, &field, mbuf_r.buffer, NULL, &vars);
+    trace_end(span);
+    if (cke != Checkpoint_error_ok) {
+      fprintf(stderr, "Checkpoint save error: %s.\n",
+              checkpoint_error_string(cke));
+      exit_code = 1;
+    }
+  }
+  mbuf_reusable_deinit(&mbuf_r);
+  if (print_output) {
+    span = trace_begin("print");
+    field_fput(&field, stdout);
+    trace_end(span);
+  }
+  field_deinit(&field);
+  return exit_code;
+}
+
 int main(int argc, char **argv) {
+  enum {
+    Opt_layout = 256,
+    Opt_profile,
+    Opt_trace,
+    Opt_estimate,
+    Opt_bpm,
+  };
   static struct option cli_options[] = {{"help", no_argument, 0, 'h'},
                                         {"quiet", no_argument, 0, 'q'},
+                                        {"checkpoint", required_argument, 0,
+                                         'c'},
+                                        {"layout", required_argument, 0,
+                                         Opt_layout},
+                                        {"profile", no_argument, 0,
+                                         Opt_profile},
+                                        {"trace", required_argument, 0,
+                                         Opt_trace},
+                                        {"estimate", no_argument, 0,
+                                         Opt_estimate},
+                                        {"bpm", required_argument, 0, Opt_bpm},
                                         {NULL, 0, NULL, 0}};
 
   char *input_file = NULL;
+  char *checkpoint_file = NULL;
+  char *trace_file = NULL;
   int ticks = 1;
   bool print_output = true;
+  bool profile = false;
+  bool estimate = false;
+  int bpm = 0;
+  Layout layout = Layout_dense;
 
   for (;;) {
-    int c = getopt_long(argc, argv, "t:qh", cli_options, NULL);
+    int c = getopt_long(argc, argv, "t:qc:h", cli_options, NULL);
     if (c == -1)
       break;
     switch (c) {
@@ -43,6 +357,45 @@ int main(int argc, char **argv) {
     case 'q':
       print_output = false;
       break;
+    case 'c':
+      checkpoint_file = optarg;
+      break;
+    case Opt_layout:
+      if (strcmp(optarg, "dense") == 0) {
+        layout = Layout_dense;
+      } else if (strcmp(optarg, "tiled") == 0) {
+        layout = Layout_tiled;
+      } else if (strcmp(optarg, "interleaved") == 0) {
+        layout = Layout_interleaved;
+      } else if (strcmp(optarg, "sparse") == 0) {
+        layout = Layout_sparse;
+      } else {
+        fprintf(stderr,
+                "Bad layout argument %s.\n"
+                "Must be dense, tiled, interleaved or sparse.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case Opt_profile:
+      profile = true;
+      break;
+    case Opt_trace:
+      trace_file = optarg;
+      break;
+    case Opt_estimate:
+      estimate = true;
+      break;
+    case Opt_bpm:
+      bpm = atoi(optarg);
+      if (bpm < 1) {
+        fprintf(stderr,
+                "Bad bpm argument %s.\n"
+                "Must be a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
     case 'h':
       usage();
       return 0;
@@ -70,31 +423,30 @@ int main(int argc, char **argv) {
     usage();
     return 1;
   }
-
-  Field field;
-  field_init(&field);
-  Field_load_error fle = field_load_file(input_file, &field);
-  if (fle != Field_load_error_ok) {
-    field_deinit(&field);
-    fprintf(stderr, "File load error: %s.\n", field_load_error_string(fle));
+  if (profile && layout != Layout_dense) {
+    fprintf(stderr, "--profile only works with the dense layout.\n");
     return 1;
   }
-  Mbuf_reusable mbuf_r;
-  mbuf_reusable_init(&mbuf_r);
-  mbuf_reusable_ensure_size(&mbuf_r, field.height, field.width);
-  Oevent_list oevent_list;
-  oevent_list_init(&oevent_list);
-  Usz max_ticks = (Usz)ticks;
-  for (Usz i = 0; i < max_ticks; ++i) {
-    mbuffer_clear(mbuf_r.buffer, field.height, field.width);
-    oevent_list_clear(&oevent_list);
-    orca_run(field.buffer, mbuf_r.buffer, field.height, field.width, i,
-             &oevent_list, 0);
+  if (estimate && layout != Layout_dense) {
+    fprintf(stderr, "--estimate only works with the dense layout.\n");
+    return 1;
   }
-  mbuf_reusable_deinit(&mbuf_r);
-  oevent_list_deinit(&oevent_list);
-  if (print_output)
-    field_fput(&field, stdout);
-  field_deinit(&field);
-  return 0;
+  if (layout == Layout_sparse && checkpoint_file) {
+    fprintf(stderr, "The sparse layout can't be used with --checkpoint.\n");
+    return 1;
+  }
+  if (trace_file) {
+    if (!trace_open(trace_file)) {
+      fprintf(stderr, "Couldn't create trace file: %s\n", trace_file);
+      return 1;
+    }
+    trace_name_thread("main");
+  }
+  int exit_code = run(input_file, checkpoint_file, (Usz)ticks, layout,
+                      print_output, profile, estimate, (Usz)bpm);
+  if (!trace_close()) {
+    fprintf(stderr, "Error writing trace file: %s\n", trace_file);
+    exit_code = 1;
+  }
+  return exit_code;
 }
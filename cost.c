@@ -0,0 +1,356 @@
+#include "cost.h"
+#include <stdio.h>
+
+// Rough figures for turning the counts into time. See cost.h.
+static double const cost_ns_per_empty_cell = 0.8; // Including its mark
+static double const cost_ns_per_filled_cell = 1.0; // Lock and sleep checks
+// Mostly the dispatch, which is hard to predict on grids with a lot going on.
+static double const cost_ns_per_oper = 24.0;
+static double const cost_ns_per_access = 0.3;
+static double const cost_ns_per_event = 2000.0; // A send() of its own
+// For grids whose glyphs and marks don't fit in 64 KiB, about the most that
+// stays close to a core. The VM's time for those is scaled up.
+static double const cost_uncached_scale = 1.25;
+
+enum {
+  Cost_cached_cells = 1 << 15,
+  Cost_bang_check = 4, // The neighbors looked at for a bang
+  Cost_arg_max = 35,   // The largest value of a single glyph argument
+  Cost_jump_max = 256,
+  Cost_comment_max = 254, // Cells after a # that it scans, as in sim_ops.h
+  Cost_udp_max = Oevent_udp_string_count,
+};
+
+typedef struct {
+  Glyph const *gbuf;
+  Usz height, width, stride;
+} Cost_grid;
+
+static Glyph cost_peek(Cost_grid const *g, Usz y, Usz x, Isz dy, Isz dx) {
+  Isz y0 = (Isz)y + dy;
+  Isz x0 = (Isz)x + dx;
+  if (y0 < 0 || x0 < 0 || (Usz)y0 >= g->height || (Usz)x0 >= g->width)
+    return '.';
+  return g->gbuf[(Usz)y0 * g->stride + (Usz)x0];
+}
+
+static Usz cost_index_of(Glyph c) {
+  if (c >= '0' && c <= '9')
+    return (Usz)(c - '0');
+  if (c >= 'A' && c <= 'Z')
+    return (Usz)(c - 'A' + 10);
+  if (c >= 'a' && c <= 'z')
+    return (Usz)(c - 'a' + 10);
+  return 0;
+}
+
+// -1 if the glyph isn't an output operator.
+static int cost_event_type(Glyph c) {
+  switch (c) {
+  case ':':
+  case '%':
+    return Oevent_type_midi_note;
+  case '!':
+    return Oevent_type_midi_cc;
+  case '?':
+    return Oevent_type_midi_pb;
+  case '=':
+    return Oevent_type_osc_ints;
+  case ';':
+    return Oevent_type_udp_string;
+  }
+  return -1;
+}
+
+static bool cost_is_oper(Glyph c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '*' ||
+         c == '#' || cost_event_type(c) >= 0;
+}
+
+// Returns the worst-case number of cell accesses for the operator at (y, x),
+// and the number with its arguments as they are now in `out_now`. The counts
+// follow the PORT, PEEK and POKE calls of each operator in sim_ops.h.
+static Usz cost_of_oper(Cost_grid const *g, Usz y, Usz x, Glyph c,
+                        Usz *out_now) {
+  Usz bang = 0;
+  Glyph upper = c;
+  if (c >= 'a' && c <= 'z') {
+    upper = (Glyph)(c - 'a' + 'A');
+    bang = Cost_bang_check;
+  }
+  Usz worst = 0, now = 0;
+  switch (upper) {
+  case 'A':
+  case 'B':
+  case 'C':
+  case 'D':
+  case 'F':
+  case 'L':
+  case 'M':
+  case 'R':
+  case 'U':
+  case 'V':
+    worst = now = 6;
+    break;
+  case 'I':
+  case 'Z':
+    worst = now = 7;
+    break;
+  case 'E':
+  case 'N':
+  case 'S':
+  case 'W':
+    worst = now = 3;
+    break;
+  case 'H':
+    worst = now = 1;
+    break;
+  case 'O':
+    worst = now = 8;
+    break;
+  case 'X':
+    worst = now = 9;
+    break;
+  case 'P':
+  case 'T':
+    worst = 8 + Cost_arg_max;
+    now = 8 + cost_index_of(cost_peek(g, y, x, 0, -1));
+    break;
+  case 'K': {
+    Usz len = cost_index_of(cost_peek(g, y, x, 0, -1));
+    worst = 2 + 4 * Cost_arg_max;
+    now = 2 + 4 * (len ? len : 1);
+    break;
+  }
+  case 'G':
+    worst = 6 + 5 * Cost_arg_max;
+    now = 6 + 5 * cost_index_of(cost_peek(g, y, x, 0, -1));
+    break;
+  case 'Q':
+    worst = 6 + 4 * Cost_arg_max;
+    now = 6 + 4 * cost_index_of(cost_peek(g, y, x, 0, -1));
+    break;
+  case 'J':
+  case 'Y': {
+    // Each copy of the operator it passes over is put to sleep, then the
+    // first other cell is written.
+    bool down = upper == 'J';
+    Usz room = down ? g->height - 1 - y : g->width - 1 - x;
+    Usz max = room < Cost_jump_max ? room : Cost_jump_max;
+    Usz run = 0;
+    while (run < max &&
+           cost_peek(g, y, x, down ? (Isz)run + 1 : 0,
+                     down ? 0 : (Isz)run + 1) == c)
+      ++run;
+    worst = 4 + 2 * max;
+    now = 4 + 2 * run;
+    break;
+  }
+  case '*':
+    worst = now = 1;
+    break;
+  case '#': {
+    Usz room = g->width - 1 - x;
+    Usz max = room < Cost_comment_max ? room : Cost_comment_max;
+    Usz len = 0;
+    while (len < max) {
+      ++len;
+      if (cost_peek(g, y, x, 0, (Isz)len) == '#')
+        break;
+    }
+    worst = 2 * max;
+    now = 2 * len;
+    break;
+  }
+  case ':':
+  case '%':
+    worst = now = 15;
+    break;
+  case '!':
+  case '?':
+    worst = now = 11;
+    break;
+  case ';': {
+    Usz room = g->width - 1 - x;
+    Usz max = room < Cost_udp_max ? room : Cost_udp_max;
+    Usz len = 0;
+    while (len < max && cost_peek(g, y, x, 0, (Isz)len + 1) != '.')
+      ++len;
+    worst = 5 + 2 * max;
+    now = 5 + 2 * len;
+    break;
+  }
+  case '=': {
+    Usz len = cost_index_of(cost_peek(g, y, x, 0, 2));
+    worst = 9 + 2 * Cost_arg_max;
+    now = 9 + 2 * len;
+    break;
+  }
+  }
+  *out_now = now + bang;
+  return worst + bang;
+}
+
+static void cost_add_hotspot(Cost_estimate *est, Cost_cell cell) {
+  Usz n = est->hotspot_count;
+  if (n == Cost_hotspot_count &&
+      est->hotspots[n - 1].accesses >= cell.accesses)
+    return;
+  if (n < Cost_hotspot_count)
+    ++est->hotspot_count;
+  else
+    --n;
+  for (; n > 0 && est->hotspots[n - 1].accesses < cell.accesses; --n)
+    est->hotspots[n] = est->hotspots[n - 1];
+  est->hotspots[n] = cell;
+}
+
+void cost_estimate(Glyph const *gbuf, Usz height, Usz width, Usz stride,
+                   Cost_limits const *limits, Cost_estimate *out) {
+  Cost_grid grid = {gbuf, height, width, stride};
+  memset(out, 0, sizeof(Cost_estimate));
+  out->height = height;
+  out->width = width;
+  out->tick_ns = limits->bpm ? 60e9 / (double)limits->bpm / 4.0 : 0.0;
+  Usz budget = limits->event_budget;
+  double scale = height * width > Cost_cached_cells ? cost_uncached_scale : 1.0;
+  double empty_ns = cost_ns_per_empty_cell * scale;
+  double filled_ns = cost_ns_per_filled_cell * scale;
+  double oper_ns = cost_ns_per_oper * scale;
+  double access_ns = cost_ns_per_access * scale;
+  double running_ns = 0.0;
+  for (Usz iy = 0; iy < height; ++iy) {
+    for (Usz ix = 0; ix < width; ++ix) {
+      Glyph c = gbuf[iy * stride + ix];
+      if (c == '.') {
+        running_ns += empty_ns;
+        continue;
+      }
+      ++out->filled_cells;
+      running_ns += filled_ns;
+      if (!cost_is_oper(c))
+        continue;
+      Usz now;
+      Usz worst = cost_of_oper(&grid, iy, ix, c, &now);
+      Cost_cell cell = {iy, ix, worst, c};
+      ++out->opers;
+      ++out->oper_count[c & 0x7f];
+      out->accesses += worst;
+      out->current_accesses += now;
+      running_ns += oper_ns + (double)worst * access_ns;
+      int type = cost_event_type(c);
+      if (type >= 0) {
+        ++out->events;
+        ++out->events_by_type[type];
+        if (budget && out->events > budget) {
+          if (!out->over_event_budget) {
+            out->over_event_budget = true;
+            out->over_event_budget_cell = cell;
+          }
+        } else {
+          running_ns += cost_ns_per_event;
+        }
+      }
+      cost_add_hotspot(out, cell);
+      if (!out->over_time && out->tick_ns > 0.0 &&
+          running_ns > out->tick_ns) {
+        out->over_time = true;
+        out->over_time_cell = cell;
+      }
+    }
+  }
+  double walk_ns = (double)(height * width - out->filled_cells) * empty_ns +
+                   (double)out->filled_cells * filled_ns +
+                   (double)out->opers * oper_ns;
+  out->vm_ns = walk_ns + (double)out->accesses * access_ns;
+  out->current_vm_ns = walk_ns + (double)out->current_accesses * access_ns;
+  Usz sent = budget && out->events > budget ? budget : out->events;
+  out->send_ns = (double)sent * cost_ns_per_event;
+}
+
+// Like "850 ns", "12.3 us" or "4.56 ms".
+static void cost_format_time(double ns, char *buf, Usz size) {
+  if (ns < 1e3)
+    snprintf(buf, size, "%.0f ns", ns);
+  else if (ns < 1e6)
+    snprintf(buf, size, "%.1f us", ns / 1e3);
+  else
+    snprintf(buf, size, "%.2f ms", ns / 1e6);
+}
+
+Usz cost_report(Cost_estimate const *est, Cost_limits const *limits,
+                char *buf, Usz size) {
+  Usz len = 0;
+#define COST_PRINTF(...)                                                       \
+  if (len < size)                                                              \
+    len += (Usz)snprintf(buf + len, size - len, __VA_ARGS__);
+  char vm[32], vm_now[32], send[32];
+  cost_format_time(est->vm_ns, vm, sizeof vm);
+  cost_format_time(est->current_vm_ns, vm_now, sizeof vm_now);
+  cost_format_time(est->send_ns, send, sizeof send);
+  COST_PRINTF("%zux%zu grid at %zu BPM, %.2f ms per tick.\n", est->height,
+              est->width, limits->bpm, est->tick_ns / 1e6)
+  COST_PRINTF("%zu operators, %zu other glyphs, %zu empty cells.\n",
+              est->opers, est->filled_cells - est->opers,
+              est->height * est->width - est->filled_cells)
+  COST_PRINTF("Worst case per tick: %llu cell accesses, %zu events.\n",
+              (unsigned long long)est->accesses, est->events)
+  COST_PRINTF("VM: about %s, or %s with the arguments as they are.\n", vm,
+              vm_now)
+  COST_PRINTF("Sending events: about %s.\n", send)
+  if (est->tick_ns > 0.0) {
+    double pct = 100.0 * (est->vm_ns + est->send_ns) / est->tick_ns;
+    COST_PRINTF("Worst case: %.*f%% of the tick.\n", pct < 1.0 ? 3 : 1, pct)
+  }
+  if (est->hotspot_count > 0)
+    COST_PRINTF("Costliest cells (x,y):\n")
+  for (Usz i = 0; i < est->hotspot_count; ++i) {
+    Cost_cell const *c = est->hotspots + i;
+    COST_PRINTF("  %c at %zu,%zu: %zu accesses\n", c->glyph, c->x, c->y,
+                c->accesses)
+  }
+  bool ok = true;
+  if (est->over_time) {
+    Cost_cell const *c = &est->over_time_cell;
+    COST_PRINTF("Over time: from the %c at %zu,%zu on, a tick could take\n"
+                "  longer than it has.\n",
+                c->glyph, c->x, c->y)
+    ok = false;
+  }
+  if (est->over_event_budget) {
+    Cost_cell const *c = &est->over_event_budget_cell;
+    COST_PRINTF("Over the event budget of %zu per tick: events from the\n"
+                "  %c at %zu,%zu on could be dropped.\n",
+                limits->event_budget, c->glyph, c->x, c->y)
+    ok = false;
+  }
+  if (limits->bpm > 0) {
+    double ticks_per_sec = (double)limits->bpm * 4.0 / 60.0;
+    Usz const *by_type = est->events_by_type;
+    struct {
+      char const *name;
+      Usz events;
+      double rate;
+    } dests[] = {
+        {"MIDI",
+         by_type[Oevent_type_midi_note] + by_type[Oevent_type_midi_cc] +
+             by_type[Oevent_type_midi_pb],
+         limits->midi_rate},
+        {"OSC", by_type[Oevent_type_osc_ints], limits->osc_rate},
+        {"UDP", by_type[Oevent_type_udp_string], limits->udp_rate},
+    };
+    for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(dests); ++i) {
+      double per_sec = (double)dests[i].events * ticks_per_sec;
+      if (dests[i].rate <= 0.0 || per_sec <= dests[i].rate)
+        continue;
+      COST_PRINTF("Over the event rate: up to %.0f %s events per second,\n"
+                  "  more than the %.0f that can be sent.\n",
+                  per_sec, dests[i].name, dests[i].rate)
+      ok = false;
+    }
+  }
+  if (ok)
+    COST_PRINTF("Nothing should go over its limits.\n")
+#undef COST_PRINTF
+  return len < size ? len : size - 1;
+}
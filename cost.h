@@ -0,0 +1,66 @@
+#pragma once
+#include "base.h"
+#include "vmio.h"
+
+// A static estimate of how much one tick of a grid can cost, made by looking
+// at the operators on it instead of running it, for checking a patch before
+// it goes on stage. Each operator is given a worst-case number of cell
+// accesses: the ports it marks and the cells it reads and writes, with the
+// scans and lengths that depend on its arguments at their largest (J and Y
+// up to 256 cells, # up to 254, 35 for the lengths of G, Q, K, P, T and the
+// arguments of =), cut off where the grid ends. The same is also worked out
+// with the arguments as they are now.
+//
+// Accesses are turned into time with a few fixed figures, with more time per
+// cell for grids too big to stay in cache. They were fitted to the median
+// tick `bench` measured on an x86 machine, for grids made by `gen` from
+// 128x128 to 4096x4096 at densities from 10 to 100, and for the files in
+// examples/benchmarks. The worst case came out 1.1 to 1.5 times the median
+// for the generated grids, and 1.4 to 3.4 times for the examples. Single
+// ticks can still take longer than the median, so the figures are only
+// meant to tell a patch that's nowhere near the time a tick has from one that
+// might get close. Each output operator sends at most one event per tick, so
+// the count of events is exact, given that every one of them gets banged.
+
+typedef struct {
+  Usz bpm;
+  Usz event_budget; // Events per tick, 0 for no limit
+  // Events per second to each destination, 0 for no limit
+  double midi_rate, osc_rate, udp_rate;
+} Cost_limits;
+
+typedef struct {
+  Usz y, x;
+  Usz accesses;
+  Glyph glyph;
+} Cost_cell;
+
+enum { Cost_hotspot_count = 5 };
+
+typedef struct {
+  Usz height, width;
+  Usz filled_cells; // Not '.'
+  Usz opers;
+  Usz oper_count[128]; // Indexed by glyph
+  U64 accesses, current_accesses;
+  Usz events;
+  Usz events_by_type[Oevent_type_count];
+  double vm_ns, current_vm_ns, send_ns, tick_ns;
+  // The costliest cells in the worst case, costliest first.
+  Cost_cell hotspots[Cost_hotspot_count];
+  Usz hotspot_count;
+  // The first operator, in the order the VM runs them, at which the worst
+  // case for the cells so far goes past the length of a tick.
+  bool over_time;
+  Cost_cell over_time_cell;
+  // The first output operator whose event would be over the event budget.
+  bool over_event_budget;
+  Cost_cell over_event_budget_cell;
+} Cost_estimate;
+
+void cost_estimate(Glyph const *gbuf, Usz height, Usz width, Usz stride,
+                   Cost_limits const *limits, Cost_estimate *out);
+// Writes the estimate as lines of text for people, cut off if it doesn't fit
+// in `size`. Returns the length written.
+Usz cost_report(Cost_estimate const *est, Cost_limits const *limits,
+                char *buf, Usz size);
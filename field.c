@@ -1,11 +1,14 @@
 #include "field.h"
 #include "gbuffer.h"
-#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 void field_init(Field *f) {
   f->buffer = NULL;
   f->height = 0;
   f->width = 0;
+  f->stride = 0;
 }
 
 void field_init_fill(Field *f, Usz height, Usz width, Glyph fill_char) {
@@ -15,6 +18,7 @@ void field_init_fill(Field *f, Usz height, Usz width, Glyph fill_char) {
   memset(f->buffer, fill_char, num_cells);
   f->height = (U16)height;
   f->width = (U16)width;
+  f->stride = (U16)width;
 }
 
 void field_deinit(Field *f) { free(f->buffer); }
@@ -25,6 +29,7 @@ void field_resize_raw(Field *f, Usz height, Usz width) {
   f->buffer = realloc(f->buffer, cells * sizeof(Glyph));
   f->height = (U16)height;
   f->width = (U16)width;
+  f->stride = (U16)width;
 }
 
 void field_resize_raw_if_necessary(Field *field, Usz height, Usz width) {
@@ -36,8 +41,8 @@ void field_resize_raw_if_necessary(Field *field, Usz height, Usz width) {
 void field_copy(Field *src, Field *dest) {
   field_resize_raw_if_necessary(dest, src->height, src->width);
   gbuffer_copy_subrect(src->buffer, dest->buffer, src->height, src->width,
-                       dest->height, dest->width, 0, 0, 0, 0, src->height,
-                       src->width);
+                       src->stride, dest->height, dest->width, dest->stride, 0,
+                       0, 0, 0, src->height, src->width);
 }
 
 static inline bool glyph_char_is_valid(char c) { return c >= '!' && c <= '~'; }
@@ -47,75 +52,234 @@ void field_fput(Field *f, FILE *stream) {
   char out_buffer[Column_buffer_count];
   Usz f_height = f->height;
   Usz f_width = f->width;
+  Usz f_stride = f->stride;
   Glyph *f_buffer = f->buffer;
-  if (f_width > Column_buffer_count - 2)
-    return;
+  // Rows wider than the buffer are written out in pieces.
   for (Usz iy = 0; iy < f_height; ++iy) {
-    Glyph *row_p = f_buffer + f_width * iy;
-    for (Usz ix = 0; ix < f_width; ++ix) {
-      char c = row_p[ix];
-      out_buffer[ix] = glyph_char_is_valid(c) ? c : '?';
-    }
-    out_buffer[f_width] = '\n';
-    out_buffer[f_width + 1] = '\0';
-    fputs(out_buffer, stream);
+    Glyph *row_p = f_buffer + f_stride * iy;
+    Usz ix = 0;
+    do {
+      Usz n = f_width - ix;
+      if (n > Column_buffer_count - 1)
+        n = Column_buffer_count - 1;
+      for (Usz i = 0; i < n; ++i) {
+        char c = row_p[ix + i];
+        out_buffer[i] = glyph_char_is_valid(c) ? c : '?';
+      }
+      ix += n;
+      if (ix == f_width)
+        out_buffer[n++] = '\n';
+      fwrite(out_buffer, 1, n, stream);
+    } while (ix < f_width);
   }
 }
 
-Field_load_error field_load_file(char const *filepath, Field *field) {
-  FILE *file = fopen(filepath, "r");
-  if (file == NULL) {
-    return Field_load_error_cant_open_file;
+// Copies a row of text into the grid, replacing anything that isn't a valid
+// glyph with '.'. The fixed-size inner loop is written without branches so
+// that the compiler turns it into vector instructions, even at -O2.
+static inline char field_validated_char(char c) {
+  return (U8)((U8)c - (U8)'!') <= (U8)('~' - '!') ? c : '.';
+}
+static void field_copy_row_validated(Glyph *restrict dest,
+                                     char const *restrict src, Usz len) {
+  enum { Chunk = 16 };
+  Usz i = 0;
+  for (; i + Chunk <= len; i += Chunk) {
+    for (Usz j = 0; j < Chunk; ++j)
+      dest[i + j] = field_validated_char(src[i + j]);
   }
-  enum { Bufsize = 4096 };
-  char buf[Bufsize];
-  Usz first_row_columns = 0;
-  Usz rows = 0;
-  for (;;) {
-    char *s = fgets(buf, Bufsize, file);
-    if (s == NULL)
-      break;
-    if (rows == ORCA_Y_MAX) {
-      fclose(file);
-      return Field_load_error_too_many_rows;
-    }
-    Usz len = strlen(buf);
-    if (len == Bufsize - 1 && buf[len - 1] != '\n' && !feof(file)) {
-      fclose(file);
-      return Field_load_error_too_many_columns;
-    }
-    for (;;) {
-      if (len == 0)
-        break;
-      if (!isspace(buf[len - 1]))
-        break;
-      --len;
-    }
+  for (; i < len; ++i)
+    dest[i] = field_validated_char(src[i]);
+}
+
+// Two passes over the text: the first finds the dimensions and checks that the
+// grid is a rectangle, the second copies the rows into a buffer that's
+// allocated once. The field is only changed if there are no errors.
+static Field_load_error field_load_text(char const *text, Usz size,
+                                        Field *field) {
+  char const *end = text + size;
+  char const *pos = text, *line;
+  Usz rows = 0, columns = 0;
+  while (pos < end) {
+    Usz len = field_text_next_line(&pos, end, &line);
     if (len == 0)
       continue;
-    if (len >= ORCA_X_MAX) {
-      fclose(file);
+    if (len >= ORCA_X_MAX)
       return Field_load_error_too_many_columns;
-    }
-    // quick hack until we use a proper scanner
     if (rows == 0) {
-      first_row_columns = len;
-    } else if (len != first_row_columns) {
-      fclose(file);
+      columns = len;
+    } else if (len != columns) {
       return Field_load_error_not_a_rectangle;
     }
-    field_resize_raw(field, rows + 1, first_row_columns);
-    Glyph *rowbuff = field->buffer + first_row_columns * rows;
-    for (Usz i = 0; i < len; ++i) {
-      char c = buf[i];
-      rowbuff[i] = glyph_char_is_valid(c) ? c : '.';
-    }
+    if (rows == ORCA_Y_MAX)
+      return Field_load_error_too_many_rows;
     ++rows;
   }
-  fclose(file);
+  if (rows == 0)
+    return Field_load_error_ok;
+  field_resize_raw(field, rows, columns);
+  Glyph *rowbuff = field->buffer;
+  pos = text;
+  while (pos < end) {
+    Usz len = field_text_next_line(&pos, end, &line);
+    if (len == 0)
+      continue;
+    field_copy_row_validated(rowbuff, line, len);
+    rowbuff += columns;
+  }
   return Field_load_error_ok;
 }
 
+bool field_text_open(char const *filepath, Field_text *ft) {
+  *ft = (Field_text){0};
+  int fd = open(filepath, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  if (S_ISREG(st.st_mode)) {
+    Usz size = (Usz)st.st_size;
+    if (size == 0) {
+      close(fd);
+      return true;
+    }
+    int map_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    map_flags |= MAP_POPULATE; // We read all of it, so fault it in up front
+#endif
+    void *map = mmap(NULL, size, PROT_READ, map_flags, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+      return false;
+    ft->text = map;
+    ft->size = size;
+    ft->is_mapped = true;
+    return true;
+  }
+  // Not a regular file, so it can't be mapped (a pipe, for example.) Read the
+  // whole thing into memory instead.
+  char *text = NULL;
+  Usz size = 0, capacity = 0;
+  for (;;) {
+    if (capacity - size < 4096) {
+      capacity = capacity < 65536 ? 65536 : capacity * 2;
+      text = realloc(text, capacity);
+    }
+    ssize_t n = read(fd, text + size, capacity - size);
+    if (n <= 0)
+      break;
+    size += (Usz)n;
+  }
+  close(fd);
+  ft->text = text;
+  ft->size = size;
+  return true;
+}
+
+void field_text_close(Field_text *ft) {
+  if (ft->is_mapped)
+    munmap((void *)ft->text, ft->size);
+  else
+    free((void *)ft->text);
+  *ft = (Field_text){0};
+}
+
+Field_load_error field_load_file(char const *filepath, Field *field) {
+  Field_text ft;
+  if (!field_text_open(filepath, &ft))
+    return Field_load_error_cant_open_file;
+  Field_load_error err = field_load_text(ft.text, ft.size, field);
+  field_text_close(&ft);
+  return err;
+}
+
+// Counts the bytes in [text, text + len) which aren't valid glyphs. The inner
+// loop has no branches so it can be vectorized, like
+// field_copy_row_validated().
+static Usz field_count_invalid(char const *text, Usz len) {
+  enum { Chunk = 16 };
+  Usz invalid = 0, i = 0;
+  for (; i + Chunk <= len; i += Chunk) {
+    U8 chunk_invalid = 0;
+    for (Usz j = 0; j < Chunk; ++j)
+      chunk_invalid |= (U8)((U8)text[i + j] - (U8)'!') > (U8)('~' - '!');
+    invalid += chunk_invalid;
+  }
+  for (; i < len; ++i)
+    invalid += (U8)((U8)text[i] - (U8)'!') > (U8)('~' - '!');
+  return invalid;
+}
+
+Field_load_error field_map_file(char const *filepath, Field *field,
+                                Field_mapping *out_mapping) {
+  int fd = open(filepath, O_RDWR);
+  if (fd < 0)
+    return Field_load_error_cant_open_file;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return Field_load_error_cant_open_file;
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return Field_load_error_not_mappable;
+  }
+  Usz size = (Usz)st.st_size;
+  char *text = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // The mapping keeps its own reference to the file
+  if (text == MAP_FAILED)
+    return Field_load_error_cant_open_file;
+  Field_load_error err = Field_load_error_not_mappable;
+  char const *nl = memchr(text, '\n', size);
+  Usz width = nl ? (Usz)(nl - text) : size;
+  Usz stride = width + 1;
+  // The newline after the last row is optional.
+  Usz height = (size + 1) / stride;
+  if (width == 0 || height * stride != size + (text[size - 1] != '\n'))
+    goto fail;
+  if (width >= ORCA_X_MAX) {
+    err = Field_load_error_too_many_columns;
+    goto fail;
+  }
+  if (height > ORCA_Y_MAX) {
+    err = Field_load_error_too_many_rows;
+    goto fail;
+  }
+  // Any newline in the middle of a row, or a missing one at the end, also
+  // shows up here as an invalid glyph.
+  for (Usz iy = 0; iy < height; ++iy) {
+    char const *row = text + iy * stride;
+    if (field_count_invalid(row, width) != 0 ||
+        (iy + 1 < height && row[width] != '\n'))
+      goto fail;
+  }
+  field->buffer = (Glyph *)text;
+  field->height = (U16)height;
+  field->width = (U16)width;
+  field->stride = (U16)stride;
+  out_mapping->addr = text;
+  out_mapping->size = size;
+  return Field_load_error_ok;
+fail:
+  munmap(text, size);
+  return err;
+}
+
+bool field_mapping_sync(Field_mapping *fm, bool wait) {
+  return msync(fm->addr, fm->size, wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+void field_unmap(Field_mapping *fm, Field *field) {
+  field_mapping_sync(fm, true);
+  munmap(fm->addr, fm->size);
+  fm->addr = NULL;
+  fm->size = 0;
+  field_init(field);
+}
+
 char const *field_load_error_string(Field_load_error fle) {
   char const *errstr = "Unknown";
   switch (fle) {
@@ -137,6 +301,9 @@ char const *field_load_error_string(Field_load_error fle) {
   case Field_load_error_not_a_rectangle:
     errstr = "Grid file is not a rectangle";
     break;
+  case Field_load_error_not_mappable:
+    errstr = "Grid file can't be edited in place";
+    break;
   }
   return errstr;
 }
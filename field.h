@@ -6,9 +6,13 @@
 // for loading/saving from files and doing common operations that a UI layer
 // might want to do. Not used by the VM.
 
+// Rows start `stride` glyphs apart in the buffer. Fields made by the functions
+// here are always packed (stride == width), except for ones viewing a mapped
+// file with field_map_file(), where the stride also covers the newline at the
+// end of each row.
 typedef struct {
   Glyph *buffer;
-  U16 width, height;
+  U16 width, height, stride;
 } Field;
 
 void field_init(Field *field);
@@ -16,6 +20,7 @@ void field_init_fill(Field *field, Usz height, Usz width, Glyph fill_char);
 void field_deinit(Field *field);
 void field_resize_raw(Field *field, Usz height, Usz width);
 void field_resize_raw_if_necessary(Field *field, Usz height, Usz width);
+// The destination is always packed, even if the source isn't.
 void field_copy(Field *src, Field *dest);
 void field_fput(Field *field, FILE *stream);
 
@@ -26,10 +31,70 @@ typedef enum {
   Field_load_error_too_many_rows = 3,
   Field_load_error_no_rows_read = 4,
   Field_load_error_not_a_rectangle = 5,
+  Field_load_error_not_mappable = 6,
 } Field_load_error;
 
 Field_load_error field_load_file(char const *filepath, Field *field);
 
+// The file reading used by field_load_file(), for loading into other kinds of
+// grid storage. The whole file is mapped, or read into memory if it can't be
+// mapped. Returns false if it can't be opened.
+typedef struct {
+  char const *text;
+  Usz size;
+  bool is_mapped;
+} Field_text;
+
+bool field_text_open(char const *filepath, Field_text *ft);
+void field_text_close(Field_text *ft);
+
+static inline bool field_char_is_trailing_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' ||
+         c == '\f';
+}
+
+// Returns the next line in [*pos, end), without the newline or any trailing
+// whitespace, and moves *pos past the newline. memchr() is vectorized by libc,
+// so this is fast even for very long rows.
+static inline Usz field_text_next_line(char const **pos, char const *end,
+                                       char const **out_line) {
+  char const *line = *pos;
+  char const *nl = memchr(line, '\n', (Usz)(end - line));
+  char const *line_end = nl ? nl : end;
+  *pos = nl ? nl + 1 : end;
+  while (line_end > line && field_char_is_trailing_space(line_end[-1]))
+    --line_end;
+  *out_line = line;
+  return (Usz)(line_end - line);
+}
+
+// Live editing of a file in place. field_map_file() maps an .orca file shared
+// and read-write, and points `field` at the mapping without copying it, with a
+// stride of width + 1 to step over the newlines. Anything written to the field
+// (by the VM or by the editor) ends up in the file, and only the pages which
+// are actually touched are read into memory.
+//
+// Only files that are already in the same form field_fput() writes can be
+// mapped: a rectangle of valid glyphs with a '\n' after each row (except
+// possibly the last.) Anything else returns Field_load_error_not_mappable,
+// and the file is left untouched, so the caller can fall back to
+// field_load_file(). On success, `field` is overwritten without being freed.
+//
+// A mapped field must not be resized or passed to field_deinit(). Use
+// field_unmap() instead, which writes everything back to the file first.
+typedef struct {
+  void *addr;
+  Usz size;
+} Field_mapping;
+
+Field_load_error field_map_file(char const *filepath, Field *field,
+                                Field_mapping *out_mapping);
+// Schedules the changed pages to be written back to the file. If `wait` is
+// true, it also waits for them to be written. Returns false on I/O error.
+bool field_mapping_sync(Field_mapping *fm, bool wait);
+// Syncs, unmaps and resets `field` to the empty state from field_init().
+void field_unmap(Field_mapping *fm, Field *field);
+
 char const *field_load_error_string(Field_load_error fle);
 
 // A reusable buffer for the per-grid-cell flags. Similar to how Field is a
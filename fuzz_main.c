@@ -0,0 +1,705 @@
+#include "base.h"
+#include "gbuffer.h"
+#include "sim.h"
+#include "sim_ref.h"
+#include "sparse.h"
+#include "vmio.h"
+#include <getopt.h>
+
+#ifndef FEAT_LIBFUZZER
+static ORCA_NOINLINE void usage(void) { // clang-format off
+fprintf(stderr,
+"Usage: fuzz [options] [file...]\n\n"
+"Runs every way the VM can be run (orca_run() and its strided, multi-tick,\n"
+"per-cell, profiled, tiled, interleaved and sparse versions) side by side\n"
+"with a frozen copy of the original orca_run(), and stops at the first\n"
+"cell, mark or output event where one of them differs from it.\n\n"
+"With no files, runs random cases made from a seed, as a quick property\n"
+"test. With files, runs each one as a case. The first 8 bytes of a case\n"
+"pick the grid size, the number of ticks, the starting tick number, the\n"
+"random seed and the event limit, and the rest are the cells, one byte\n"
+"each. If the top bit of the third byte is set, the grid is instead larger\n"
+"than one sparse tile and all '.', and the rest are glyphs to place in it,\n"
+"3 bytes each: row, column and glyph. Use - to read a case from stdin.\n"
+"For AFL:\n"
+"    afl-fuzz -i cases -o findings build/fuzz @@\n"
+"Built with tool build --libfuzzer, this is a libFuzzer target instead, and\n"
+"takes libFuzzer's options.\n\n"
+"Options:\n"
+"    --runs <number>\n"
+"                  Number of random cases to run.\n"
+"                  Default: 1000\n"
+"    --seed <number>\n"
+"                  Seed for making the random cases.\n"
+"                  Default: 1\n"
+"    --save-case <file>\n"
+"                  If a case fails, write it to this file, so that it\n"
+"                  can be run again.\n"
+"    -h or --help  Print this message and exit.\n"
+);} // clang-format on
+#endif
+
+enum {
+  Fuzz_header_size = 8,
+  Fuzz_max_grid_size = 80, // Past a 64x64 sparse tile and two 32x32 tiles
+  Fuzz_max_ticks = 64,
+  // Sparse cases are bigger than one tile each way, so the tiles can become
+  // empty and be dropped, or be added on either side of the ones being run.
+  Fuzz_sparse_min_size = Sparse_tile_size + 1,
+  Fuzz_sparse_flag = 0x80, // In the third byte of the header
+  Fuzz_case_max_size =
+      Fuzz_header_size + Fuzz_max_grid_size * Fuzz_max_grid_size,
+  // Cells past the width in each row of the strided engine's buffer.
+  Fuzz_stride_padding = 3,
+};
+
+// Each byte of a case's cells is looked up in here, after dropping its top
+// bit. Not quite half of them are '.', so that operators have room to work.
+static char const fuzz_glyphs[128] =
+    ".........................................................."
+    "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ*#!%:;=?";
+enum { Fuzz_first_glyph = 58 };
+
+typedef struct {
+  Usz height, width, ticks, tick_number, random_seed, event_limit;
+  bool sparse;
+  Glyph cells[Fuzz_max_grid_size * Fuzz_max_grid_size];
+} Fuzz_case;
+
+// Any bytes make a valid case. Missing cells are '.', and extra bytes are
+// ignored.
+static void fuzz_case_decode(Fuzz_case *c, U8 const *data, Usz size) {
+  U8 head[Fuzz_header_size] = {0};
+  if (size > 0)
+    memcpy(head, data, size < Fuzz_header_size ? size : Fuzz_header_size);
+  c->sparse = (head[2] & Fuzz_sparse_flag) != 0;
+  Usz min_size = c->sparse ? Fuzz_sparse_min_size : 1;
+  Usz sizes = Fuzz_max_grid_size - min_size + 1;
+  c->height = min_size + (Usz)head[0] % sizes;
+  c->width = min_size + (Usz)head[1] % sizes;
+  c->ticks = 1 + (Usz)head[2] % Fuzz_max_ticks;
+  c->tick_number = (Usz)head[3] | (Usz)head[4] << 8;
+  c->random_seed = (Usz)head[5] | (Usz)head[6] << 8;
+  c->event_limit = head[7]; // 0 for no limit
+  Usz count = c->height * c->width;
+  if (c->sparse) {
+    memset(c->cells, '.', count);
+    for (Usz i = Fuzz_header_size; i + 3 <= size; i += 3) {
+      Usz y = data[i] % c->height, x = data[i + 1] % c->width;
+      c->cells[y * c->width + x] = fuzz_glyphs[data[i + 2] & 0x7f];
+    }
+    return;
+  }
+  for (Usz i = 0; i < count; ++i) {
+    U8 b = Fuzz_header_size + i < size ? data[Fuzz_header_size + i] : 0;
+    c->cells[i] = fuzz_glyphs[b & 0x7f];
+  }
+}
+
+typedef enum {
+  Engine_dense,
+  Engine_strided,
+  Engine_ticks,
+  Engine_cells,
+  Engine_profiled,
+  Engine_tiled,
+  Engine_interleaved,
+  Engine_sparse,
+} Engine_kind;
+
+enum { Engine_count = Engine_sparse + 1 };
+
+static char const *const engine_names[Engine_count] = {
+    [Engine_dense] = "orca_run",
+    [Engine_strided] = "orca_run_strided",
+    [Engine_ticks] = "orca_run_ticks",
+    [Engine_cells] = "orca_run_cells",
+    [Engine_profiled] = "orca_run_profiled",
+    [Engine_tiled] = "orca_run_tiled",
+    [Engine_interleaved] = "orca_run_interleaved",
+    [Engine_sparse] = "orca_run_sparse",
+};
+
+typedef struct {
+  Engine_kind kind;
+  Usz height, width, stride;
+  Glyph *gbuf; // Row-major `stride` apart, or tiled
+  Mark *mbuf;
+  Cell *cbuf;
+  Sparse_field sfield;
+  Usz *cells;     // Every cell, for orca_run_cells()
+  U32 *cell_time; // For orca_run_profiled()
+  Oprofile profile;
+  Oevent_list oevent_list;
+} Fuzz_engine;
+
+static void fuzz_engine_init(Fuzz_engine *e, Engine_kind kind,
+                             Fuzz_case const *c) {
+  Usz height = c->height, width = c->width;
+  memset(e, 0, sizeof(Fuzz_engine));
+  e->kind = kind;
+  e->height = height;
+  e->width = width;
+  e->stride = kind == Engine_strided ? width + Fuzz_stride_padding : width;
+  oevent_list_init(&e->oevent_list);
+  if (c->event_limit)
+    e->oevent_list.count_limit = c->event_limit;
+  switch (kind) {
+  case Engine_tiled: {
+    Usz cells = gbuffer_tiled_cells(height, width);
+    e->gbuf = malloc(cells * sizeof(Glyph));
+    e->mbuf = malloc(cells * sizeof(Mark));
+    gbuffer_to_tiled(c->cells, height, width, width, e->gbuf);
+    break;
+  }
+  case Engine_interleaved: {
+    Mark *marks = calloc(height * width, sizeof(Mark));
+    e->cbuf = malloc(height * width * sizeof(Cell));
+    cbuffer_interleave(c->cells, marks, height, width, width, e->cbuf);
+    free(marks);
+    break;
+  }
+  case Engine_sparse:
+    sparse_field_init(&e->sfield);
+    sparse_field_reset(&e->sfield, height, width);
+    for (Usz iy = 0; iy < height; ++iy)
+      for (Usz ix = 0; ix < width; ++ix)
+        sparse_field_poke(&e->sfield, iy, ix, c->cells[iy * width + ix]);
+    break;
+  default:
+    e->gbuf = malloc(height * e->stride * sizeof(Glyph));
+    e->mbuf = malloc(height * e->stride * sizeof(Mark));
+    // The padding is all bangs, so that reading it would change what the
+    // operators next to it do, and show up as a difference.
+    memset(e->gbuf, '*', height * e->stride * sizeof(Glyph));
+    for (Usz iy = 0; iy < height; ++iy)
+      memcpy(e->gbuf + iy * e->stride, c->cells + iy * width, width);
+    if (kind == Engine_cells) {
+      e->cells = malloc(height * width * sizeof(Usz));
+      for (Usz i = 0; i < height * width; ++i)
+        e->cells[i] = i;
+    } else if (kind == Engine_profiled) {
+      e->cell_time = calloc(height * width, sizeof(U32));
+    }
+    break;
+  }
+}
+
+static void fuzz_engine_deinit(Fuzz_engine *e) {
+  if (e->kind == Engine_sparse)
+    sparse_field_deinit(&e->sfield);
+  free(e->gbuf);
+  free(e->mbuf);
+  free(e->cbuf);
+  free(e->cells);
+  free(e->cell_time);
+  oevent_list_deinit(&e->oevent_list);
+}
+
+// Runs one tick of every engine but Engine_ticks, which runs the whole case
+// in one call to orca_run_ticks() instead.
+static void fuzz_engine_tick(Fuzz_engine *e, Usz tick_number,
+                             Usz random_seed) {
+  Usz height = e->height, width = e->width;
+  Oevent_list *olist = &e->oevent_list;
+  if (e->kind != Engine_ticks)
+    oevent_list_clear(olist);
+  switch (e->kind) {
+  case Engine_dense:
+    mbuffer_clear(e->mbuf, height, width);
+    orca_run(e->gbuf, e->mbuf, height, width, tick_number, olist,
+             random_seed);
+    break;
+  case Engine_strided:
+    mbuffer_clear(e->mbuf, height, e->stride);
+    orca_run_strided(e->gbuf, e->mbuf, height, width, e->stride, tick_number,
+                     olist, random_seed);
+    break;
+  case Engine_ticks:
+    break;
+  case Engine_cells:
+    mbuffer_clear(e->mbuf, height, width);
+    orca_run_cells(e->gbuf, e->mbuf, height, width, e->cells, height * width,
+                   tick_number, olist, random_seed);
+    break;
+  case Engine_profiled:
+    mbuffer_clear(e->mbuf, height, width);
+    orca_run_profiled(e->gbuf, e->mbuf, height, width, width, tick_number,
+                      olist, random_seed, &e->profile, e->cell_time);
+    break;
+  case Engine_tiled:
+    mbuffer_clear(e->mbuf, 1, gbuffer_tiled_cells(height, width));
+    orca_run_tiled(e->gbuf, e->mbuf, height, width, tick_number, olist,
+                   random_seed);
+    break;
+  case Engine_interleaved:
+    cbuffer_clear_marks(e->cbuf, height, width);
+    orca_run_interleaved(e->cbuf, height, width, tick_number, olist,
+                         random_seed);
+    break;
+  case Engine_sparse:
+    orca_run_sparse(&e->sfield, tick_number, olist, random_seed);
+    break;
+  }
+}
+
+// Copies the grid out into row-major buffers `width` apart.
+static void fuzz_engine_view(Fuzz_engine *e, Glyph *gbuf, Mark *mbuf) {
+  Usz height = e->height, width = e->width;
+  switch (e->kind) {
+  case Engine_tiled:
+    gbuffer_from_tiled(e->gbuf, height, width, gbuf, width);
+    mbuffer_from_tiled(e->mbuf, height, width, mbuf, width);
+    break;
+  case Engine_interleaved:
+    cbuffer_deinterleave(e->cbuf, height, width, gbuf, mbuf, width);
+    break;
+  case Engine_sparse:
+    for (Usz iy = 0; iy < height; ++iy) {
+      for (Usz ix = 0; ix < width; ++ix) {
+        Sparse_tile const *t = sparse_field_find_tile(
+            &e->sfield, iy >> Sparse_tile_shift, ix >> Sparse_tile_shift);
+        Usz i = sparse_tile_index(iy, ix);
+        gbuf[iy * width + ix] = t ? t->glyphs[i] : '.';
+        mbuf[iy * width + ix] = t ? t->marks[i] : 0;
+      }
+    }
+    break;
+  default:
+    for (Usz iy = 0; iy < height; ++iy) {
+      memcpy(gbuf + iy * width, e->gbuf + iy * e->stride, width);
+      memcpy(mbuf + iy * width, e->mbuf + iy * e->stride, width);
+    }
+    break;
+  }
+}
+
+// Returns the column of the first cell in the padding of row `y` that isn't
+// a bang anymore, or 0 if they all are.
+static Usz fuzz_engine_padding_written(Fuzz_engine const *e, Usz y) {
+  for (Usz ix = e->width; ix < e->stride; ++ix)
+    if (e->gbuf[y * e->stride + ix] != '*')
+      return ix;
+  return 0;
+}
+
+typedef struct {
+  Fuzz_case const *c;
+  Usz tick_index;
+  Glyph const *before; // The reference's grid before the tick
+} Fuzz_report;
+
+static void fuzz_report_begin(Fuzz_report const *r, Engine_kind kind) {
+  fprintf(stderr, "%s differs from the reference on tick %zu of %zu:\n",
+          engine_names[kind], r->tick_index + 1, r->c->ticks);
+}
+
+static void fuzz_report_end(Fuzz_report const *r) {
+  Fuzz_case const *c = r->c;
+  fprintf(stderr,
+          "The case is a %zux%zu grid run for %zu ticks from tick number "
+          "%zu, with random seed %zu and ",
+          c->height, c->width, c->ticks, c->tick_number, c->random_seed);
+  if (c->event_limit)
+    fprintf(stderr, "an event limit of %zu.\n", c->event_limit);
+  else
+    fprintf(stderr, "no event limit.\n");
+  fprintf(stderr, "The reference's grid before that tick:\n");
+  for (Usz iy = 0; iy < c->height; ++iy) {
+    fwrite(r->before + iy * c->width, 1, c->width, stderr);
+    fputc('\n', stderr);
+  }
+}
+
+// Compares the events from the byte offset `want_begin` to the end of `want`
+// with the ones from `got_begin` to the end of `got`.
+static bool fuzz_compare_events(Fuzz_report const *r, Engine_kind kind,
+                                Oevent_list const *want, Usz want_begin,
+                                Oevent_list const *got, Usz got_begin) {
+  if (got->dropped_count != want->dropped_count) {
+    fuzz_report_begin(r, kind);
+    fprintf(stderr, "  it dropped %zu events, the reference dropped %zu\n",
+            got->dropped_count, want->dropped_count);
+    return false;
+  }
+  Oevent_iter want_it, got_it;
+  oevent_iter_init_range(&want_it, want, want_begin, want->size);
+  oevent_iter_init_range(&got_it, got, got_begin, got->size);
+  for (Usz i = 0;; ++i) {
+    Oevent const *want_ev = oevent_iter_next(&want_it);
+    Oevent const *got_ev = oevent_iter_next(&got_it);
+    if (!want_ev && !got_ev)
+      return true;
+    if (want_ev && got_ev) {
+      Usz size = oevent_size(want_ev);
+      if (oevent_size(got_ev) == size && memcmp(want_ev, got_ev, size) == 0)
+        continue;
+    }
+    fuzz_report_begin(r, kind);
+    fprintf(stderr, "  event %zu is ", i + 1);
+    if (got_ev)
+      fprintf(stderr, "a %s", oevent_type_name(got_ev->any.oevent_type));
+    else
+      fprintf(stderr, "missing");
+    if (!want_ev)
+      fprintf(stderr, ", the reference output only %zu\n", i);
+    else if (got_ev && got_ev->any.oevent_type == want_ev->any.oevent_type)
+      fprintf(stderr, " with different contents than the reference's\n");
+    else
+      fprintf(stderr, ", the reference's is a %s\n",
+              oevent_type_name(want_ev->any.oevent_type));
+    return false;
+  }
+}
+
+static bool fuzz_compare(Fuzz_report const *r, Engine_kind kind,
+                         Glyph const *want_gbuf, Mark const *want_mbuf,
+                         Glyph const *got_gbuf, Mark const *got_mbuf) {
+  Usz height = r->c->height, width = r->c->width;
+  for (Usz i = 0; i < height * width; ++i) {
+    if (got_gbuf[i] != want_gbuf[i]) {
+      fuzz_report_begin(r, kind);
+      fprintf(stderr,
+              "  the glyph at row %zu, column %zu is '%c', the reference's "
+              "is '%c'\n",
+              i / width, i % width, got_gbuf[i], want_gbuf[i]);
+      return false;
+    }
+  }
+  for (Usz i = 0; i < height * width; ++i) {
+    if (got_mbuf[i] != want_mbuf[i]) {
+      fuzz_report_begin(r, kind);
+      fprintf(stderr,
+              "  the mark at row %zu, column %zu is 0x%02x, the reference's "
+              "is 0x%02x\n",
+              i / width, i % width, got_mbuf[i], want_mbuf[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+typedef struct {
+  Fuzz_case const *c;
+  Fuzz_engine engines[Engine_count];
+  Glyph *ref_gbuf, *view_gbuf;
+  Glyph *before; // The reference's grid before the tick, for reports
+  Mark *ref_mbuf, *view_mbuf;
+  Oevent_list ref_events;
+  // The reference's events from every tick so far, in one list like the one
+  // orca_run_ticks() appends to, so the event limit covers all of them.
+  Oevent_list ref_run_events;
+  Usz tick_event_ends[Fuzz_max_ticks];
+  Fuzz_report report;
+  bool ok;
+} Fuzz_run;
+
+// Appends the reference's events for the tick to `ref_run_events`, keeping
+// the ones that orca_run_ticks() would.
+static void fuzz_append_ref_events(Fuzz_run *run) {
+  Oevent_list *run_events = &run->ref_run_events;
+  Oevent_iter it;
+  oevent_iter_init(&it, &run->ref_events);
+  Oevent const *ev;
+  while ((ev = oevent_iter_next(&it))) {
+    Usz size = oevent_size(ev);
+    Oevent *dest = oevent_list_alloc_item(run_events, size);
+    if (dest)
+      memcpy(dest, ev, size);
+  }
+  run_events->dropped_count += run->ref_events.dropped_count;
+}
+
+// Called by orca_run_ticks() after each tick of Engine_ticks. Runs the
+// reference and the rest of the engines for the same tick, and compares all
+// of them.
+static void fuzz_tick_callback(void *user, Usz tick_number,
+                               Glyph const *gbuffer, Mark const *mbuffer,
+                               Usz height, Usz width) {
+  Fuzz_run *run = user;
+  Fuzz_case const *c = run->c;
+  Usz t = tick_number - c->tick_number;
+  Usz count = height * width;
+  assert(gbuffer == run->engines[Engine_ticks].gbuf);
+  assert(mbuffer == run->engines[Engine_ticks].mbuf);
+  (void)gbuffer;
+  (void)mbuffer;
+  if (!run->ok)
+    return;
+  run->report.tick_index = t;
+  memcpy(run->before, run->ref_gbuf, count * sizeof(Glyph));
+  oevent_list_clear(&run->ref_events);
+  mbuffer_clear(run->ref_mbuf, height, width);
+  orca_run_reference(run->ref_gbuf, run->ref_mbuf, height, width, tick_number,
+                     &run->ref_events, c->random_seed);
+  Usz ref_run_begin = run->ref_run_events.size;
+  fuzz_append_ref_events(run);
+  for (Usz i = 0; i < Engine_count && run->ok; ++i) {
+    Fuzz_engine *e = run->engines + i;
+    fuzz_engine_tick(e, tick_number, c->random_seed);
+    fuzz_engine_view(e, run->view_gbuf, run->view_mbuf);
+    bool ok = fuzz_compare(&run->report, e->kind, run->ref_gbuf,
+                           run->ref_mbuf, run->view_gbuf, run->view_mbuf);
+    // The events of Engine_ticks carry over from one tick to the next, and
+    // this tick's start where orca_run_ticks() said the last one's ended.
+    if (ok && e->kind == Engine_ticks)
+      ok = fuzz_compare_events(&run->report, e->kind, &run->ref_run_events,
+                               ref_run_begin, &e->oevent_list,
+                               t ? run->tick_event_ends[t - 1] : 0);
+    else if (ok)
+      ok = fuzz_compare_events(&run->report, e->kind, &run->ref_events, 0,
+                               &e->oevent_list, 0);
+    for (Usz iy = 0; iy < height && ok && e->stride > width; ++iy) {
+      Usz ix = fuzz_engine_padding_written(e, iy);
+      if (ix) {
+        fuzz_report_begin(&run->report, e->kind);
+        fprintf(stderr, "  it wrote past the width, at row %zu, column %zu\n",
+                iy, ix);
+        ok = false;
+      }
+    }
+    run->ok = ok;
+  }
+}
+
+// Returns false, after printing what differed, if any engine didn't match
+// the reference.
+static bool fuzz_run_case(Fuzz_case const *c) {
+  Usz height = c->height, width = c->width, count = height * width;
+  static Fuzz_run run;
+  run.c = c;
+  run.ref_gbuf = malloc(count * sizeof(Glyph));
+  run.ref_mbuf = malloc(count * sizeof(Mark));
+  run.view_gbuf = malloc(count * sizeof(Glyph));
+  run.view_mbuf = malloc(count * sizeof(Mark));
+  run.before = malloc(count * sizeof(Glyph));
+  memcpy(run.ref_gbuf, c->cells, count * sizeof(Glyph));
+  oevent_list_init(&run.ref_events);
+  oevent_list_init(&run.ref_run_events);
+  if (c->event_limit) {
+    run.ref_events.count_limit = c->event_limit;
+    run.ref_run_events.count_limit = c->event_limit;
+  }
+  for (Usz i = 0; i < Engine_count; ++i)
+    fuzz_engine_init(run.engines + i, (Engine_kind)i, c);
+  run.report = (Fuzz_report){c, 0, run.before};
+  run.ok = true;
+  // Every case is run by Engine_ticks as a single batch, and the rest of the
+  // engines and the reference are stepped along with it from its callback.
+  Fuzz_engine *batch = run.engines + Engine_ticks;
+  orca_run_ticks(batch->gbuf, batch->mbuf, height, width, c->tick_number,
+                 c->ticks, &batch->oevent_list, run.tick_event_ends,
+                 c->random_seed, fuzz_tick_callback, &run);
+  if (!run.ok)
+    fuzz_report_end(&run.report);
+  for (Usz i = 0; i < Engine_count; ++i)
+    fuzz_engine_deinit(run.engines + i);
+  oevent_list_deinit(&run.ref_events);
+  oevent_list_deinit(&run.ref_run_events);
+  free(run.ref_gbuf);
+  free(run.ref_mbuf);
+  free(run.view_gbuf);
+  free(run.view_mbuf);
+  free(run.before);
+  return run.ok;
+}
+
+int LLVMFuzzerTestOneInput(U8 const *data, size_t size);
+int LLVMFuzzerTestOneInput(U8 const *data, size_t size) {
+  static Fuzz_case c;
+  fuzz_case_decode(&c, data, size);
+  if (!fuzz_run_case(&c))
+    abort();
+  return 0;
+}
+
+#ifndef FEAT_LIBFUZZER
+
+// splitmix64, same as gen.
+static U64 fuzz_rand(U64 *state) {
+  U64 z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+static Usz fuzz_rand_below(U64 *state, Usz n) {
+  return (Usz)(fuzz_rand(state) % n);
+}
+
+static U8 fuzz_glyph_byte(char glyph) {
+  char const *found = memchr(fuzz_glyphs + Fuzz_first_glyph, glyph,
+                            sizeof fuzz_glyphs - Fuzz_first_glyph);
+  return (U8)(found - fuzz_glyphs);
+}
+
+// A few small clumps of glyphs in an otherwise empty grid, most of them
+// across or just after the borders between tiles, with some movers to carry
+// glyphs from one tile into another. Operators at the left edge of a tile read
+// and mark the cells to their left, which adds the tile there in the middle of
+// a tick if it's empty. Returns the size of the case.
+static Usz fuzz_make_sparse_cells(U64 *rng, U8 *data) {
+  static char const movers[] = "EWNS";
+  Usz size = Fuzz_header_size;
+  Usz clumps = 1 + fuzz_rand_below(rng, 4);
+  for (Usz i = 0; i < clumps; ++i) {
+    Usz y0 = Sparse_tile_size - 4 + fuzz_rand_below(rng, 8);
+    Usz x0;
+    switch (fuzz_rand_below(rng, 4)) {
+    case 0:
+      y0 = fuzz_rand_below(rng, Fuzz_max_grid_size);
+      x0 = fuzz_rand_below(rng, Fuzz_max_grid_size);
+      break;
+    case 1:
+      x0 = Sparse_tile_size - 4 + fuzz_rand_below(rng, 8);
+      break;
+    default:
+      x0 = Sparse_tile_size;
+      break;
+    }
+    Usz h = 1 + fuzz_rand_below(rng, 3), w = 1 + fuzz_rand_below(rng, 6);
+    Usz glyphs = 1 + fuzz_rand_below(rng, h * w);
+    for (Usz j = 0; j < glyphs; ++j) {
+      data[size++] = (U8)(y0 + fuzz_rand_below(rng, h));
+      data[size++] = (U8)(x0 + fuzz_rand_below(rng, w));
+      data[size++] =
+          fuzz_rand_below(rng, 4) == 0
+              ? fuzz_glyph_byte(movers[fuzz_rand_below(rng, 4)])
+              : (U8)(Fuzz_first_glyph +
+                     fuzz_rand_below(rng, 128 - Fuzz_first_glyph));
+    }
+  }
+  return size;
+}
+
+// Most random cases are small, since that's where operators run into each
+// other and the edges of the grid. One in four is sparse instead. Returns the
+// size of the case.
+static Usz fuzz_make_case(U64 *rng, U8 *data) {
+  for (Usz i = 0; i < 2; ++i)
+    data[i] = (U8)(fuzz_rand_below(rng, 4) == 0
+                       ? fuzz_rand_below(rng, Fuzz_max_grid_size)
+                       : fuzz_rand_below(rng, 16));
+  for (Usz i = 2; i < 7; ++i)
+    data[i] = (U8)fuzz_rand(rng);
+  data[7] = (U8)(fuzz_rand_below(rng, 4) == 0 ? 1 + fuzz_rand_below(rng, 8)
+                                               : 0);
+  data[2] &= (U8)~Fuzz_sparse_flag;
+  if (fuzz_rand_below(rng, 4) == 0) {
+    data[2] |= Fuzz_sparse_flag;
+    return fuzz_make_sparse_cells(rng, data);
+  }
+  Usz count = (1 + (Usz)data[0]) * (1 + (Usz)data[1]);
+  Usz density = fuzz_rand_below(rng, 101);
+  for (Usz i = 0; i < count; ++i) {
+    U8 *cell = data + Fuzz_header_size + i;
+    *cell = 0;
+    if (fuzz_rand_below(rng, 100) < density)
+      *cell = (U8)(Fuzz_first_glyph +
+                   fuzz_rand_below(rng, 128 - Fuzz_first_glyph));
+  }
+  return Fuzz_header_size + count;
+}
+
+static bool fuzz_save_case(char const *path, U8 const *data, Usz size) {
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && ok;
+}
+
+static bool read_u64(char const *str, U64 *out) {
+  char *end;
+  unsigned long long n = strtoull(str, &end, 10);
+  if (end == str || *end != '\0')
+    return false;
+  *out = (U64)n;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  enum { Opt_runs = 256, Opt_seed, Opt_save_case };
+  static struct option fuzz_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"runs", required_argument, 0, Opt_runs},
+      {"seed", required_argument, 0, Opt_seed},
+      {"save-case", required_argument, 0, Opt_save_case},
+      {NULL, 0, NULL, 0}};
+
+  U64 runs = 1000, seed = 1;
+  char const *save_path = NULL;
+  for (;;) {
+    int c = getopt_long(argc, argv, "h", fuzz_options, NULL);
+    if (c == -1)
+      break;
+    switch (c) {
+    case Opt_runs:
+      if (!read_u64(optarg, &runs)) {
+        fprintf(stderr, "Bad runs argument %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case Opt_seed:
+      if (!read_u64(optarg, &seed)) {
+        fprintf(stderr, "Bad seed %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case Opt_save_case:
+      save_path = optarg;
+      break;
+    case 'h':
+      usage();
+      return 0;
+    case '?':
+      usage();
+      return 1;
+    }
+  }
+
+  static U8 data[Fuzz_case_max_size];
+  static Fuzz_case fcase;
+  if (optind < argc) {
+    for (int i = optind; i < argc; ++i) {
+      bool is_stdin = strcmp(argv[i], "-") == 0;
+      FILE *f = is_stdin ? stdin : fopen(argv[i], "rb");
+      if (!f) {
+        fprintf(stderr, "Can't open %s.\n", argv[i]);
+        return 1;
+      }
+      Usz size = fread(data, 1, sizeof data, f);
+      if (!is_stdin)
+        fclose(f);
+      fuzz_case_decode(&fcase, data, size);
+      if (!fuzz_run_case(&fcase)) {
+        fprintf(stderr, "Failed: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  U64 rng = seed;
+  for (U64 i = 0; i < runs; ++i) {
+    Usz size = fuzz_make_case(&rng, data);
+    fuzz_case_decode(&fcase, data, size);
+    if (fuzz_run_case(&fcase))
+      continue;
+    fprintf(stderr, "Failed on case %llu with --seed %llu.\n",
+            (unsigned long long)i + 1, (unsigned long long)seed);
+    if (save_path) {
+      if (!fuzz_save_case(save_path, data, size)) {
+        fprintf(stderr, "Couldn't write the case to %s.\n", save_path);
+        return 1;
+      }
+      fprintf(stderr, "Saved the case to %s.\n", save_path);
+    }
+    return 1;
+  }
+  fprintf(stderr, "%llu random cases, no differences.\n",
+          (unsigned long long)runs);
+  return 0;
+}
+
+#endif
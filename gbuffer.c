@@ -1,9 +1,10 @@
 #include "gbuffer.h"
 
 void gbuffer_copy_subrect(Glyph *src, Glyph *dest, Usz src_height,
-                          Usz src_width, Usz dest_height, Usz dest_width,
-                          Usz src_y, Usz src_x, Usz dest_y, Usz dest_x,
-                          Usz height, Usz width) {
+                          Usz src_width, Usz src_row_stride, Usz dest_height,
+                          Usz dest_width, Usz dest_row_stride, Usz src_y,
+                          Usz src_x, Usz dest_y, Usz dest_x, Usz height,
+                          Usz width) {
   if (src_height <= src_y || src_width <= src_x || dest_height <= dest_y ||
       dest_width <= dest_x)
     return;
@@ -24,18 +25,18 @@ void gbuffer_copy_subrect(Glyph *src, Glyph *dest, Usz src_height,
   if (row_copy_1 < row_copy)
     row_copy = row_copy_1;
   Usz copy_bytes = row_copy * sizeof(Glyph);
-  Glyph *src_p = src + src_y * src_width + src_x;
-  Glyph *dest_p = dest + dest_y * dest_width + dest_x;
+  Glyph *src_p = src + src_y * src_row_stride + src_x;
+  Glyph *dest_p = dest + dest_y * dest_row_stride + dest_x;
   Isz src_stride;
   Isz dest_stride;
   if (src_y >= dest_y) {
-    src_stride = (Isz)src_width;
-    dest_stride = (Isz)dest_width;
+    src_stride = (Isz)src_row_stride;
+    dest_stride = (Isz)dest_row_stride;
   } else {
-    src_p += (ny - 1) * src_width;
-    dest_p += (ny - 1) * dest_width;
-    src_stride = -(Isz)src_width;
-    dest_stride = -(Isz)dest_width;
+    src_p += (ny - 1) * src_row_stride;
+    dest_p += (ny - 1) * dest_row_stride;
+    src_stride = -(Isz)src_row_stride;
+    dest_stride = -(Isz)dest_row_stride;
   }
   Usz iy = 0;
   for (;;) {
@@ -48,8 +49,9 @@ void gbuffer_copy_subrect(Glyph *src, Glyph *dest, Usz src_height,
   }
 }
 
-void gbuffer_fill_subrect(Glyph *gbuffer, Usz f_height, Usz f_width, Usz y,
-                          Usz x, Usz height, Usz width, Glyph fill_char) {
+void gbuffer_fill_subrect(Glyph *gbuffer, Usz f_height, Usz f_width,
+                          Usz f_stride, Usz y, Usz x, Usz height, Usz width,
+                          Glyph fill_char) {
   if (y >= f_height || x >= f_width)
     return;
   Usz rows_0 = f_height - y;
@@ -63,18 +65,98 @@ void gbuffer_fill_subrect(Glyph *gbuffer, Usz f_height, Usz f_width, Usz y,
   if (columns_0 < columns)
     columns = columns_0;
   Usz fill_bytes = columns * sizeof(Glyph);
-  Glyph *p = gbuffer + y * f_width + x;
+  Glyph *p = gbuffer + y * f_stride + x;
   Usz iy = 0;
   for (;;) {
     memset(p, fill_char, fill_bytes);
     ++iy;
     if (iy == rows)
       break;
-    p += f_width;
+    p += f_stride;
   }
 }
 
+// Copies rows of cells between a row-major buffer and a tiled one, in either
+// direction. Both Glyph and Mark are one byte.
+static void tiled_copy_rows(U8 *tiled, U8 *rows, Usz height, Usz width,
+                            Usz stride, bool to_tiled) {
+  Usz across = gbuffer_tiles_across(width);
+  for (Usz y = 0; y < height; ++y) {
+    for (Usz x = 0; x < width; x += Gbuffer_tile_size) {
+      Usz n = width - x < Gbuffer_tile_size ? width - x : Gbuffer_tile_size;
+      U8 *t = tiled + gbuffer_tiled_index(across, y, x);
+      U8 *r = rows + y * stride + x;
+      if (to_tiled)
+        memcpy(t, r, n);
+      else
+        memcpy(r, t, n);
+    }
+  }
+}
+
+void gbuffer_to_tiled(Glyph const *src, Usz height, Usz width, Usz stride,
+                      Glyph *dest) {
+  memset(dest, '.', gbuffer_tiled_cells(height, width) * sizeof(Glyph));
+  tiled_copy_rows((U8 *)dest, (U8 *)src, height, width, stride, true);
+}
+
+void gbuffer_from_tiled(Glyph const *src, Usz height, Usz width, Glyph *dest,
+                        Usz dest_stride) {
+  tiled_copy_rows((U8 *)src, (U8 *)dest, height, width, dest_stride, false);
+}
+
+void mbuffer_from_tiled(Mark const *src, Usz height, Usz width, Mark *dest,
+                        Usz dest_stride) {
+  tiled_copy_rows((U8 *)src, dest, height, width, dest_stride, false);
+}
+
 void mbuffer_clear(Mark *mbuf, Usz height, Usz width) {
   Usz cleared_size = height * width;
   memset(mbuf, 0, cleared_size);
 }
+
+void cbuffer_interleave(Glyph const *gbuf, Mark const *mbuf, Usz height,
+                        Usz width, Usz stride, Cell *dest) {
+  for (Usz y = 0; y < height; ++y) {
+    Glyph const *g_row = gbuf + y * stride;
+    Mark const *m_row = mbuf + y * stride;
+    Cell *c_row = dest + y * width;
+    for (Usz x = 0; x < width; ++x) {
+      c_row[x].glyph = g_row[x];
+      c_row[x].mark = m_row[x];
+    }
+  }
+}
+
+void cbuffer_deinterleave(Cell const *src, Usz height, Usz width,
+                          Glyph *dest_gbuf, Mark *dest_mbuf, Usz dest_stride) {
+  for (Usz y = 0; y < height; ++y) {
+    Cell const *c_row = src + y * width;
+    Glyph *g_row = dest_gbuf + y * dest_stride;
+    Mark *m_row = dest_mbuf + y * dest_stride;
+    for (Usz x = 0; x < width; ++x) {
+      g_row[x] = c_row[x].glyph;
+      m_row[x] = c_row[x].mark;
+    }
+  }
+}
+
+// Clearing one byte out of every two is much slower than a memset(), so the
+// cells are masked 8 bytes at a time instead. The mask is built from bytes,
+// which keeps it the same on big and little endian.
+void cbuffer_clear_marks(Cell *cbuf, Usz height, Usz width) {
+  static U8 const keep_glyphs[8] = {0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0};
+  U64 mask;
+  memcpy(&mask, keep_glyphs, sizeof mask);
+  U8 *bytes = (U8 *)cbuf;
+  Usz size = height * width * sizeof(Cell);
+  Usz i = 0;
+  for (; size - i >= sizeof mask; i += sizeof mask) {
+    U64 word;
+    memcpy(&word, bytes + i, sizeof word);
+    word &= mask;
+    memcpy(bytes + i, &word, sizeof word);
+  }
+  for (; i < size; i += sizeof(Cell))
+    ((Cell *)(bytes + i))->mark = 0;
+}
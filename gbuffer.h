@@ -1,42 +1,88 @@
 #pragma once
 #include "base.h"
 
-ORCA_PURE static inline Glyph gbuffer_peek_relative(Glyph *gbuf, Usz height,
-                                                    Usz width, Usz y, Usz x,
-                                                    Isz delta_y, Isz delta_x) {
+// Glyph and Mark buffers are row-major. `stride` is the distance between the
+// start of one row and the next, which is normally the same as the width. It
+// can be larger when the buffer is a view into memory that has something else
+// at the end of each row, such as the newlines of a mapped .orca file.
+
+ORCA_PURE static inline Glyph
+gbuffer_peek_relative(Glyph *gbuf, Usz height, Usz width, Usz stride, Usz y,
+                      Usz x, Isz delta_y, Isz delta_x) {
   Isz y0 = (Isz)y + delta_y;
   Isz x0 = (Isz)x + delta_x;
   if (y0 < 0 || x0 < 0 || (Usz)y0 >= height || (Usz)x0 >= width)
     return '.';
-  return gbuf[(Usz)y0 * width + (Usz)x0];
+  return gbuf[(Usz)y0 * stride + (Usz)x0];
 }
 
-static inline void gbuffer_poke(Glyph *gbuf, Usz height, Usz width, Usz y,
-                                Usz x, Glyph g) {
+static inline void gbuffer_poke(Glyph *gbuf, Usz height, Usz width, Usz stride,
+                                Usz y, Usz x, Glyph g) {
   assert(y < height && x < width);
   (void)height;
-  gbuf[y * width + x] = g;
+  (void)width;
+  gbuf[y * stride + x] = g;
 }
 
 static inline void gbuffer_poke_relative(Glyph *gbuf, Usz height, Usz width,
-                                         Usz y, Usz x, Isz delta_y, Isz delta_x,
-                                         Glyph g) {
+                                         Usz stride, Usz y, Usz x, Isz delta_y,
+                                         Isz delta_x, Glyph g) {
   Isz y0 = (Isz)y + delta_y;
   Isz x0 = (Isz)x + delta_x;
   if (y0 < 0 || x0 < 0 || (Usz)y0 >= height || (Usz)x0 >= width)
     return;
-  gbuf[(Usz)y0 * width + (Usz)x0] = g;
+  gbuf[(Usz)y0 * stride + (Usz)x0] = g;
 }
 
 ORCA_NOINLINE
 void gbuffer_copy_subrect(Glyph *src, Glyph *dest, Usz src_grid_h,
-                          Usz src_grid_w, Usz dest_grid_h, Usz dest_grid_w,
-                          Usz src_y, Usz src_x, Usz dest_y, Usz dest_x,
-                          Usz height, Usz width);
+                          Usz src_grid_w, Usz src_stride, Usz dest_grid_h,
+                          Usz dest_grid_w, Usz dest_stride, Usz src_y,
+                          Usz src_x, Usz dest_y, Usz dest_x, Usz height,
+                          Usz width);
 
 ORCA_NOINLINE
-void gbuffer_fill_subrect(Glyph *gbuf, Usz grid_h, Usz grid_w, Usz y, Usz x,
-                          Usz height, Usz width, Glyph fill_char);
+void gbuffer_fill_subrect(Glyph *gbuf, Usz grid_h, Usz grid_w, Usz stride,
+                          Usz y, Usz x, Usz height, Usz width,
+                          Glyph fill_char);
+
+// Tiled layout, an alternative to row-major that orca_run_tiled() can run
+// on. The grid is split into 32x32 tiles. Each tile is 1024 consecutive cells
+// in row-major order, and the tiles are stored in row-major order too. The
+// cells above and below a cell are 32 cells away instead of a whole row away,
+// so the VM's accesses to the row below an operator stay within a few cache
+// lines even on very wide grids. The tiles on the right and bottom edges are
+// stored at full size, with the part outside of the grid unused.
+enum {
+  Gbuffer_tile_shift = 5,
+  Gbuffer_tile_size = 1 << Gbuffer_tile_shift,
+  Gbuffer_tile_mask = Gbuffer_tile_size - 1,
+  Gbuffer_tile_cells = Gbuffer_tile_size * Gbuffer_tile_size,
+};
+
+static inline Usz gbuffer_tiles_across(Usz width) {
+  return (width + Gbuffer_tile_mask) >> Gbuffer_tile_shift;
+}
+
+// Number of cells a tiled buffer for a grid of this size needs.
+static inline Usz gbuffer_tiled_cells(Usz height, Usz width) {
+  return gbuffer_tiles_across(height) * gbuffer_tiles_across(width) *
+         Gbuffer_tile_cells;
+}
+
+static inline Usz gbuffer_tiled_index(Usz tiles_across, Usz y, Usz x) {
+  return ((y >> Gbuffer_tile_shift) * tiles_across + (x >> Gbuffer_tile_shift))
+             << (2 * Gbuffer_tile_shift) |
+         (y & Gbuffer_tile_mask) << Gbuffer_tile_shift |
+         (x & Gbuffer_tile_mask);
+}
+
+// Converts between row-major and tiled glyph buffers. The unused cells of the
+// edge tiles are filled with '.'.
+void gbuffer_to_tiled(Glyph const *src, Usz height, Usz width, Usz stride,
+                      Glyph *dest);
+void gbuffer_from_tiled(Glyph const *src, Usz height, Usz width, Glyph *dest,
+                        Usz dest_stride);
 
 typedef enum {
   Mark_flag_none = 0,
@@ -48,38 +94,62 @@ typedef enum {
 } Mark_flags;
 
 ORCA_OK_IF_UNUSED
-static Mark_flags mbuffer_peek(Mark *mbuf, Usz height, Usz width, Usz y,
-                               Usz x) {
+static Mark_flags mbuffer_peek(Mark *mbuf, Usz height, Usz width, Usz stride,
+                               Usz y, Usz x) {
   (void)height;
-  return mbuf[y * width + x];
+  (void)width;
+  return mbuf[y * stride + x];
 }
 
 ORCA_OK_IF_UNUSED
 static Mark_flags mbuffer_peek_relative(Mark *mbuf, Usz height, Usz width,
-                                        Usz y, Usz x, Isz offs_y, Isz offs_x) {
+                                        Usz stride, Usz y, Usz x, Isz offs_y,
+                                        Isz offs_x) {
   Isz y0 = (Isz)y + offs_y;
   Isz x0 = (Isz)x + offs_x;
   if (y0 >= (Isz)height || x0 >= (Isz)width || y0 < 0 || x0 < 0)
     return Mark_flag_none;
-  return mbuf[(Usz)y0 * width + (Usz)x0];
+  return mbuf[(Usz)y0 * stride + (Usz)x0];
 }
 
 ORCA_OK_IF_UNUSED
-static void mbuffer_poke_flags_or(Mark *mbuf, Usz height, Usz width, Usz y,
-                                  Usz x, Mark_flags flags) {
+static void mbuffer_poke_flags_or(Mark *mbuf, Usz height, Usz width,
+                                  Usz stride, Usz y, Usz x, Mark_flags flags) {
   (void)height;
-  mbuf[y * width + x] |= (Mark)flags;
+  (void)width;
+  mbuf[y * stride + x] |= (Mark)flags;
 }
 
 ORCA_OK_IF_UNUSED
 static void mbuffer_poke_relative_flags_or(Mark *mbuf, Usz height, Usz width,
-                                           Usz y, Usz x, Isz offs_y, Isz offs_x,
+                                           Usz stride, Usz y, Usz x,
+                                           Isz offs_y, Isz offs_x,
                                            Mark_flags flags) {
   Isz y0 = (Isz)y + offs_y;
   Isz x0 = (Isz)x + offs_x;
   if (y0 >= (Isz)height || x0 >= (Isz)width || y0 < 0 || x0 < 0)
     return;
-  mbuf[(Usz)y0 * width + (Usz)x0] |= (Mark)flags;
+  mbuf[(Usz)y0 * stride + (Usz)x0] |= (Mark)flags;
 }
 
+// Pass the stride as `width` to also clear the padding of a strided buffer.
+// For a tiled buffer, pass 1 and gbuffer_tiled_cells().
 void mbuffer_clear(Mark *mbuf, Usz height, Usz width);
+// Converts tiled marks back to row-major, like gbuffer_from_tiled().
+void mbuffer_from_tiled(Mark const *src, Usz height, Usz width, Mark *dest,
+                        Usz dest_stride);
+
+// Interleaved layout, an alternative to separate glyph and mark buffers that
+// orca_run_interleaved() can run on. Each cell holds its glyph and its mark
+// next to each other in 16 bits, so an operator reading a port and marking it
+// touches one cache line instead of two. The cells are row-major, and Cell
+// is in base.h.
+
+// Converts between separate glyph and mark buffers and an interleaved one.
+// The interleaved buffer's rows are `width` cells apart.
+void cbuffer_interleave(Glyph const *gbuf, Mark const *mbuf, Usz height,
+                        Usz width, Usz stride, Cell *dest);
+void cbuffer_deinterleave(Cell const *src, Usz height, Usz width,
+                          Glyph *dest_gbuf, Mark *dest_mbuf, Usz dest_stride);
+// Same as mbuffer_clear(), for the marks of an interleaved buffer.
+void cbuffer_clear_marks(Cell *cbuf, Usz height, Usz width);
@@ -0,0 +1,380 @@
+#include "base.h"
+#include "field.h"
+#include <getopt.h>
+
+static ORCA_NOINLINE void usage(void) { // clang-format off
+fprintf(stderr,
+"Usage: gen [options] outfile\n\n"
+"Writes a synthetic .orca grid of any size, made of small patches that keep\n"
+"running forever, for testing how the VM scales. Use - for stdout. The\n"
+"same options and seed always make the same grid. For example:\n"
+"    build/gen --size 4096x4096 --seed 7 big.orca\n"
+"    build/bench big.orca\n\n"
+"Options:\n"
+"    --size <height>x<width>\n"
+"                  Size of the grid.\n"
+"                  Default: 256x256\n"
+"    --density <percent>\n"
+"                  How much of the grid is covered by the rectangles of\n"
+"                  patches, from 0 to 100. Patches of 2 to 4 rows are\n"
+"                  placed in bands 5 rows tall, a column apart, so the\n"
+"                  most they cover is about 55 with all families, 35\n"
+"                  with only clock or io, and 75 with only mover. Even\n"
+"                  then only about 15 in 100 cells are not empty.\n"
+"                  Default: 30\n"
+"    --families <list>\n"
+"                  Comma-separated kinds of patches to use, out of:\n"
+"                    clock      C and D operators counting time.\n"
+"                    track      A clock stepping through a T track.\n"
+"                    io         Delayed bangs on : %% ! ; and = outputs.\n"
+"                    mover      Delayed bangs teleporting E movers down a\n"
+"                               lane, where they hit a wall and vanish.\n"
+"                    generator  R and I operators copied around by G.\n"
+"                  Default: all of them\n"
+"    --seed <number>\n"
+"                  Seed for picking the patches and their arguments.\n"
+"                  Default: 1\n"
+"    -h or --help  Print this message and exit.\n"
+);} // clang-format on
+
+// splitmix64
+static U64 gen_rand(U64 *state) {
+  U64 z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+static Usz gen_rand_below(U64 *state, Usz n) {
+  return (Usz)(gen_rand(state) % n);
+}
+
+// Inclusive of both ends.
+static Glyph gen_rand_digit(U64 *state, Usz min, Usz max) {
+  static char const digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+  return digits[min + gen_rand_below(state, max - min + 1)];
+}
+
+static Glyph gen_rand_of(U64 *state, char const *choices) {
+  return choices[gen_rand_below(state, strlen(choices))];
+}
+
+enum {
+  Gen_stamp_max_height = 4,
+  Gen_stamp_max_width = 24,
+  // Each band of patches is one row taller than the tallest patch, and
+  // patches in a band are one column apart, so that they don't touch.
+  Gen_band_height = Gen_stamp_max_height + 1,
+};
+
+// A patch before it's copied onto the grid. Every patch keeps all of its
+// outputs inside of its own rectangle.
+typedef struct {
+  Glyph cells[Gen_stamp_max_height][Gen_stamp_max_width];
+  Usz height, width;
+} Gen_stamp;
+
+static void gen_stamp_init(Gen_stamp *st, Usz height, Usz width) {
+  memset(st->cells, '.', sizeof st->cells);
+  st->height = height;
+  st->width = width;
+}
+
+static void gen_stamp_put(Gen_stamp *st, Usz y, Usz x, char const *str) {
+  Usz len = strlen(str);
+  memcpy(&st->cells[y][x], str, len);
+}
+
+// The arguments are drawn one at a time in separate statements, because the
+// order that the parts of an initializer or the arguments of a call are
+// evaluated in is unspecified, and the same seed should make the same grid
+// with any compiler.
+
+// A left argument, an operator and a right argument.
+static void gen_stamp_put_oper(Gen_stamp *st, Usz y, Usz x, Glyph left,
+                               Glyph oper, Glyph right) {
+  st->cells[y][x] = left;
+  st->cells[y][x + 1] = oper;
+  st->cells[y][x + 2] = right;
+}
+
+//   1C8.2D4
+//   .0...*.
+static void gen_patch_clock(Gen_stamp *st, U64 *rng) {
+  gen_stamp_init(st, 2, 7);
+  Glyph rate = gen_rand_digit(rng, 1, 4);
+  gen_stamp_put_oper(st, 0, 0, rate, 'C', gen_rand_digit(rng, 2, 9));
+  rate = gen_rand_digit(rng, 1, 4);
+  gen_stamp_put_oper(st, 0, 4, rate, 'D', gen_rand_digit(rng, 2, 8));
+}
+
+//   1C4.....
+//   .04T0123
+//   ...0....
+static void gen_patch_track(Gen_stamp *st, U64 *rng) {
+  Usz len = 3 + gen_rand_below(rng, 6);
+  gen_stamp_init(st, 3, 4 + len);
+  Glyph len_g = gen_rand_digit(rng, len, len);
+  gen_stamp_put_oper(st, 0, 0, gen_rand_digit(rng, 1, 4), 'C', len_g);
+  gen_stamp_put_oper(st, 1, 1, '0', len_g, 'T');
+  for (Usz i = 0; i < len; ++i)
+    st->cells[1][4 + i] = gen_rand_of(rng, "0123456789CDEFGABcdfga");
+}
+
+//   .2D4.....
+//   ...:03C4.
+static void gen_patch_io(Gen_stamp *st, U64 *rng) {
+  char args[6] = {0};
+  switch (gen_rand_below(rng, 5)) {
+  case 0:
+  case 1:
+    args[0] = gen_rand_below(rng, 2) ? ':' : '%';
+    args[1] = gen_rand_digit(rng, 0, 15); // Channel
+    args[2] = gen_rand_digit(rng, 2, 6);  // Octave
+    args[3] = gen_rand_of(rng, "CDEFGABcdfga");
+    args[4] = gen_rand_digit(rng, 4, 15); // Velocity
+    break;
+  case 2:
+    args[0] = '!';
+    args[1] = gen_rand_digit(rng, 0, 15); // Channel
+    args[2] = gen_rand_digit(rng, 0, 35); // Control
+    args[3] = gen_rand_digit(rng, 0, 35); // Value
+    break;
+  default:
+    // A UDP message, or an OSC path and two arguments.
+    args[0] = gen_rand_below(rng, 2) ? ';' : '=';
+    args[1] = gen_rand_digit(rng, 10, 35);
+    args[2] = gen_rand_digit(rng, 0, 35);
+    args[3] = gen_rand_digit(rng, 0, 35);
+    break;
+  }
+  gen_stamp_init(st, 2, 3 + strlen(args));
+  Glyph rate = gen_rand_digit(rng, 1, 4);
+  gen_stamp_put_oper(st, 0, 1, rate, 'D', gen_rand_digit(rng, 2, 8));
+  gen_stamp_put(st, 1, 3, args);
+}
+
+// The E is copied into the teleporter's input by J, which keeps it from
+// moving off on its own. The D's right argument is the E, so it bangs every
+// 14 ticks (or a multiple of that), by which time the last E has usually
+// reached the wall.
+//
+//   .1DE........
+//   ...J........
+//   10xE........
+//   ...........0
+static void gen_patch_mover(Gen_stamp *st, U64 *rng) {
+  Usz lane = 4 + gen_rand_below(rng, 16);
+  gen_stamp_init(st, 4, 3 + lane + 1);
+  gen_stamp_put_oper(st, 0, 1, gen_rand_digit(rng, 1, 4), 'D', 'E');
+  st->cells[1][3] = 'J';
+  gen_stamp_put(st, 2, 0, "10x");
+  st->cells[3][3 + lane] = '0';
+}
+
+//   ....1R9
+//   .001G5.
+//   ....5..
+static void gen_patch_generator(Gen_stamp *st, U64 *rng) {
+  gen_stamp_init(st, 3, 7);
+  Glyph left = gen_rand_digit(rng, 0, 4);
+  Glyph oper = gen_rand_below(rng, 2) ? 'R' : 'I';
+  gen_stamp_put_oper(st, 0, 4, left, oper, gen_rand_digit(rng, 5, 35));
+  gen_stamp_put(st, 1, 1, "001G");
+}
+
+typedef void Gen_patch_fn(Gen_stamp *st, U64 *rng);
+
+typedef struct {
+  char const *name;
+  Gen_patch_fn *fn;
+} Gen_family;
+
+static Gen_family const gen_families[] = {
+    {"clock", gen_patch_clock},   {"track", gen_patch_track},
+    {"io", gen_patch_io},         {"mover", gen_patch_mover},
+    {"generator", gen_patch_generator},
+};
+
+typedef struct {
+  Usz patches, filled_cells;
+} Gen_stats;
+
+// Lays the grid out in bands, and walks along each band, placing a patch
+// whenever the part walked so far is less covered than `density` asks for,
+// and otherwise skipping a few columns, so that the patches are spread out
+// instead of packed at the start of each band.
+static void gen_fill(Field *field, double density, Gen_family const **families,
+                     Usz family_count, U64 *rng, Gen_stats *stats) {
+  Usz height = field->height, width = field->width;
+  Gen_stamp st;
+  stats->patches = 0;
+  stats->filled_cells = 0;
+  for (Usz band_y = 0; band_y < height; band_y += Gen_band_height) {
+    Usz band_h = height - band_y < Gen_band_height ? height - band_y
+                                                   : Gen_band_height;
+    double covered = 0;
+    Usz x = 0;
+    while (x < width) {
+      if (covered >= density * (double)(x * Gen_band_height)) {
+        x += 1 + gen_rand_below(rng, 4);
+        continue;
+      }
+      families[gen_rand_below(rng, family_count)]->fn(&st, rng);
+      if (st.height > band_h || x + st.width > width) {
+        ++x;
+        continue;
+      }
+      for (Usz y = 0; y < st.height; ++y) {
+        Glyph *row = field->buffer + (band_y + y) * field->stride + x;
+        memcpy(row, st.cells[y], st.width);
+        for (Usz i = 0; i < st.width; ++i)
+          stats->filled_cells += st.cells[y][i] != '.';
+      }
+      ++stats->patches;
+      covered += (double)(st.height * st.width);
+      x += st.width + 1;
+    }
+  }
+}
+
+static bool read_grid_size(char const *str, Usz *out_height, Usz *out_width) {
+  unsigned long h, w;
+  char x;
+  if (sscanf(str, "%lu%c%lu", &h, &x, &w) != 3 || x != 'x')
+    return false;
+  if (h == 0 || w == 0 || h > ORCA_Y_MAX || w > ORCA_X_MAX)
+    return false;
+  *out_height = (Usz)h;
+  *out_width = (Usz)w;
+  return true;
+}
+
+// Returns false if any name in the list isn't a family.
+static bool read_families(char const *list, Gen_family const **out,
+                          Usz *out_count) {
+  Usz count = 0;
+  char const *p = list;
+  for (;;) {
+    char const *comma = strchr(p, ',');
+    Usz len = comma ? (Usz)(comma - p) : strlen(p);
+    bool found = false;
+    for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(gen_families); ++i) {
+      if (strlen(gen_families[i].name) == len &&
+          strncmp(p, gen_families[i].name, len) == 0) {
+        bool dupe = false;
+        for (Usz j = 0; j < count; ++j)
+          dupe |= out[j] == gen_families + i;
+        if (!dupe)
+          out[count++] = gen_families + i;
+        found = true;
+      }
+    }
+    if (!found)
+      return false;
+    if (!comma)
+      break;
+    p = comma + 1;
+  }
+  *out_count = count;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  enum { Opt_size = 256, Opt_density, Opt_families, Opt_seed };
+  static struct option gen_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"size", required_argument, 0, Opt_size},
+      {"density", required_argument, 0, Opt_density},
+      {"families", required_argument, 0, Opt_families},
+      {"seed", required_argument, 0, Opt_seed},
+      {NULL, 0, NULL, 0}};
+
+  Usz height = 256, width = 256;
+  double density = 0.3;
+  U64 seed = 1;
+  Gen_family const *families[ORCA_ARRAY_COUNTOF(gen_families)];
+  Usz family_count = ORCA_ARRAY_COUNTOF(gen_families);
+  for (Usz i = 0; i < family_count; ++i)
+    families[i] = gen_families + i;
+
+  for (;;) {
+    int c = getopt_long(argc, argv, "h", gen_options, NULL);
+    if (c == -1)
+      break;
+    switch (c) {
+    case Opt_size:
+      if (!read_grid_size(optarg, &height, &width)) {
+        fprintf(stderr,
+                "Bad size argument %s.\n"
+                "Must be <height>x<width>, like 4096x4096.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case Opt_density: {
+      char *end;
+      double d = strtod(optarg, &end);
+      if (end == optarg || *end != '\0' || !(d >= 0 && d <= 100)) {
+        fprintf(stderr, "Bad density %s.\nMust be from 0 to 100.\n", optarg);
+        return 1;
+      }
+      density = d / 100;
+      break;
+    }
+    case Opt_families:
+      if (!read_families(optarg, families, &family_count)) {
+        fprintf(stderr,
+                "Bad families argument %s.\n"
+                "Must be a list of clock, track, io, mover and generator.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case Opt_seed: {
+      char *end;
+      unsigned long long n = strtoull(optarg, &end, 10);
+      if (end == optarg || *end != '\0') {
+        fprintf(stderr, "Bad seed %s.\n", optarg);
+        return 1;
+      }
+      seed = (U64)n;
+      break;
+    }
+    case 'h':
+      usage();
+      return 0;
+    case '?':
+      usage();
+      return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, optind == argc ? "No output file.\n"
+                                   : "Only one output file, please.\n");
+    usage();
+    return 1;
+  }
+  char const *out_file = argv[optind];
+  bool to_stdout = strcmp(out_file, "-") == 0;
+  FILE *f = to_stdout ? stdout : fopen(out_file, "w");
+  if (!f) {
+    fprintf(stderr, "Can't open %s for writing.\n", out_file);
+    return 1;
+  }
+  Field field;
+  field_init_fill(&field, height, width, '.');
+  U64 rng = seed;
+  Gen_stats stats;
+  gen_fill(&field, density, families, family_count, &rng, &stats);
+  field_fput(&field, f);
+  int exit_code = 0;
+  if (ferror(f) || (!to_stdout && fclose(f) != 0)) {
+    fprintf(stderr, "Error writing %s.\n", out_file);
+    exit_code = 1;
+  }
+  fprintf(stderr, "%zux%zu grid, %zu patches, %zu cells not empty.\n",
+          height, width, stats.patches, stats.filled_cells);
+  field_deinit(&field);
+  return exit_code;
+}
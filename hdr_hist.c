@@ -0,0 +1,77 @@
+#include "hdr_hist.h"
+
+enum { Sub_count = 16, Linear_count = 32 };
+
+static Usz hdr_hist_msb(U64 v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - (Usz)__builtin_clzll(v);
+#else
+  Usz msb = 0;
+  while (v >>= 1)
+    ++msb;
+  return msb;
+#endif
+}
+
+static Usz hdr_hist_index_of(U64 v) {
+  if (v < Linear_count)
+    return (Usz)v;
+  Usz shift = hdr_hist_msb(v) - 4;
+  Usz top = (Usz)(v >> shift); // 16..31
+  return Linear_count + (shift - 1) * Sub_count + (top - Sub_count);
+}
+
+static void hdr_hist_bucket_bounds(Usz index, U64 *low, U64 *high) {
+  if (index < Linear_count) {
+    *low = *high = index;
+    return;
+  }
+  Usz shift = (index - Linear_count) / Sub_count + 1;
+  U64 top = (index - Linear_count) % Sub_count + Sub_count;
+  *low = top << shift;
+  *high = ((top + 1) << shift) - 1;
+}
+
+void hdr_hist_reset(Hdr_hist *h) { memset(h, 0, sizeof(Hdr_hist)); }
+
+void hdr_hist_record(Hdr_hist *h, U64 value) {
+  ++h->counts[hdr_hist_index_of(value)];
+  ++h->total_count;
+  h->sum += value;
+  if (value > h->max)
+    h->max = value;
+}
+
+U64 hdr_hist_percentile(Hdr_hist const *h, double percentile) {
+  if (h->total_count == 0)
+    return 0;
+  double want = percentile / 100.0 * (double)h->total_count;
+  U64 seen = 0;
+  for (Usz i = 0; i < Hdr_hist_bucket_count; ++i) {
+    seen += h->counts[i];
+    if (seen > 0 && (double)seen >= want) {
+      U64 low, high;
+      hdr_hist_bucket_bounds(i, &low, &high);
+      return high < h->max ? high : h->max;
+    }
+  }
+  return h->max;
+}
+
+U64 hdr_hist_mean(Hdr_hist const *h) {
+  return h->total_count ? h->sum / h->total_count : 0;
+}
+
+void hdr_hist_fput_buckets(FILE *stream, Hdr_hist const *h) {
+  U64 seen = 0;
+  for (Usz i = 0; i < Hdr_hist_bucket_count; ++i) {
+    if (h->counts[i] == 0)
+      continue;
+    seen += h->counts[i];
+    U64 low, high;
+    hdr_hist_bucket_bounds(i, &low, &high);
+    fprintf(stream, "  %12llu %12llu %10lu %9.5f\n", (unsigned long long)low,
+            (unsigned long long)high, (unsigned long)h->counts[i],
+            100.0 * (double)seen / (double)h->total_count);
+  }
+}
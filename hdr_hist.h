@@ -0,0 +1,29 @@
+#pragma once
+#include "base.h"
+#include <stdio.h> // FILE cannot be forward declared
+
+// Hdr_hist is a histogram of durations in nanoseconds, like HdrHistogram,
+// covering 1 ns up to hundreds of years. Values below 32 get a bucket each.
+// Above that, each power of two is split into 16 buckets of equal width, so a
+// bucket is at most 1/16 (6.25%) as wide as the values in it.
+//
+// It's a flat array with no allocations, so recording a value is cheap
+// enough to do for every tick and every frame.
+
+enum { Hdr_hist_bucket_count = 32 + 59 * 16 };
+
+typedef struct {
+  U32 counts[Hdr_hist_bucket_count];
+  U64 total_count;
+  U64 sum, max;
+} Hdr_hist;
+
+void hdr_hist_reset(Hdr_hist *h);
+void hdr_hist_record(Hdr_hist *h, U64 value);
+// The smallest value that `percentile` percent of the recorded values are at
+// or below, rounded up to the top of its bucket. 0 if nothing was recorded.
+U64 hdr_hist_percentile(Hdr_hist const *h, double percentile);
+U64 hdr_hist_mean(Hdr_hist const *h);
+// Writes a line for each bucket that has a count: the range of values in the
+// bucket, its count, and the running percentile.
+void hdr_hist_fput_buckets(FILE *stream, Hdr_hist const *h);
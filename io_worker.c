@@ -0,0 +1,118 @@
+#include "io_worker.h"
+#include "trace.h"
+#include <pthread.h>
+
+typedef struct {
+  Io_job *first, *last;
+} Io_job_queue;
+
+static void io_job_queue_put(Io_job_queue *q, Io_job *job) {
+  job->next = NULL;
+  if (q->last)
+    q->last->next = job;
+  else
+    q->first = job;
+  q->last = job;
+}
+
+static Io_job *io_job_queue_take(Io_job_queue *q) {
+  Io_job *job = q->first;
+  if (job) {
+    q->first = job->next;
+    if (!q->first)
+      q->last = NULL;
+  }
+  return job;
+}
+
+struct Io_worker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake, idle;
+  Io_job_queue todo, done;
+  Usz running; // Jobs taken from `todo` that haven't been put on `done` yet
+  bool has_thread, quit;
+};
+
+static void *io_worker_main(void *arg) {
+  Io_worker *w = arg;
+  trace_name_thread("io worker");
+  pthread_mutex_lock(&w->lock);
+  for (;;) {
+    Io_job *job = io_job_queue_take(&w->todo);
+    if (!job) {
+      if (w->quit)
+        break;
+      pthread_cond_wait(&w->wake, &w->lock);
+      continue;
+    }
+    ++w->running;
+    pthread_mutex_unlock(&w->lock);
+    job->run(job);
+    pthread_mutex_lock(&w->lock);
+    --w->running;
+    io_job_queue_put(&w->done, job);
+    if (!w->todo.first && w->running == 0)
+      pthread_cond_broadcast(&w->idle);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+Io_worker *io_worker_create(void) {
+  Io_worker *w = calloc(1, sizeof(Io_worker));
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->wake, NULL);
+  pthread_cond_init(&w->idle, NULL);
+  w->has_thread = pthread_create(&w->thread, NULL, io_worker_main, w) == 0;
+  return w;
+}
+
+void io_worker_destroy(Io_worker *w, Io_job_fn *free_job) {
+  if (w->has_thread) {
+    pthread_mutex_lock(&w->lock);
+    w->quit = true;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+  }
+  Io_job *job;
+  while ((job = io_job_queue_take(&w->done))) {
+    if (free_job)
+      free_job(job);
+  }
+  pthread_cond_destroy(&w->idle);
+  pthread_cond_destroy(&w->wake);
+  pthread_mutex_destroy(&w->lock);
+  free(w);
+}
+
+void io_worker_push(Io_worker *w, Io_job *job) {
+  if (!w->has_thread) {
+    job->run(job);
+    io_job_queue_put(&w->done, job);
+    return;
+  }
+  pthread_mutex_lock(&w->lock);
+  io_job_queue_put(&w->todo, job);
+  pthread_cond_signal(&w->wake);
+  pthread_mutex_unlock(&w->lock);
+}
+
+Io_job *io_worker_pop_done(Io_worker *w) {
+  if (!w->has_thread)
+    return io_job_queue_take(&w->done);
+  pthread_mutex_lock(&w->lock);
+  Io_job *job = io_job_queue_take(&w->done);
+  pthread_mutex_unlock(&w->lock);
+  return job;
+}
+
+void io_worker_wait_idle(Io_worker *w) {
+  if (!w->has_thread)
+    return;
+  pthread_mutex_lock(&w->lock);
+  while (w->todo.first || w->running > 0)
+    pthread_cond_wait(&w->idle, &w->lock);
+  pthread_mutex_unlock(&w->lock);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "base.h"
+
+// A background thread for slow file I/O, so that saving doesn't stall the
+// main loop (and the timing of the events it sends.) Jobs are run one at a
+// time, in the order they were pushed. When a job has run, it's put on a done
+// queue, which the main loop polls to report the result and free the job.
+//
+// Everything a job needs has to be copied into it when it's pushed, since the
+// main loop keeps going while it runs.
+
+typedef struct Io_job Io_job;
+typedef void Io_job_fn(Io_job *job);
+
+// Embed this as the first member of a struct that holds the job's data.
+struct Io_job {
+  Io_job *next;
+  Io_job_fn *run; // Called on the worker thread
+};
+
+typedef struct Io_worker Io_worker;
+
+// If the thread can't be started, jobs are run immediately by
+// io_worker_push() instead. Never returns NULL.
+Io_worker *io_worker_create(void);
+// Waits for the jobs that were already pushed. Any jobs on the done queue are
+// passed to `free_job`, which may be NULL.
+void io_worker_destroy(Io_worker *w, Io_job_fn *free_job);
+
+void io_worker_push(Io_worker *w, Io_job *job);
+// Returns the oldest job that has finished running, or NULL. Doesn't block.
+Io_job *io_worker_pop_done(Io_worker *w);
+// Blocks until every job that was pushed has run.
+void io_worker_wait_idle(Io_worker *w);
@@ -0,0 +1,485 @@
+#include "base.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static ORCA_NOINLINE void usage(void) { // clang-format off
+fprintf(stderr,
+"Usage: latency [options]\n\n"
+"Measures how late orca's UDP output leaves the process. A local UDP sink\n"
+"on 127.0.0.1 timestamps every datagram from an orca playing a grid that\n"
+"sends one datagram per tick, and compares the times with the ideal tick\n"
+"schedule for the tempo. orca runs in a pseudo-terminal with its own\n"
+"temporary config, so your settings aren't touched. Nothing leaves the\n"
+"loopback interface. For example:\n"
+"    ./tool build orca && ./tool build latency\n"
+"    build/latency --ticks 1000\n\n"
+"Options:\n"
+"    --orca <path>     The orca binary to run.\n"
+"                      Default: build/orca\n"
+"    --bpm <number>    Tempo to play at.\n"
+"                      Default: 480\n"
+"    --ticks <number>  Number of ticks to measure in each run.\n"
+"                      Default: 400\n"
+"    --load <number>   Number of busy processes to run alongside orca for\n"
+"                      the runs under load. 0 skips those runs.\n"
+"                      Default: the number of online CPUs\n"
+"    -h or --help      Print this message and exit.\n"
+"\n"
+"orca is run with and without --strict-timing, each with and without the\n"
+"load. Lateness is how long after its place in the ideal schedule each\n"
+"datagram arrived, where the schedule is lined up so that the earliest\n"
+"datagram is on time. Jitter is how far the time between two datagrams\n"
+"was from one tick.\n"
+);} // clang-format on
+
+// The grid orca plays. D bangs the ; every tick, which sends the glyph that C
+// writes next to it, so each datagram says which tick (mod 35) it came from,
+// and any that don't arrive can be counted.
+static char const latency_grid[] = ".1D1Cz\n"
+                                   "..*;..\n";
+enum { Latency_tick_mod = 35 };
+
+typedef struct {
+  char const *orca_path;
+  Usz bpm, ticks;
+  char const *tmp_dir;
+  char const *grid_path;
+} Latency_opts;
+
+typedef struct {
+  U64 *arrivals_ns;
+  Usz *tick_indices;
+  Usz count, dropped;
+} Latency_samples;
+
+static U64 latency_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (U64)ts.tv_sec * UINT64_C(1000000000) + (U64)ts.tv_nsec;
+}
+
+static Usz latency_index_of(char c) {
+  if (c >= '0' && c <= '9')
+    return (Usz)(c - '0');
+  if (c >= 'a' && c <= 'z')
+    return (Usz)(c - 'a' + 10);
+  return 0;
+}
+
+static bool latency_write_file(char const *path, char const *text) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  fputs(text, f);
+  return fclose(f) == 0;
+}
+
+// Busy processes for the runs under load. They spin until they're killed.
+static void latency_start_load(pid_t *pids, Usz count) {
+  for (Usz i = 0; i < count; ++i) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      volatile U64 spin = 0;
+      for (;;)
+        ++spin;
+    }
+    pids[i] = pid;
+  }
+}
+
+static void latency_stop_load(pid_t *pids, Usz count) {
+  for (Usz i = 0; i < count; ++i) {
+    if (pids[i] <= 0)
+      continue;
+    kill(pids[i], SIGKILL);
+    waitpid(pids[i], NULL, 0);
+  }
+}
+
+// Starts orca on the slave side of a new pseudo-terminal, and returns the
+// master side, which has to be read from so that orca doesn't block while
+// drawing. Returns -1 on failure.
+static int latency_spawn_orca(Latency_opts const *opts, bool strict_timing,
+                              pid_t *out_pid) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    if (master >= 0)
+      close(master);
+    return -1;
+  }
+  char const *slave_name = ptsname(master);
+  if (!slave_name) {
+    close(master);
+    return -1;
+  }
+  struct winsize ws = {0};
+  ws.ws_row = 40;
+  ws.ws_col = 120;
+  ioctl(master, TIOCSWINSZ, &ws);
+  char bpm_str[32];
+  snprintf(bpm_str, sizeof bpm_str, "%zu", opts->bpm);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(master);
+    return -1;
+  }
+  if (pid == 0) {
+    setsid();
+    int slave = open(slave_name, O_RDWR);
+    if (slave < 0)
+      _exit(127);
+    dup2(slave, 0);
+    dup2(slave, 1);
+    dup2(slave, 2);
+    if (slave > 2)
+      close(slave);
+    close(master);
+    setenv("TERM", "xterm", 1);
+    setenv("XDG_CONFIG_HOME", opts->tmp_dir, 1);
+    char const *argv[6];
+    Usz argc = 0;
+    argv[argc++] = opts->orca_path;
+    argv[argc++] = "--bpm";
+    argv[argc++] = bpm_str;
+    if (strict_timing)
+      argv[argc++] = "--strict-timing";
+    argv[argc++] = opts->grid_path;
+    argv[argc] = NULL;
+    execv(opts->orca_path, (char *const *)argv);
+    _exit(127);
+  }
+  *out_pid = pid;
+  return master;
+}
+
+static void latency_drain(int fd) {
+  char junk[4096];
+  while (read(fd, junk, sizeof junk) > 0) {
+  }
+}
+
+static void latency_send_key(int master, char key) {
+  ssize_t n = write(master, &key, 1);
+  (void)n;
+}
+
+// Plays the grid in orca and records when each datagram arrives. Returns
+// false if orca couldn't be started or stopped sending.
+static bool latency_run(Latency_opts const *opts, int sock, bool strict_timing,
+                        Latency_samples *out) {
+  pid_t pid;
+  int master = latency_spawn_orca(opts, strict_timing, &pid);
+  if (master < 0) {
+    fprintf(stderr, "Couldn't start %s in a pseudo-terminal.\n",
+            opts->orca_path);
+    return false;
+  }
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  // Throw away anything left over from the previous run.
+  char buf[64];
+  while (recv(sock, buf, sizeof buf, MSG_DONTWAIT) > 0) {
+  }
+  out->count = 0;
+  out->dropped = 0;
+  // orca starts playing as soon as it has loaded the grid.
+  U64 last_arrival = latency_now_ns();
+  bool ok = true;
+  Usz prev_index = 0;
+  while (out->count < opts->ticks) {
+    struct pollfd fds[2] = {{master, POLLIN, 0}, {sock, POLLIN, 0}};
+    poll(fds, 2, 10);
+    U64 now = latency_now_ns();
+    if (fds[1].revents & POLLIN) {
+      ssize_t n = recv(sock, buf, sizeof buf, 0);
+      // orca also sends some OSC messages of its own, like /orca/bpm when it
+      // starts. Those are longer than one byte.
+      if (n == 1) {
+        Usz index = latency_index_of(buf[0]);
+        Usz tick = 0;
+        if (out->count > 0) {
+          Usz step = (index + Latency_tick_mod - prev_index) % Latency_tick_mod;
+          if (step == 0)
+            step = Latency_tick_mod;
+          out->dropped += step - 1;
+          tick = out->tick_indices[out->count - 1] + step;
+        }
+        prev_index = index;
+        out->arrivals_ns[out->count] = now;
+        out->tick_indices[out->count] = tick;
+        ++out->count;
+        last_arrival = now;
+      }
+    }
+    if (fds[0].revents & (POLLIN | POLLHUP))
+      latency_drain(master);
+    if (now - last_arrival > UINT64_C(5000000000)) {
+      fprintf(stderr,
+              "No datagrams from orca for 5 seconds, after %zu. Is %s the\n"
+              "right binary?\n",
+              out->count, opts->orca_path);
+      ok = false;
+      break;
+    }
+    if (waitpid(pid, NULL, WNOHANG) == pid) {
+      fprintf(stderr, "orca exited early.\n");
+      close(master);
+      return false;
+    }
+  }
+  // Ctrl+Q quits.
+  latency_send_key(master, '\021');
+  U64 quit_at = latency_now_ns();
+  for (;;) {
+    latency_drain(master);
+    if (waitpid(pid, NULL, WNOHANG) == pid)
+      break;
+    if (latency_now_ns() - quit_at > UINT64_C(2000000000)) {
+      kill(pid, SIGKILL);
+      waitpid(pid, NULL, 0);
+      break;
+    }
+    struct timespec ts = {0, 10 * 1000 * 1000};
+    nanosleep(&ts, NULL);
+  }
+  close(master);
+  return ok;
+}
+
+static int latency_compare_u64(void const *a, void const *b) {
+  U64 x = *(U64 const *)a, y = *(U64 const *)b;
+  return (x > y) - (x < y);
+}
+
+static char const *const latency_bucket_names[] = {
+    "<50us", "<100us", "<250us", "<500us", "<1ms", "<2ms", "<5ms", ">=5ms"};
+static U64 const latency_bucket_limits_ns[] = {50000,   100000,  250000,
+                                               500000,  1000000, 2000000,
+                                               5000000, UINT64_MAX};
+
+static void latency_histogram(U64 const *values_ns, Usz count, Usz *buckets) {
+  for (Usz b = 0; b < ORCA_ARRAY_COUNTOF(latency_bucket_limits_ns); ++b)
+    buckets[b] = 0;
+  for (Usz i = 0; i < count; ++i) {
+    Usz b = 0;
+    while (values_ns[i] >= latency_bucket_limits_ns[b])
+      ++b;
+    ++buckets[b];
+  }
+}
+
+// Sorts `values_ns` in place. Percentiles are nearest-rank.
+static void latency_print_stats(char const *name, U64 *values_ns, Usz count) {
+  qsort(values_ns, count, sizeof(U64), latency_compare_u64);
+  printf("  %-9s min %8.1f  median %8.1f  p99 %8.1f  max %8.1f us\n", name,
+         (double)values_ns[0] / 1e3, (double)values_ns[(count - 1) / 2] / 1e3,
+         (double)values_ns[(count * 99 + 99) / 100 - 1] / 1e3,
+         (double)values_ns[count - 1] / 1e3);
+}
+
+static void latency_report(Latency_opts const *opts, char const *title,
+                           Latency_samples const *s) {
+  Usz count = s->count;
+  printf("%s: %zu datagrams, %zu dropped\n", title, count, s->dropped);
+  if (count < 2)
+    return;
+  double tick_ns = 60.0 * 1e9 / (double)(opts->bpm * 4);
+  U64 *lateness = malloc(count * sizeof(U64));
+  U64 *jitter = malloc((count - 1) * sizeof(U64));
+  // Line the schedule up with the earliest datagram.
+  double earliest = 0;
+  for (Usz i = 0; i < count; ++i) {
+    double offset = (double)(s->arrivals_ns[i] - s->arrivals_ns[0]) -
+                    (double)s->tick_indices[i] * tick_ns;
+    if (i == 0 || offset < earliest)
+      earliest = offset;
+  }
+  for (Usz i = 0; i < count; ++i) {
+    double offset = (double)(s->arrivals_ns[i] - s->arrivals_ns[0]) -
+                    (double)s->tick_indices[i] * tick_ns;
+    lateness[i] = (U64)(offset - earliest);
+  }
+  for (Usz i = 1; i < count; ++i) {
+    double ideal = (double)(s->tick_indices[i] - s->tick_indices[i - 1]) *
+                   tick_ns;
+    double actual = (double)(s->arrivals_ns[i] - s->arrivals_ns[i - 1]);
+    double diff = actual - ideal;
+    jitter[i - 1] = (U64)(diff < 0 ? -diff : diff);
+  }
+  enum { Buckets = ORCA_ARRAY_COUNTOF(latency_bucket_limits_ns) };
+  Usz late_buckets[Buckets], jitter_buckets[Buckets];
+  latency_histogram(lateness, count, late_buckets);
+  latency_histogram(jitter, count - 1, jitter_buckets);
+  latency_print_stats("lateness", lateness, count);
+  latency_print_stats("jitter", jitter, count - 1);
+  printf("  %-8s %18s %18s\n", "", "lateness", "jitter");
+  for (Usz b = 0; b < Buckets; ++b) {
+    char late_bar[11], jitter_bar[11];
+    Usz late_len = (late_buckets[b] * 10 + count - 1) / count;
+    Usz jitter_len = (jitter_buckets[b] * 10 + count - 2) / (count - 1);
+    memset(late_bar, '#', late_len);
+    late_bar[late_len] = '\0';
+    memset(jitter_bar, '#', jitter_len);
+    jitter_bar[jitter_len] = '\0';
+    printf("  %-8s %6zu %-11s %6zu %-11s\n", latency_bucket_names[b],
+           late_buckets[b], late_bar, jitter_buckets[b], jitter_bar);
+  }
+  free(lateness);
+  free(jitter);
+}
+
+static bool read_count(char const *str, Usz *out) {
+  char *end;
+  long n = strtol(str, &end, 10);
+  if (end == str || *end != '\0' || n < 0)
+    return false;
+  *out = (Usz)n;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  enum { Opt_orca = 256, Opt_bpm, Opt_ticks, Opt_load };
+  static struct option latency_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"orca", required_argument, 0, Opt_orca},
+      {"bpm", required_argument, 0, Opt_bpm},
+      {"ticks", required_argument, 0, Opt_ticks},
+      {"load", required_argument, 0, Opt_load},
+      {NULL, 0, NULL, 0}};
+
+  Latency_opts opts = {"build/orca", 480, 400, NULL, NULL};
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  Usz load = cpus > 0 ? (Usz)cpus : 1;
+
+  for (;;) {
+    int c = getopt_long(argc, argv, "h", latency_options, NULL);
+    if (c == -1)
+      break;
+    switch (c) {
+    case Opt_orca:
+      opts.orca_path = optarg;
+      break;
+    case Opt_bpm:
+      if (!read_count(optarg, &opts.bpm) || opts.bpm == 0) {
+        fprintf(stderr, "Bad bpm %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case Opt_ticks:
+      if (!read_count(optarg, &opts.ticks) || opts.ticks < 2) {
+        fprintf(stderr, "Bad tick count %s.\nMust be at least 2.\n", optarg);
+        return 1;
+      }
+      break;
+    case Opt_load:
+      if (!read_count(optarg, &load)) {
+        fprintf(stderr, "Bad load %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case 'h':
+      usage();
+      return 0;
+    case '?':
+      usage();
+      return 1;
+    }
+  }
+  if (optind != argc) {
+    usage();
+    return 1;
+  }
+  if (access(opts.orca_path, X_OK) != 0) {
+    fprintf(stderr, "Can't run %s. Build it with: ./tool build orca\n",
+            opts.orca_path);
+    return 1;
+  }
+
+  // The sink, on a port picked by the OS.
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof addr;
+  if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+      getsockname(sock, (struct sockaddr *)&addr, &addr_len) != 0) {
+    fprintf(stderr, "Couldn't open a UDP socket on 127.0.0.1: %s\n",
+            strerror(errno));
+    return 1;
+  }
+
+  // orca reads orca.conf from $XDG_CONFIG_HOME, which points here.
+  char tmp_dir[] = "/tmp/orca_latency_XXXXXX";
+  if (!mkdtemp(tmp_dir)) {
+    fprintf(stderr, "Couldn't make a temporary directory.\n");
+    return 1;
+  }
+  char conf_path[sizeof tmp_dir + 16], grid_path[sizeof tmp_dir + 16];
+  char conf_text[128];
+  snprintf(conf_path, sizeof conf_path, "%s/orca.conf", tmp_dir);
+  snprintf(grid_path, sizeof grid_path, "%s/latency.orca", tmp_dir);
+  snprintf(conf_text, sizeof conf_text,
+           "osc_output_address = 127.0.0.1\nosc_output_port = %u\n"
+           "osc_output_enabled = 1\n",
+           (unsigned)ntohs(addr.sin_port));
+  opts.tmp_dir = tmp_dir;
+  opts.grid_path = grid_path;
+  int exit_code = 0;
+  if (!latency_write_file(conf_path, conf_text) ||
+      !latency_write_file(grid_path, latency_grid)) {
+    fprintf(stderr, "Couldn't write to %s.\n", tmp_dir);
+    exit_code = 1;
+    goto cleanup;
+  }
+
+  printf("%zu ticks at %zu bpm (%.2f ms per tick), load of %zu busy "
+         "processes.\n\n",
+         opts.ticks, opts.bpm, 60.0 * 1000 / (double)(opts.bpm * 4), load);
+  Latency_samples samples;
+  samples.arrivals_ns = malloc(opts.ticks * sizeof(U64));
+  samples.tick_indices = malloc(opts.ticks * sizeof(Usz));
+  pid_t *load_pids = calloc(load ? load : 1, sizeof(pid_t));
+  for (int loaded = 0; loaded < 2 && exit_code == 0; ++loaded) {
+    if (loaded && load == 0)
+      break;
+    for (int strict = 0; strict < 2; ++strict) {
+      if (loaded)
+        latency_start_load(load_pids, load);
+      bool ok = latency_run(&opts, sock, strict, &samples);
+      if (loaded)
+        latency_stop_load(load_pids, load);
+      if (!ok) {
+        exit_code = 1;
+        break;
+      }
+      char title[64];
+      snprintf(title, sizeof title, "%s, %s",
+               strict ? "--strict-timing" : "default timing",
+               loaded ? "under load" : "no load");
+      latency_report(&opts, title, &samples);
+      printf("\n");
+      fflush(stdout);
+    }
+  }
+  free(load_pids);
+  free(samples.arrivals_ns);
+  free(samples.tick_indices);
+
+cleanup:
+  // orca may have saved its prefs here too, which only ever go in orca.conf.
+  unlink(conf_path);
+  unlink(grid_path);
+  rmdir(tmp_dir);
+  close(sock);
+  return exit_code;
+}
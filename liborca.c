@@ -0,0 +1,141 @@
+#include "liborca.h"
+#include "gbuffer.h"
+#include "sim.h"
+
+struct Orca_vm {
+  Field field;
+  Mbuf_reusable mbuf_r;
+  Oevent_list oevent_list;
+  Usz tick_num;
+  Usz random_seed;
+  Usz collected; // Bytes of events already handed out by collect_events
+};
+
+int orca_lib_api_version(void) { return ORCA_LIB_API_VERSION; }
+
+// Each grid cell can run at most once per step, and no operator outputs more
+// than one event when it runs, so the number of cells is an upper bound on
+// the number of events a step can produce. Reserving room for that many of
+// the largest possible event up front means orca_run() never has to grow the
+// event list.
+static void orca_vm_reserve_for_grid(Orca_vm *vm) {
+  Usz height = vm->field.height, width = vm->field.width;
+  mbuf_reusable_ensure_size(&vm->mbuf_r, height, width);
+  mbuffer_clear(vm->mbuf_r.buffer, height, width);
+  oevent_list_reserve(&vm->oevent_list, height * width * Oevent_max_size);
+  oevent_list_clear(&vm->oevent_list);
+  vm->collected = 0;
+}
+
+Orca_vm *orca_vm_create(Usz height, Usz width, Usz random_seed) {
+  if (height == 0 || width == 0 || height > ORCA_Y_MAX || width > ORCA_X_MAX)
+    return NULL;
+  Orca_vm *vm = malloc(sizeof(Orca_vm));
+  if (!vm)
+    return NULL;
+  field_init_fill(&vm->field, height, width, '.');
+  mbuf_reusable_init(&vm->mbuf_r);
+  oevent_list_init(&vm->oevent_list);
+  vm->tick_num = 0;
+  vm->random_seed = random_seed;
+  orca_vm_reserve_for_grid(vm);
+  return vm;
+}
+
+void orca_vm_destroy(Orca_vm *vm) {
+  if (!vm)
+    return;
+  field_deinit(&vm->field);
+  mbuf_reusable_deinit(&vm->mbuf_r);
+  oevent_list_deinit(&vm->oevent_list);
+  free(vm);
+}
+
+Field_load_error orca_vm_load_file(Orca_vm *vm, char const *filepath) {
+  Field loaded;
+  field_init(&loaded);
+  Field_load_error fle = field_load_file(filepath, &loaded);
+  if (fle == Field_load_error_ok &&
+      (loaded.height == 0 || loaded.width == 0))
+    fle = Field_load_error_no_rows_read;
+  if (fle != Field_load_error_ok) {
+    field_deinit(&loaded);
+    return fle;
+  }
+  field_deinit(&vm->field);
+  vm->field = loaded;
+  orca_vm_reserve_for_grid(vm);
+  return Field_load_error_ok;
+}
+
+bool orca_vm_resize(Orca_vm *vm, Usz height, Usz width) {
+  if (height == 0 || width == 0 || height > ORCA_Y_MAX || width > ORCA_X_MAX)
+    return false;
+  Glyph *buffer = malloc(height * width * sizeof(Glyph));
+  if (!buffer)
+    return false;
+  memset(buffer, '.', height * width * sizeof(Glyph));
+  gbuffer_copy_subrect(vm->field.buffer, buffer, vm->field.height,
+                       vm->field.width, vm->field.stride, height, width, width,
+                       0, 0, 0, 0, vm->field.height, vm->field.width);
+  free(vm->field.buffer);
+  vm->field.buffer = buffer;
+  vm->field.height = (U16)height;
+  vm->field.width = (U16)width;
+  vm->field.stride = (U16)width;
+  orca_vm_reserve_for_grid(vm);
+  return true;
+}
+
+Usz orca_vm_height(Orca_vm const *vm) { return vm->field.height; }
+Usz orca_vm_width(Orca_vm const *vm) { return vm->field.width; }
+Usz orca_vm_tick_number(Orca_vm const *vm) { return vm->tick_num; }
+void orca_vm_set_tick_number(Orca_vm *vm, Usz tick_number) {
+  vm->tick_num = tick_number;
+}
+
+void orca_vm_step(Orca_vm *vm) {
+  Usz height = vm->field.height, width = vm->field.width;
+  mbuffer_clear(vm->mbuf_r.buffer, height, width);
+  oevent_list_clear(&vm->oevent_list);
+  vm->collected = 0;
+#ifndef NDEBUG
+  U8 const *old_events = vm->oevent_list.buffer;
+#endif
+  orca_run(vm->field.buffer, vm->mbuf_r.buffer, height, width, vm->tick_num,
+           &vm->oevent_list, vm->random_seed);
+  assert(vm->oevent_list.buffer == old_events);
+  ++vm->tick_num;
+}
+
+Usz orca_vm_collect_events(Orca_vm *vm, Oevent *out_events, Usz max_count) {
+  Oevent_iter it;
+  oevent_iter_init_range(&it, &vm->oevent_list, vm->collected,
+                         vm->oevent_list.size);
+  Usz n = 0;
+  Oevent const *ev;
+  while (n < max_count && (ev = oevent_iter_next(&it))) {
+    memcpy(out_events + n, ev, oevent_size(ev));
+    ++n;
+  }
+  vm->collected = (Usz)(it.pos - vm->oevent_list.buffer);
+  return n;
+}
+
+Glyph orca_vm_peek(Orca_vm const *vm, Usz y, Usz x) {
+  return gbuffer_peek_relative(vm->field.buffer, vm->field.height,
+                               vm->field.width, vm->field.stride, y, x, 0,
+                               0);
+}
+
+void orca_vm_poke(Orca_vm *vm, Usz y, Usz x, Glyph glyph) {
+  if (y >= vm->field.height || x >= vm->field.width)
+    return;
+  if (!orca_is_valid_glyph(glyph))
+    glyph = '.';
+  gbuffer_poke(vm->field.buffer, vm->field.height, vm->field.width,
+               vm->field.stride, y, x, glyph);
+}
+
+Glyph const *orca_vm_glyphs(Orca_vm const *vm) { return vm->field.buffer; }
+Mark const *orca_vm_marks(Orca_vm const *vm) { return vm->mbuf_r.buffer; }
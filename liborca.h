@@ -0,0 +1,72 @@
+#pragma once
+#include "base.h"
+#include "field.h"
+#include "vmio.h"
+
+// Embeddable interface to the orca VM. This is what gets built into
+// build/liborca.a and build/liborca.so by `tool build lib`.
+//
+// An Orca_vm owns its grid, its mark buffer and its output event list. All of
+// the memory the VM could ever need for a simulation step is allocated up
+// front when the grid is created, loaded or resized. After that, the
+// functions marked "real-time safe" below don't allocate, free, lock or do any
+// I/O, so they can be called from inside of an audio callback. The other
+// functions may do any of those things, and must not be called at the same
+// time as a real-time safe function from another thread.
+//
+// Only the functions in this header are exported from the shared library.
+// Bump ORCA_LIB_API_VERSION if any of them change in an incompatible way.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ORCA_API __attribute__((visibility("default")))
+#else
+#define ORCA_API
+#endif
+
+// 2: Oevent became variable-length, with only its first oevent_size() bytes
+//    written by orca_vm_collect_events().
+enum { ORCA_LIB_API_VERSION = 2 };
+
+typedef struct Orca_vm Orca_vm;
+
+ORCA_API int orca_lib_api_version(void);
+
+// Returns NULL if out of memory or if the dimensions are zero or too large.
+// The grid starts out filled with '.'.
+ORCA_API Orca_vm *orca_vm_create(Usz height, Usz width, Usz random_seed);
+ORCA_API void orca_vm_destroy(Orca_vm *vm);
+
+// Replaces the grid with the contents of an .orca file. On error, the grid is
+// left unchanged.
+ORCA_API Field_load_error orca_vm_load_file(Orca_vm *vm, char const *filepath);
+// Resizes the grid, keeping the top-left content. New cells are filled with
+// '.'. Returns false if out of memory or if the dimensions are zero or too
+// large, in which case nothing is changed.
+ORCA_API bool orca_vm_resize(Orca_vm *vm, Usz height, Usz width);
+
+ORCA_API Usz orca_vm_height(Orca_vm const *vm);
+ORCA_API Usz orca_vm_width(Orca_vm const *vm);
+ORCA_API Usz orca_vm_tick_number(Orca_vm const *vm);
+ORCA_API void orca_vm_set_tick_number(Orca_vm *vm, Usz tick_number);
+
+// Real-time safe. Runs one simulation step and advances the tick number. Any
+// events from the previous step which weren't collected are discarded.
+ORCA_API void orca_vm_step(Orca_vm *vm);
+
+// Real-time safe. Copies up to `max_count` of the events output by the most
+// recent step into `out_events` and returns the number copied. Each call
+// continues where the previous one left off, so this can be called in a loop
+// with a small buffer until it returns 0. Only the first `oevent_size()` bytes
+// of each copied event are written.
+ORCA_API Usz orca_vm_collect_events(Orca_vm *vm, Oevent *out_events,
+                                    Usz max_count);
+
+// Real-time safe. Out-of-bounds reads return '.', and out-of-bounds writes are
+// ignored. Writing a glyph that isn't valid for orca writes '.' instead.
+ORCA_API Glyph orca_vm_peek(Orca_vm const *vm, Usz y, Usz x);
+ORCA_API void orca_vm_poke(Orca_vm *vm, Usz y, Usz x, Glyph glyph);
+
+// Real-time safe. Direct read-only access to the row-major glyph and mark
+// buffers, for drawing. The pointers are invalidated by load and resize.
+ORCA_API Glyph const *orca_vm_glyphs(Orca_vm const *vm);
+ORCA_API Mark const *orca_vm_marks(Orca_vm const *vm);
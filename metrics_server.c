@@ -0,0 +1,257 @@
+#include "metrics_server.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+struct Metrics_server {
+  pthread_t thread;
+  pthread_mutex_t lock; // Guards `snap`
+  Metrics_snapshot snap;
+  int listen_fd;
+  int wake_fds[2]; // Written to by metrics_server_stop()
+};
+
+enum { Metrics_request_max = 4096, Metrics_response_max = 8192 };
+
+static char const *const metrics_event_labels[Oevent_type_count] = {
+    [Oevent_type_midi_note] = "midi_note",
+    [Oevent_type_midi_cc] = "midi_cc",
+    [Oevent_type_midi_pb] = "midi_pb",
+    [Oevent_type_osc_ints] = "osc",
+    [Oevent_type_udp_string] = "udp",
+};
+
+// 0 if it can't be found out on this platform.
+static U64 metrics_resident_bytes(void) {
+#ifdef __linux__
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  unsigned long size, resident;
+  int n = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  if (n != 2)
+    return 0;
+  return (U64)resident * (U64)sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+static void metrics_put_summary(char *buf, Usz size, Usz *len,
+                                char const *name, char const *help,
+                                Hdr_hist const *h) {
+  double const quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  *len += (Usz)snprintf(buf + *len, size - *len,
+                        "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+  for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(quantiles) && *len < size; ++i)
+    *len += (Usz)snprintf(
+        buf + *len, size - *len, "%s{quantile=\"%g\"} %.9f\n", name,
+        quantiles[i],
+        (double)hdr_hist_percentile(h, quantiles[i] * 100.0) / 1e9);
+  if (*len < size)
+    *len += (Usz)snprintf(buf + *len, size - *len,
+                          "%s_sum %.9f\n%s_count %llu\n", name,
+                          (double)h->sum / 1e9, name,
+                          (unsigned long long)h->total_count);
+}
+
+// Returns the length of the body written to `buf`.
+static Usz metrics_format(Metrics_snapshot const *snap, char *buf, Usz size) {
+  Usz len = 0;
+#define METRIC(_name, _type, _help, _fmt, _val)                                \
+  if (len < size)                                                              \
+    len += (Usz)snprintf(buf + len, size - len,                                \
+                         "# HELP " _name " " _help "\n# TYPE " _name           \
+                         " " _type "\n" _name " " _fmt "\n",                   \
+                         _val);
+  METRIC("orca_ticks_total", "counter", "Ticks simulated.", "%llu",
+         (unsigned long long)snap->ticks)
+  METRIC("orca_late_ticks_total", "counter",
+         "Ticks that started more than 1 ms after their deadline.", "%llu",
+         (unsigned long long)snap->late_ticks)
+  METRIC("orca_dropped_events_total", "counter",
+         "Output events dropped by the event budget and rate limits.", "%llu",
+         (unsigned long long)snap->dropped_events)
+  METRIC("orca_sustained_notes", "gauge", "MIDI notes being held.", "%llu",
+         (unsigned long long)snap->sustained_notes)
+  METRIC("orca_bpm", "gauge", "Tempo in beats per minute.", "%llu",
+         (unsigned long long)snap->bpm)
+  METRIC("orca_playing", "gauge", "1 if playing, 0 if paused.", "%d",
+         snap->is_playing ? 1 : 0)
+  METRIC("process_resident_memory_bytes", "gauge", "Resident memory size.",
+         "%llu", (unsigned long long)metrics_resident_bytes())
+#undef METRIC
+  if (len < size)
+    len += (Usz)snprintf(buf + len, size - len,
+                         "# HELP orca_events_total Output events by type.\n"
+                         "# TYPE orca_events_total counter\n");
+  for (Usz i = 0; i < Oevent_type_count && len < size; ++i)
+    len += (Usz)snprintf(buf + len, size - len,
+                         "orca_events_total{type=\"%s\"} %llu\n",
+                         metrics_event_labels[i],
+                         (unsigned long long)snap->events[i]);
+  if (len < size)
+    metrics_put_summary(buf, size, &len, "orca_tick_lateness_seconds",
+                        "How long after its deadline each tick started.",
+                        &snap->tick_lateness);
+  if (len < size)
+    metrics_put_summary(buf, size, &len, "orca_vm_tick_seconds",
+                        "Time the VM took for each tick.", &snap->vm_time);
+  return len < size ? len : size - 1;
+}
+
+// A client that hangs up early shouldn't kill us with SIGPIPE.
+#ifdef MSG_NOSIGNAL
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define METRICS_SEND_FLAGS 0
+#endif
+
+static void metrics_write_all(int fd, char const *data, Usz size) {
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, METRICS_SEND_FLAGS);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    data += n;
+    size -= (Usz)n;
+  }
+}
+
+static void metrics_serve(Metrics_server *s, int fd) {
+  // A client that connects and sends nothing can't hold up the next one for
+  // long.
+  struct timeval tv = {.tv_sec = 1, .tv_usec = 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+  char req[Metrics_request_max];
+  Usz req_len = 0;
+  while (req_len < sizeof req - 1) {
+    ssize_t n = recv(fd, req + req_len, sizeof req - 1 - req_len, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    req_len += (Usz)n;
+    req[req_len] = '\0';
+    if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+      break;
+  }
+  req[req_len] = '\0';
+  char const *status = "200 OK";
+  Usz body_len = 0;
+  // Only used by the server thread.
+  static Metrics_snapshot snap;
+  static char body[Metrics_response_max];
+  if (strncmp(req, "GET ", 4) != 0) {
+    status = "405 Method Not Allowed";
+  } else {
+    // Copy it out, so that the lock isn't held while formatting.
+    pthread_mutex_lock(&s->lock);
+    snap = s->snap;
+    pthread_mutex_unlock(&s->lock);
+    body_len = metrics_format(&snap, body, sizeof body);
+  }
+  char head[256];
+  int head_len =
+      snprintf(head, sizeof head,
+               "HTTP/1.0 %s\r\n"
+               "Content-Type: text/plain; version=0.0.4\r\n"
+               "Content-Length: %zu\r\n"
+               "Connection: close\r\n\r\n",
+               status, body_len);
+  metrics_write_all(fd, head, (Usz)head_len);
+  metrics_write_all(fd, body, body_len);
+}
+
+static void *metrics_server_main(void *arg) {
+  Metrics_server *s = arg;
+  struct pollfd fds[2] = {{.fd = s->listen_fd, .events = POLLIN},
+                          {.fd = s->wake_fds[0], .events = POLLIN}};
+  for (;;) {
+    int n = poll(fds, 2, -1);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 || fds[1].revents)
+      break;
+    if (!(fds[0].revents & POLLIN))
+      continue;
+    int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0)
+      continue;
+    metrics_serve(s, fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+Metrics_server *metrics_server_start(U16 port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return NULL;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0 ||
+      listen(fd, 8) != 0) {
+    int e = errno;
+    close(fd);
+    errno = e;
+    return NULL;
+  }
+  Metrics_server *s = calloc(1, sizeof(Metrics_server));
+  s->listen_fd = fd;
+  if (pipe(s->wake_fds) != 0) {
+    int e = errno;
+    close(fd);
+    free(s);
+    errno = e;
+    return NULL;
+  }
+  pthread_mutex_init(&s->lock, NULL);
+  int err = pthread_create(&s->thread, NULL, metrics_server_main, s);
+  if (err != 0) {
+    pthread_mutex_destroy(&s->lock);
+    close(s->wake_fds[0]);
+    close(s->wake_fds[1]);
+    close(fd);
+    free(s);
+    errno = err;
+    return NULL;
+  }
+  return s;
+}
+
+void metrics_server_stop(Metrics_server *s) {
+  char c = 0;
+  while (write(s->wake_fds[1], &c, 1) < 0 && errno == EINTR) {
+  }
+  pthread_join(s->thread, NULL);
+  close(s->wake_fds[0]);
+  close(s->wake_fds[1]);
+  close(s->listen_fd);
+  pthread_mutex_destroy(&s->lock);
+  free(s);
+}
+
+bool metrics_server_publish(Metrics_server *s, Metrics_snapshot const *snap) {
+  if (pthread_mutex_trylock(&s->lock) != 0)
+    return false;
+  s->snap = *snap;
+  pthread_mutex_unlock(&s->lock);
+  return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "base.h"
+#include "hdr_hist.h"
+#include "vmio.h"
+
+// An HTTP listener on 127.0.0.1 that serves orca's counters in the
+// Prometheus text format, for scraping headless instances. It runs on a
+// thread of its own, and answers any GET with the metrics, one connection at
+// a time.
+//
+// The main loop hands it a copy of the numbers with metrics_server_publish(),
+// which only tries the lock, and skips the copy if the server is in the
+// middle of reading the last one. So the tick never waits on a scrape.
+
+typedef struct {
+  U64 ticks, late_ticks;
+  U64 events[Oevent_type_count]; // Output by the VM, by type
+  U64 dropped_events;            // By the event budget and rate limits
+  U64 sustained_notes;
+  U64 bpm;
+  bool is_playing;
+  Hdr_hist tick_lateness, vm_time; // ns
+} Metrics_snapshot;
+
+// Ticks which start more than this long after their deadline count as late.
+enum { Metrics_late_tick_ns = 1000000 };
+
+typedef struct Metrics_server Metrics_server;
+
+// Returns NULL and sets errno if the port can't be listened on.
+Metrics_server *metrics_server_start(U16 port);
+void metrics_server_stop(Metrics_server *s);
+// Doesn't block. Returns false if the snapshot was skipped.
+bool metrics_server_publish(Metrics_server *s, Metrics_snapshot const *snap);
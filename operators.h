@@ -0,0 +1,45 @@
+#pragma once
+
+// Every operator glyph, with the name of the oper_behavior_ function in
+// sim_ops.h that runs it, as X-macros. Letters are listed in uppercase, and
+// their lowercase forms run the same function, but only when banged. sim_ops.h
+// builds its dispatch switch from these, and bench generates a
+// microbenchmark for each one.
+
+#define UNIQUE_OPERATORS(_)                                                    \
+  _('!', midicc)                                                               \
+  _('#', comment)                                                              \
+  _('%', midi)                                                                 \
+  _('*', bang)                                                                 \
+  _(':', midi)                                                                 \
+  _(';', udp)                                                                  \
+  _('=', osc)                                                                  \
+  _('?', midipb)
+
+#define ALPHA_OPERATORS(_)                                                     \
+  _('A', add)                                                                  \
+  _('B', subtract)                                                             \
+  _('C', clock)                                                                \
+  _('D', delay)                                                                \
+  _('E', movement)                                                             \
+  _('F', if)                                                                   \
+  _('G', generator)                                                            \
+  _('H', halt)                                                                 \
+  _('I', increment)                                                            \
+  _('J', jump)                                                                 \
+  _('K', konkat)                                                               \
+  _('L', lesser)                                                               \
+  _('M', multiply)                                                             \
+  _('N', movement)                                                             \
+  _('O', offset)                                                               \
+  _('P', push)                                                                 \
+  _('Q', query)                                                                \
+  _('R', random)                                                               \
+  _('S', movement)                                                             \
+  _('T', track)                                                                \
+  _('U', uclid)                                                                \
+  _('V', variable)                                                             \
+  _('W', movement)                                                             \
+  _('X', teleport)                                                             \
+  _('Y', yump)                                                                 \
+  _('Z', lerp)
@@ -171,6 +171,15 @@ void susnote_list_init(Susnote_list *sl) {
   sl->buffer = NULL;
   sl->count = 0;
   sl->capacity = 0;
+  sl->heap_calls = 0;
+}
+
+void susnote_list_reserve(Susnote_list *sl, Usz capacity) {
+  if (sl->capacity >= capacity)
+    return;
+  sl->buffer = realloc(sl->buffer, capacity * sizeof(Susnote));
+  sl->capacity = capacity;
+  ++sl->heap_calls;
 }
 
 void susnote_list_deinit(Susnote_list *sl) { free(sl->buffer); }
@@ -182,14 +191,12 @@ void susnote_list_add_notes(Susnote_list *sl, Susnote const *restrict notes,
                             Usz *restrict end_removed) {
   Susnote *buffer = sl->buffer;
   Usz count = sl->count;
-  Usz cap = sl->capacity;
   Usz rem = count + added_count;
   Usz needed_cap = rem + added_count;
-  if (cap < needed_cap) {
-    cap = needed_cap < 16 ? 16 : orca_round_up_power2(needed_cap);
-    buffer = realloc(buffer, cap * sizeof(Susnote));
-    sl->capacity = cap;
-    sl->buffer = buffer;
+  if (sl->capacity < needed_cap) {
+    Usz cap = needed_cap < 16 ? 16 : orca_round_up_power2(needed_cap);
+    susnote_list_reserve(sl, cap);
+    buffer = sl->buffer;
   }
   *start_removed = rem;
   Usz i_in = 0;
@@ -271,3 +278,43 @@ double susnote_list_soonest_deadline(Susnote_list const *sl) {
   }
   return (double)soonest;
 }
+
+void oguard_init(Oguard *g) {
+  for (Usz i = 0; i < Oguard_dest_count; ++i)
+    g->buckets[i] = (Oguard_bucket){0};
+  g->vm_dropped_count = 0;
+}
+
+void oguard_set_rate(Oguard *g, Oguard_dests dest, double rate, double burst) {
+  Oguard_bucket *b = g->buckets + dest;
+  b->tokens = burst;
+  b->rate = rate;
+  b->burst = burst;
+}
+
+void oguard_advance_time(Oguard *g, double delta_time) {
+  for (Usz i = 0; i < Oguard_dest_count; ++i) {
+    Oguard_bucket *b = g->buckets + i;
+    double tokens = b->tokens + b->rate * delta_time;
+    b->tokens = tokens > b->burst ? b->burst : tokens;
+  }
+}
+
+bool oguard_admit(Oguard *g, Oguard_dests dest) {
+  Oguard_bucket *b = g->buckets + dest;
+  if (b->rate <= 0.0)
+    return true;
+  if (b->tokens < 1.0) {
+    ++b->suppressed_count;
+    return false;
+  }
+  b->tokens -= 1.0;
+  return true;
+}
+
+Usz oguard_suppressed_count(Oguard const *g) {
+  Usz total = g->vm_dropped_count;
+  for (Usz i = 0; i < Oguard_dest_count; ++i)
+    total += g->buckets[i].suppressed_count;
+  return total;
+}
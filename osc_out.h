@@ -35,9 +35,18 @@ typedef struct {
 typedef struct {
   Susnote *buffer;
   Usz count, capacity;
+  Usz heap_calls; // Number of times the buffer was grown
 } Susnote_list;
 
+// There's at most one sustained note for each channel and note number.
+enum { Susnote_max_count = 16 * 128 };
+
 void susnote_list_init(Susnote_list *sl);
+// Grows the capacity up front, so that adding notes doesn't have to. Adding
+// `count` notes needs room for the notes already in the list plus twice
+// `count`, so reserving Susnote_max_count plus twice the most notes added at
+// once means the list never grows.
+void susnote_list_reserve(Susnote_list *sl, Usz capacity);
 void susnote_list_deinit(Susnote_list *sl);
 void susnote_list_clear(Susnote_list *sl);
 void susnote_list_add_notes(Susnote_list *sl, Susnote const *restrict notes,
@@ -54,3 +63,52 @@ void susnote_list_remove_by_chan_mask(Susnote_list *sl, Usz chan_mask,
 
 // Returns 1.0 if no notes remain or none are shorter than 1.0
 double susnote_list_soonest_deadline(Susnote_list const *sl);
+
+// Oguard limits how many events are sent to each output destination, so that
+// a patch which suddenly emits a huge number of events (for example, a wall
+// of banged ':' operators) can't flood the receivers or make us miss the
+// timing of the next tick.
+//
+// Each destination has its own token bucket: it refills at the destination's
+// `rate` in events per second, up to `burst` events, and each event sent takes
+// one token. Events that arrive when a destination's bucket is empty are
+// suppressed and counted. MIDI note-offs are never passed through the guard,
+// so a note that was started always gets stopped.
+typedef enum {
+  Oguard_dest_midi = 0,
+  Oguard_dest_osc,
+  Oguard_dest_udp,
+} Oguard_dests;
+
+enum { Oguard_dest_count = 3 };
+
+// orca's defaults for --event-budget, the --*-rate options and --event-burst,
+// which `cli --estimate` also checks against. There's no limit on the events
+// per tick or per second unless one is asked for.
+enum {
+  Oguard_default_tick_budget = 0,
+  Oguard_default_rate = 0,
+  Oguard_default_burst = 256,
+};
+
+typedef struct {
+  double tokens;
+  double rate, burst; // Rate of 0 means no limit
+  Usz suppressed_count;
+} Oguard_bucket;
+
+typedef struct {
+  Oguard_bucket buckets[Oguard_dest_count];
+  Usz vm_dropped_count; // Events the VM dropped from its per-tick budget
+} Oguard;
+
+// Starts out with no limits.
+void oguard_init(Oguard *g);
+void oguard_set_rate(Oguard *g, Oguard_dests dest, double rate, double burst);
+// Refills the buckets. Call once per tick, before admitting its events.
+void oguard_advance_time(Oguard *g, double delta_time);
+// Returns true if an event may be sent to `dest`, using up one token.
+// Otherwise, counts the event as suppressed and returns false.
+bool oguard_admit(Oguard *g, Oguard_dests dest);
+// Total number of events suppressed or dropped since init.
+Usz oguard_suppressed_count(Oguard const *g);
@@ -5,3 +5,114 @@
 void orca_run(Glyph *restrict gbuffer, Mark *restrict mbuffer, Usz height,
               Usz width, Usz tick_number, Oevent_list *oevent_list,
               Usz random_seed);
+
+// Same as orca_run(), but rows of the glyph and mark buffers start `stride`
+// cells apart instead of `width`. The cells past `width` in each row are never
+// read or written. This lets the VM run directly on a grid that still has its
+// line endings in it, like a memory-mapped .orca file.
+void orca_run_strided(Glyph *restrict gbuffer, Mark *restrict mbuffer,
+                      Usz height, Usz width, Usz stride, Usz tick_number,
+                      Oevent_list *oevent_list, Usz random_seed);
+
+// Same as orca_run(), but the glyph and mark buffers are in the tiled layout
+// described in gbuffer.h, and must each be gbuffer_tiled_cells(height, width)
+// long. Clearing the marks first is up to the caller, same as orca_run().
+void orca_run_tiled(Glyph *restrict gbuffer, Mark *restrict mbuffer,
+                    Usz height, Usz width, Usz tick_number,
+                    Oevent_list *oevent_list, Usz random_seed);
+
+// Same as orca_run(), but on an interleaved buffer of `height * width` cells,
+// described in gbuffer.h. Clear the marks first with cbuffer_clear_marks().
+void orca_run_interleaved(Cell *restrict cbuffer, Usz height, Usz width,
+                          Usz tick_number, Oevent_list *oevent_list,
+                          Usz random_seed);
+
+// Same as mbuffer_clear() followed by orca_run(), but for a grid stored in
+// tiles by sparse.h. Only the stored tiles are visited, in the same order
+// orca_run() visits cells, so the results are the same as for a dense grid
+// with the same contents. Tiles which ended up all '.' in the previous tick
+// are dropped first.
+struct Sparse_field;
+void orca_run_sparse(struct Sparse_field *sfield, Usz tick_number,
+                     Oevent_list *oevent_list, Usz random_seed);
+
+// Runs only the cells at the indices `y * width + x` listed in `cells`, in
+// that order, the same way orca_run() would when it got to each of them.
+// Cells that are '.', locked or sleeping are skipped. This is for timing
+// operators without the walk over the rest of the grid, as bench --operators
+// does. Nothing else on the grid runs, so the results are only the same as
+// orca_run()'s if `cells` lists every operator in reading order.
+void orca_run_cells(Glyph *restrict gbuffer, Mark *restrict mbuffer,
+                    Usz height, Usz width, Usz const *cells, Usz cell_count,
+                    Usz tick_number, Oevent_list *oevent_list,
+                    Usz random_seed);
+
+// Invocation counts and times collected by orca_run_profiled(), by operator
+// glyph and by the type of event emitted. They add up over every tick that
+// the profile is passed to, until the caller zeroes it. Times are in
+// `orca_profile_unit`: CPU cycles where the timestamp counter can be read
+// directly, otherwise nanoseconds. Reading the counter adds its own small
+// cost to every operator.
+typedef struct {
+  U64 ticks;
+  U64 tick_time; // The whole tick, including the walk over the empty cells
+  U64 oper_count[128], oper_time[128]; // Indexed by glyph
+  U64 event_count[Oevent_type_count];
+  // Time of the operator invocations that emitted events of each type.
+  U64 event_time[Oevent_type_count];
+} Oprofile;
+
+extern char const orca_profile_unit[];
+
+// One line of a profile report. Counts and times are averaged per tick, and
+// `share` is the percentage of the whole tick's time.
+typedef struct {
+  U8 key; // The operator's glyph, or the Oevent_types of an event row
+  double count, time, share;
+  double time_per_call;
+} Oprofile_row;
+
+// The numbers in an Oprofile, worked out for showing. Operators that ran are
+// sorted by the most time first, and event types that were emitted are in
+// the order of Oevent_types.
+typedef struct {
+  U64 ticks;
+  double tick_time;  // Per tick
+  double oper_share; // Percentage of the ticks' time spent in operators
+  Oprofile_row opers[128], events[Oevent_type_count];
+  Usz oper_count, event_count;
+} Oprofile_summary;
+
+void oprofile_summarize(Oprofile const *prof, Oprofile_summary *out);
+
+// Same as orca_run_strided(), but also adds the tick to `profile`. Slower,
+// so it's only for when someone is looking at the numbers. If `cell_time` is
+// not NULL, each operator's time is also added to it at `y * stride + x`.
+void orca_run_profiled(Glyph *restrict gbuffer, Mark *restrict mbuffer,
+                       Usz height, Usz width, Usz stride, Usz tick_number,
+                       Oevent_list *oevent_list, Usz random_seed,
+                       Oprofile *profile, U32 *cell_time);
+
+// Called after each tick of orca_run_ticks(). `tick_number` is the tick that
+// was just simulated. The grid may be inspected, but not resized.
+typedef void Orca_tick_callback(void *user, Usz tick_number,
+                                Glyph const *gbuffer, Mark const *mbuffer,
+                                Usz height, Usz width);
+
+// Simulates `tick_count` ticks in a row, starting at `tick_number`. This is
+// the same as calling `mbuffer_clear()` and `orca_run()` once per tick, except
+// that the events from every tick are appended to `oevent_list` without
+// clearing it in between. If `tick_event_ends` is not NULL, it must have room
+// for `tick_count` items, and `tick_event_ends[i]` will be set to the byte
+// size of `oevent_list` after the i-th tick. So the events output by tick
+// `tick_number + i` are the ones between the byte offsets
+// `tick_event_ends[i - 1]` (or the starting size, for i = 0) and
+// `tick_event_ends[i]`, which can be walked with `oevent_iter_init_range()`.
+//
+// Use `oevent_list_reserve()` beforehand if the list shouldn't be grown in
+// the middle of the run. `callback` may be NULL.
+void orca_run_ticks(Glyph *restrict gbuffer, Mark *restrict mbuffer,
+                    Usz height, Usz width, Usz tick_number, Usz tick_count,
+                    Oevent_list *oevent_list, Usz *tick_event_ends,
+                    Usz random_seed, Orca_tick_callback *callback,
+                    void *callback_user);
@@ -0,0 +1,14 @@
+#pragma once
+#include "base.h"
+#include "gbuffer.h"
+#include "vmio.h"
+
+// A frozen copy of orca_run(), as it was before the VM was split up to run on
+// more than one grid layout. It's kept as plain, unoptimized code, and is only
+// built into the fuzz target, which checks every other way of running the VM
+// against it. Don't change it to make it faster, or to match a change in
+// sim.c. If an operator's behavior is meant to change, change it here too, in
+// a commit of its own.
+void orca_run_reference(Glyph *restrict gbuffer, Mark *restrict mbuffer,
+                        Usz height, Usz width, Usz tick_number,
+                        Oevent_list *oevent_list, Usz random_seed);
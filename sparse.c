@@ -0,0 +1,246 @@
+#include "sparse.h"
+
+void sparse_field_init(Sparse_field *sf) { *sf = (Sparse_field){0}; }
+
+static Usz sparse_field_tile_rows(Usz height) {
+  return (height + Sparse_tile_size - 1) >> Sparse_tile_shift;
+}
+
+static void sparse_field_free_tiles(Sparse_field *sf) {
+  Usz tile_rows = sparse_field_tile_rows(sf->height);
+  for (Usz i = 0; i < tile_rows; ++i) {
+    Sparse_tile_row *row = sf->rows + i;
+    for (Usz j = 0; j < row->count; ++j)
+      free(row->tiles[j]);
+    free(row->tiles);
+  }
+  free(sf->rows);
+  free(sf->table);
+  sf->rows = NULL;
+  sf->table = NULL;
+  sf->table_mask = 0;
+  sf->tile_count = 0;
+}
+
+bool sparse_field_reset(Sparse_field *sf, Usz height, Usz width) {
+  if (height > Sparse_field_max_size || width > Sparse_field_max_size)
+    return false;
+  sparse_field_free_tiles(sf);
+  sf->height = height;
+  sf->width = width;
+  sf->rows = calloc(sparse_field_tile_rows(height), sizeof(Sparse_tile_row));
+  return true;
+}
+
+void sparse_field_deinit(Sparse_field *sf) { sparse_field_free_tiles(sf); }
+
+static void sparse_field_table_insert(Sparse_tile **table, Usz mask,
+                                      Sparse_tile *t) {
+  Usz i = sparse_field_hash(t->ty, t->tx) & mask;
+  while (table[i])
+    i = (i + 1) & mask;
+  table[i] = t;
+}
+
+// Keeps the table at most half full.
+static void sparse_field_table_grow(Sparse_field *sf) {
+  Usz capacity = sf->table ? sf->table_mask + 1 : 0;
+  if ((sf->tile_count + 1) * 2 <= capacity)
+    return;
+  Usz new_capacity = capacity ? capacity * 2 : 64;
+  Sparse_tile **table = calloc(new_capacity, sizeof(Sparse_tile *));
+  for (Usz i = 0; i < capacity; ++i) {
+    if (sf->table[i])
+      sparse_field_table_insert(table, new_capacity - 1, sf->table[i]);
+  }
+  free(sf->table);
+  sf->table = table;
+  sf->table_mask = new_capacity - 1;
+}
+
+// Backward shift deletion, so that lookups never need tombstones.
+static void sparse_field_table_remove(Sparse_field *sf, Sparse_tile *t) {
+  Usz mask = sf->table_mask;
+  Usz i = sparse_field_hash(t->ty, t->tx) & mask;
+  while (sf->table[i] != t)
+    i = (i + 1) & mask;
+  Usz j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    Sparse_tile *u = sf->table[j];
+    if (!u)
+      break;
+    Usz home = sparse_field_hash(u->ty, u->tx) & mask;
+    // Move u into the hole at i if its home slot isn't cyclically in (i, j].
+    if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+      sf->table[i] = u;
+      i = j;
+    }
+  }
+  sf->table[i] = NULL;
+}
+
+Sparse_tile *sparse_field_add_tile(Sparse_field *sf, Usz ty, Usz tx) {
+  assert(!sparse_field_find_tile(sf, ty, tx));
+  assert(ty < sparse_field_tile_rows(sf->height));
+  Sparse_tile *t = malloc(sizeof(Sparse_tile));
+  t->ty = (U32)ty;
+  t->tx = (U32)tx;
+  t->live = 0;
+  memset(t->glyphs, '.', sizeof t->glyphs);
+  memset(t->marks, 0, sizeof t->marks);
+  sparse_field_table_grow(sf);
+  sparse_field_table_insert(sf->table, sf->table_mask, t);
+  ++sf->tile_count;
+  // Tiles are usually added on the right end, so search from there.
+  Sparse_tile_row *row = sf->rows + ty;
+  if (row->count == row->capacity) {
+    row->capacity = row->capacity ? row->capacity * 2 : 4;
+    row->tiles = realloc(row->tiles, row->capacity * sizeof(Sparse_tile *));
+  }
+  Usz i = row->count;
+  while (i > 0 && row->tiles[i - 1]->tx > tx) {
+    row->tiles[i] = row->tiles[i - 1];
+    --i;
+  }
+  row->tiles[i] = t;
+  ++row->count;
+  return t;
+}
+
+void sparse_field_clear_marks(Sparse_field *sf) {
+  Usz tile_rows = sparse_field_tile_rows(sf->height);
+  for (Usz ty = 0; ty < tile_rows; ++ty) {
+    Sparse_tile_row *row = sf->rows + ty;
+    Usz kept = 0;
+    for (Usz i = 0; i < row->count; ++i) {
+      Sparse_tile *t = row->tiles[i];
+      if (t->live == 0) {
+        sparse_field_table_remove(sf, t);
+        --sf->tile_count;
+        free(t);
+        continue;
+      }
+      memset(t->marks, 0, sizeof t->marks);
+      row->tiles[kept++] = t;
+    }
+    row->count = kept;
+  }
+}
+
+static inline bool sparse_char_is_glyph(char c) {
+  return (U8)((U8)c - (U8)'!') <= (U8)('~' - '!') && c != '.';
+}
+
+// Stores the tiles for one row of text. Anything that isn't a valid glyph is
+// treated as '.', same as field_load_file().
+static void sparse_field_load_row(Sparse_field *sf, Usz y, char const *line,
+                                  Usz len) {
+  Usz ty = y >> Sparse_tile_shift;
+  for (Usz x0 = 0; x0 < len; x0 += Sparse_tile_size) {
+    Usz n = len - x0 < Sparse_tile_size ? len - x0 : Sparse_tile_size;
+    Sparse_tile *t = NULL;
+    for (Usz i = 0; i < n; ++i) {
+      char c = line[x0 + i];
+      if (!sparse_char_is_glyph(c))
+        continue;
+      if (!t) {
+        Usz tx = x0 >> Sparse_tile_shift;
+        t = sparse_field_find_tile(sf, ty, tx);
+        if (!t)
+          t = sparse_field_add_tile(sf, ty, tx);
+      }
+      t->glyphs[sparse_tile_index(y, x0 + i)] = (Glyph)c;
+      ++t->live;
+    }
+  }
+}
+
+Field_load_error sparse_field_load_file(char const *filepath,
+                                        Sparse_field *sf) {
+  Field_text ft;
+  if (!field_text_open(filepath, &ft))
+    return Field_load_error_cant_open_file;
+  char const *end = ft.text + ft.size;
+  char const *pos = ft.text, *line;
+  Usz rows = 0, columns = 0;
+  Field_load_error err = Field_load_error_ok;
+  while (pos < end) {
+    Usz len = field_text_next_line(&pos, end, &line);
+    if (len == 0)
+      continue;
+    if (len > Sparse_field_max_size) {
+      err = Field_load_error_too_many_columns;
+      break;
+    }
+    if (rows == 0) {
+      columns = len;
+    } else if (len != columns) {
+      err = Field_load_error_not_a_rectangle;
+      break;
+    }
+    if (rows == Sparse_field_max_size) {
+      err = Field_load_error_too_many_rows;
+      break;
+    }
+    ++rows;
+  }
+  if (err == Field_load_error_ok) {
+    sparse_field_reset(sf, rows, columns);
+    pos = ft.text;
+    Usz y = 0;
+    while (pos < end) {
+      Usz len = field_text_next_line(&pos, end, &line);
+      if (len == 0)
+        continue;
+      sparse_field_load_row(sf, y++, line, len);
+    }
+  }
+  field_text_close(&ft);
+  return err;
+}
+
+void sparse_field_fput(Sparse_field const *sf, FILE *stream) {
+  enum { Column_buffer_count = 4096 };
+  char out_buffer[Column_buffer_count];
+  Usz height = sf->height, width = sf->width;
+  for (Usz y = 0; y < height; ++y) {
+    Sparse_tile_row const *row = sf->rows + (y >> Sparse_tile_shift);
+    Usz next_tile = 0;
+    Usz x = 0, n = 0;
+    while (x < width) {
+      // Each pass adds the rest of a tile's row, or '.' for a missing tile.
+      Usz tile_end = (x | Sparse_tile_mask) + 1;
+      if (tile_end > width)
+        tile_end = width;
+      Usz count = tile_end - x;
+      if (count > Column_buffer_count - n)
+        count = Column_buffer_count - n;
+      while (next_tile < row->count &&
+             row->tiles[next_tile]->tx < x >> Sparse_tile_shift)
+        ++next_tile;
+      Sparse_tile const *t = NULL;
+      if (next_tile < row->count &&
+          row->tiles[next_tile]->tx == x >> Sparse_tile_shift)
+        t = row->tiles[next_tile];
+      if (t) {
+        Glyph const *src = t->glyphs + sparse_tile_index(y, x);
+        for (Usz i = 0; i < count; ++i) {
+          char c = (char)src[i];
+          out_buffer[n + i] = (U8)((U8)c - (U8)'!') <= (U8)('~' - '!') ? c
+                                                                       : '?';
+        }
+      } else {
+        memset(out_buffer + n, '.', count);
+      }
+      n += count;
+      x += count;
+      if (n == Column_buffer_count) {
+        fwrite(out_buffer, 1, n, stream);
+        n = 0;
+      }
+    }
+    out_buffer[n++] = '\n';
+    fwrite(out_buffer, 1, n, stream);
+  }
+}
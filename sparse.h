@@ -0,0 +1,117 @@
+#pragma once
+#include "base.h"
+#include "field.h"
+
+// Storage for very large grids which are mostly empty, like a 60000x60000
+// canvas with a few patches scattered around it. The grid is split into
+// 64x64 tiles, and only the tiles that have something other than '.' in them
+// are stored, in a hash table keyed by tile position. Every other tile is
+// implicitly all '.'. Each tile holds its own marks, next to its glyphs.
+//
+// orca_run_sparse() in sim.h runs the VM on a Sparse_field, visiting only the
+// stored tiles, so memory use and the time a tick takes depend on how much is
+// in the grid instead of its area. The size isn't limited to 16 bits like
+// Field's.
+//
+// Writing a glyph (or a mark, which the VM does for operator ports) into an
+// implicit tile stores the tile. Tiles which are all '.' again are dropped the
+// next time the marks are cleared.
+
+enum {
+  Sparse_tile_shift = 6,
+  Sparse_tile_size = 1 << Sparse_tile_shift,
+  Sparse_tile_mask = Sparse_tile_size - 1,
+  Sparse_tile_cells = Sparse_tile_size * Sparse_tile_size,
+  Sparse_field_max_size = 1 << 24,
+};
+
+typedef struct {
+  U32 ty, tx;
+  Usz live; // Number of glyphs in the tile which aren't '.'
+  Glyph glyphs[Sparse_tile_cells];
+  Mark marks[Sparse_tile_cells];
+} Sparse_tile;
+
+// The stored tiles in one row of tiles, sorted from left to right.
+typedef struct {
+  Sparse_tile **tiles;
+  Usz count, capacity;
+} Sparse_tile_row;
+
+typedef struct Sparse_field {
+  Usz height, width;
+  Sparse_tile **table; // Open addressing with linear probing, NULL if empty
+  Usz table_mask, tile_count;
+  Sparse_tile_row *rows; // One for each row of tiles
+} Sparse_field;
+
+void sparse_field_init(Sparse_field *sf);
+// Resizes to `height` by `width`, all '.'. Returns false if the size is
+// larger than Sparse_field_max_size in either direction.
+bool sparse_field_reset(Sparse_field *sf, Usz height, Usz width);
+void sparse_field_deinit(Sparse_field *sf);
+
+Sparse_tile *sparse_field_add_tile(Sparse_field *sf, Usz ty, Usz tx);
+
+static inline Usz sparse_field_hash(Usz ty, Usz tx) {
+  U64 key = (U64)ty << 32 | (U64)tx;
+  key *= UINT64_C(0x9E3779B97F4A7C15);
+  return (Usz)(key >> 32 ^ key);
+}
+
+static inline Sparse_tile *sparse_field_find_tile(Sparse_field const *sf,
+                                                  Usz ty, Usz tx) {
+  if (!sf->table)
+    return NULL;
+  Usz i = sparse_field_hash(ty, tx) & sf->table_mask;
+  for (;;) {
+    Sparse_tile *t = sf->table[i];
+    if (!t || (t->ty == ty && t->tx == tx))
+      return t;
+    i = (i + 1) & sf->table_mask;
+  }
+}
+
+static inline Usz sparse_tile_index(Usz y, Usz x) {
+  return (y & Sparse_tile_mask) << Sparse_tile_shift | (x & Sparse_tile_mask);
+}
+
+// The coordinates must be inside of the grid.
+static inline Glyph sparse_field_peek(Sparse_field const *sf, Usz y, Usz x) {
+  Sparse_tile const *t = sparse_field_find_tile(sf, y >> Sparse_tile_shift,
+                                                x >> Sparse_tile_shift);
+  return t ? t->glyphs[sparse_tile_index(y, x)] : '.';
+}
+
+static inline void sparse_field_poke(Sparse_field *sf, Usz y, Usz x, Glyph g) {
+  Usz ty = y >> Sparse_tile_shift, tx = x >> Sparse_tile_shift;
+  Sparse_tile *t = sparse_field_find_tile(sf, ty, tx);
+  if (!t) {
+    if (g == '.')
+      return;
+    t = sparse_field_add_tile(sf, ty, tx);
+  }
+  Glyph *cell = t->glyphs + sparse_tile_index(y, x);
+  t->live = t->live + (Usz)(g != '.') - (Usz)(*cell != '.');
+  *cell = g;
+}
+
+static inline void sparse_field_mark_or(Sparse_field *sf, Usz y, Usz x,
+                                        Mark flags) {
+  Usz ty = y >> Sparse_tile_shift, tx = x >> Sparse_tile_shift;
+  Sparse_tile *t = sparse_field_find_tile(sf, ty, tx);
+  if (!t)
+    t = sparse_field_add_tile(sf, ty, tx);
+  t->marks[sparse_tile_index(y, x)] |= flags;
+}
+
+// Clears the marks in every stored tile, and drops the tiles which are all
+// '.'. orca_run_sparse() does this before each tick.
+void sparse_field_clear_marks(Sparse_field *sf);
+
+// Same file format as field_load_file() and field_fput(). Only tiles with
+// something in them are stored while loading. On error, the field is left
+// unchanged.
+Field_load_error sparse_field_load_file(char const *filepath,
+                                        Sparse_field *sf);
+void sparse_field_fput(Sparse_field const *sf, FILE *stream);
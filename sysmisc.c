@@ -53,8 +53,8 @@ Cboard_error cboard_copy(Glyph const *gbuffer, Usz field_height,
 }
 
 ORCA_NOINLINE
-Cboard_error cboard_paste(Glyph *gbuffer, Usz height, Usz width, Usz y, Usz x,
-                          Usz *out_h, Usz *out_w) {
+Cboard_error cboard_paste(Glyph *gbuffer, Usz height, Usz width, Usz stride,
+                          Usz y, Usz x, Usz *out_h, Usz *out_w) {
   FILE *fp =
 #ifdef ORCA_OS_MAC
       popen("pbpaste -pboard general -Prefer txt 2>/dev/null", "r");
@@ -76,7 +76,7 @@ Cboard_error cboard_paste(Glyph *gbuffer, Usz height, Usz width, Usz y, Usz x,
       }
       if (c != ' ' && y < height && x < width) {
         Glyph g = orca_is_valid_glyph(c) ? (Glyph)c : '.';
-        gbuffer_poke(gbuffer, height, width, y, x, g);
+        gbuffer_poke(gbuffer, height, width, stride, y, x, g);
         if (x > max_x)
           max_x = x;
         if (y > max_y)
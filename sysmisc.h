@@ -16,8 +16,8 @@ Cboard_error cboard_copy(Glyph const *gbuffer, Usz field_height,
                          Usz field_width, Usz rect_y, Usz rect_x, Usz rect_h,
                          Usz rect_w);
 
-Cboard_error cboard_paste(Glyph *gbuffer, Usz height, Usz width, Usz y, Usz x,
-                          Usz *out_h, Usz *out_w);
+Cboard_error cboard_paste(Glyph *gbuffer, Usz height, Usz width, Usz stride,
+                          Usz y, Usz x, Usz *out_h, Usz *out_w);
 
 typedef enum {
   Conf_read_left_and_right = 0, // left and right will be set
@@ -0,0 +1,217 @@
+#include "base.h"
+#include "field.h"
+#include "undo.h"
+#include <stdio.h>
+#include <unistd.h>
+
+// Checks for the parts of orca that can be run without a terminal. Run by
+// `tool check`. Prints each check that fails and exits with 1 if any did.
+
+static int tests_failed;
+
+#define CHECK(_cond)                                                           \
+  do {                                                                         \
+    if (!(_cond)) {                                                            \
+      fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__,     \
+              __func__, #_cond);                                               \
+      ++tests_failed;                                                          \
+    }                                                                          \
+  } while (0)
+
+// splitmix64, same as gen.
+static U64 tests_rand(U64 *state) {
+  U64 z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Fills the rectangle with glyphs that don't run-length encode well.
+static void tests_scribble(Field *f, Usz y, Usz x, Usz h, Usz w, U64 *rng) {
+  static char const glyphs[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+  for (Usz iy = y; iy < y + h; ++iy)
+    for (Usz ix = x; ix < x + w; ++ix)
+      f->buffer[iy * f->stride + ix] =
+          glyphs[tests_rand(rng) % (sizeof glyphs - 1)];
+}
+
+static bool tests_fields_equal(Field const *a, Field const *b) {
+  if (a->height != b->height || a->width != b->width)
+    return false;
+  for (Usz iy = 0; iy < a->height; ++iy)
+    if (memcmp(a->buffer + iy * a->stride, b->buffer + iy * b->stride,
+               a->width) != 0)
+      return false;
+  return true;
+}
+
+enum { Tests_rects = 8, Tests_rect_size = 16 };
+
+// Makes Tests_rects edits, each scribbling over an empty rectangle, saving
+// the grid after each one into `states`.
+static void tests_make_edits(Undo_history *hist, Field *field,
+                             Field states[Tests_rects + 1]) {
+  U64 rng = 1;
+  field_init_fill(field, Tests_rect_size * 2, Tests_rect_size * Tests_rects,
+                  '.');
+  field_init(&states[0]);
+  field_copy(field, &states[0]);
+  for (Usz i = 0; i < Tests_rects; ++i) {
+    Usz x = i * Tests_rect_size;
+    undo_history_push_rect(hist, field, i, 0, x, Tests_rect_size,
+                           Tests_rect_size);
+    tests_scribble(field, 0, x, Tests_rect_size, Tests_rect_size, &rng);
+    field_init(&states[i + 1]);
+    field_copy(field, &states[i + 1]);
+  }
+}
+
+static void tests_free_states(Field states[Tests_rects + 1]) {
+  for (Usz i = 0; i < Tests_rects + 1; ++i)
+    field_deinit(&states[i]);
+}
+
+// With room for everything, undoing and redoing all of the edits goes
+// through each of the states in order.
+static void test_undo_redo_round_trip(void) {
+  Undo_history hist;
+  undo_history_init(&hist, (Usz)1 << 20);
+  Field field, states[Tests_rects + 1];
+  tests_make_edits(&hist, &field, states);
+  CHECK(undo_history_count(&hist) == Tests_rects);
+  Usz tick = 0;
+  for (Usz i = Tests_rects; i-- > 0;) {
+    undo_history_undo(&hist, &field, &tick);
+    CHECK(tests_fields_equal(&field, &states[i]));
+    CHECK(tick == i);
+  }
+  CHECK(undo_history_count(&hist) == 0);
+  for (Usz i = 1; i <= Tests_rects; ++i) {
+    CHECK(undo_history_can_redo(&hist));
+    undo_history_redo(&hist, &field, &tick);
+    CHECK(tests_fields_equal(&field, &states[i]));
+  }
+  CHECK(!undo_history_can_redo(&hist));
+  undo_history_deinit(&hist);
+  field_deinit(&field);
+  tests_free_states(states);
+}
+
+// Undoing an edit of an empty rectangle saves the scribbled glyphs for redo,
+// which take up much more room than the dots did. The redo entries have to
+// count against the limit too.
+static void test_undo_redo_stays_under_limit(void) {
+  // Room for all of the small undo entries, but only about 3 of the large
+  // redo ones.
+  Usz limit = 1024;
+  Undo_history hist;
+  undo_history_init(&hist, limit);
+  Field field, states[Tests_rects + 1];
+  tests_make_edits(&hist, &field, states);
+  CHECK(undo_history_count(&hist) == Tests_rects);
+  CHECK(hist.bytes <= limit);
+  Usz tick = 0;
+  Usz undone = 0;
+  for (; undo_history_count(&hist) > 0; ++undone) {
+    undo_history_undo(&hist, &field, &tick);
+    CHECK(hist.bytes <= limit);
+    CHECK(hist.redo_bytes <= hist.bytes);
+    CHECK(tests_fields_equal(&field, &states[Tests_rects - undone - 1]));
+  }
+  CHECK(undone >= 1);
+  // Redo what's left of the redo stack. Each redo should land on the next
+  // state, even though the furthest redo entries were dropped.
+  Usz state = Tests_rects - undone;
+  Usz redone = 0;
+  while (undo_history_can_redo(&hist)) {
+    undo_history_redo(&hist, &field, &tick);
+    ++redone;
+    CHECK(hist.bytes <= limit);
+    CHECK(tests_fields_equal(&field, &states[state + redone]));
+  }
+  CHECK(redone >= 1);
+  CHECK(redone < Tests_rects);
+  // A new edit clears the redo stack.
+  undo_history_undo(&hist, &field, &tick);
+  CHECK(undo_history_can_redo(&hist));
+  undo_history_push(&hist, &field, tick);
+  CHECK(!undo_history_can_redo(&hist));
+  CHECK(hist.redo_bytes == 0);
+  CHECK(hist.bytes <= limit);
+  undo_history_deinit(&hist);
+  field_deinit(&field);
+  tests_free_states(states);
+}
+
+// Writes the field to a new temporary file and maps it. Returns false if
+// either failed.
+static bool tests_save_and_map(Field *field, char *path, Field *out_mapped,
+                               Field_mapping *out_mapping) {
+  int fd = mkstemp(path);
+  if (fd == -1)
+    return false;
+  FILE *f = fdopen(fd, "w");
+  if (!f) {
+    close(fd);
+    return false;
+  }
+  field_fput(field, f);
+  if (fclose(f) != 0)
+    return false;
+  return field_map_file(path, out_mapped, out_mapping) == Field_load_error_ok;
+}
+
+// Resizing the grid and then saving it to a file which is mapped for editing,
+// as orca does after a Save As, leaves an entry for the old size in the
+// history. The mapped grid can't be resized, so it has to be unmapped before
+// undoing, the way ged_unmap_field() does.
+static void test_undo_resize_after_mapping(void) {
+  Undo_history hist;
+  undo_history_init(&hist, (Usz)1 << 20);
+  Field field, before, resized;
+  U64 rng = 1;
+  field_init_fill(&field, 8, 8, '.');
+  tests_scribble(&field, 2, 2, 4, 4, &rng);
+  field_init(&before);
+  field_copy(&field, &before);
+  undo_history_push(&hist, &field, 0);
+  field_resize_raw(&field, 12, 20);
+  memset(field.buffer, '.', (Usz)field.height * field.width);
+  tests_scribble(&field, 8, 10, 4, 10, &rng);
+  field_init(&resized);
+  field_copy(&field, &resized);
+  char path[] = "/tmp/orca_tests_XXXXXX";
+  Field mapped;
+  Field_mapping fm;
+  bool is_mapped = tests_save_and_map(&field, path, &mapped, &fm);
+  CHECK(is_mapped);
+  if (is_mapped) {
+    CHECK(undo_history_undo_resizes(&hist, &mapped));
+    CHECK(!undo_history_redo_resizes(&hist, &mapped));
+    field_copy(&mapped, &field);
+    field_unmap(&fm, &mapped);
+    Usz tick = 0;
+    undo_history_undo(&hist, &field, &tick);
+    CHECK(tests_fields_equal(&field, &before));
+    CHECK(undo_history_redo_resizes(&hist, &field));
+    undo_history_redo(&hist, &field, &tick);
+    CHECK(tests_fields_equal(&field, &resized));
+  }
+  unlink(path);
+  undo_history_deinit(&hist);
+  field_deinit(&field);
+  field_deinit(&before);
+  field_deinit(&resized);
+}
+
+int main(void) {
+  test_undo_redo_round_trip();
+  test_undo_redo_stays_under_limit();
+  test_undo_resize_after_mapping();
+  if (tests_failed) {
+    fprintf(stderr, "%d checks failed.\n", tests_failed);
+    return 1;
+  }
+  fprintf(stderr, "All checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,174 @@
+#include "trace.h"
+#include <stdio.h>
+#include <time.h>
+
+typedef enum {
+  Trace_event_span,
+  Trace_event_counter,
+} Trace_event_kind;
+
+typedef struct {
+  char const *name, *arg_name; // arg_name is NULL if there's no arg
+  U64 start, duration;         // ns
+  I64 arg;
+  U8 kind;
+} Trace_event;
+
+typedef struct Trace_buffer Trace_buffer;
+struct Trace_buffer {
+  Trace_buffer *next;
+  char const *thread_name;
+  Usz thread_id;
+  U64 count; // Every event recorded. The ring holds the last ones.
+  Trace_event events[Trace_buffer_events];
+};
+
+bool trace_is_on;
+static FILE *trace_file;
+static U64 trace_epoch;
+// The buffers of every thread that has recorded. Threads push theirs on with
+// a compare-and-swap, so they never wait on each other.
+static Trace_buffer *trace_buffers;
+static Usz trace_thread_count;
+static __thread Trace_buffer *trace_thread_buffer;
+static __thread char const *trace_thread_name;
+
+U64 trace_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (U64)ts.tv_sec * 1000000000u + (U64)ts.tv_nsec;
+}
+
+// Allocates the calling thread's buffer and adds it to the list. The pages
+// are touched here, so the first spans a thread records aren't slowed down by
+// page faults. Returns NULL if there isn't enough memory, and the thread's
+// events are then left out.
+static Trace_buffer *trace_add_thread_buffer(void) {
+  Trace_buffer *b = malloc(sizeof(Trace_buffer));
+  if (!b)
+    return NULL;
+  memset(b, 0, sizeof(Trace_buffer));
+  b->thread_name = trace_thread_name;
+  b->thread_id = __atomic_add_fetch(&trace_thread_count, 1, __ATOMIC_RELAXED);
+  b->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&trace_buffers, &b->next, b, true,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+  }
+  trace_thread_buffer = b;
+  return b;
+}
+
+bool trace_open(char const *path) {
+  trace_file = fopen(path, "w");
+  if (!trace_file)
+    return false;
+  if (!trace_add_thread_buffer()) {
+    fclose(trace_file);
+    trace_file = NULL;
+    return false;
+  }
+  trace_epoch = trace_now();
+  trace_is_on = true;
+  return true;
+}
+
+void trace_name_thread(char const *name) {
+  trace_thread_name = name;
+  if (trace_thread_buffer)
+    trace_thread_buffer->thread_name = name;
+  else if (trace_is_on)
+    trace_add_thread_buffer();
+}
+
+// Threads that never called trace_name_thread() get their buffer here, the
+// first time they record something.
+static Trace_event *trace_push(void) {
+  Trace_buffer *b = trace_thread_buffer;
+  if (ORCA_UNLIKELY(b == NULL)) {
+    b = trace_add_thread_buffer();
+    if (!b)
+      return NULL;
+  }
+  return &b->events[b->count++ % Trace_buffer_events];
+}
+
+void trace_record_span(char const *name, U64 start, char const *arg_name,
+                       I64 arg) {
+  U64 end = trace_now();
+  Trace_event *ev = trace_push();
+  if (!ev)
+    return;
+  ev->name = name;
+  ev->arg_name = arg_name;
+  ev->start = start;
+  ev->duration = end - start;
+  ev->arg = arg;
+  ev->kind = Trace_event_span;
+}
+
+void trace_record_counter(char const *name, I64 value) {
+  Trace_event *ev = trace_push();
+  if (!ev)
+    return;
+  ev->name = name;
+  ev->arg_name = NULL;
+  ev->start = trace_now();
+  ev->duration = 0;
+  ev->arg = value;
+  ev->kind = Trace_event_counter;
+}
+
+// The names are all string literals from our own code, so they're written
+// without escaping.
+static void trace_fput_event(FILE *f, Usz tid, Trace_event const *ev) {
+  double ts = (double)(ev->start - trace_epoch) / 1000.0;
+  if (ev->kind == Trace_event_counter) {
+    fprintf(f,
+            ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%zu,"
+            "\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+            ev->name, tid, ts, (long long)ev->arg);
+    return;
+  }
+  fprintf(f,
+          ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,"
+          "\"ts\":%.3f,\"dur\":%.3f",
+          ev->name, tid, ts, (double)ev->duration / 1000.0);
+  if (ev->arg_name)
+    fprintf(f, ",\"args\":{\"%s\":%lld}", ev->arg_name, (long long)ev->arg);
+  fputc('}', f);
+}
+
+bool trace_close(void) {
+  if (!trace_file)
+    return true;
+  trace_is_on = false;
+  FILE *f = trace_file;
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+        "\"args\":{\"name\":\"orca\"}}",
+        f);
+  Trace_buffer *b = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+  while (b) {
+    if (b->thread_name)
+      fprintf(f,
+              ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+              "\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+              b->thread_id, b->thread_name);
+    U64 first = b->count > Trace_buffer_events
+                    ? b->count - Trace_buffer_events
+                    : 0;
+    for (U64 i = first; i < b->count; ++i)
+      trace_fput_event(f, b->thread_id,
+                       &b->events[i % Trace_buffer_events]);
+    Trace_buffer *next = b->next;
+    free(b);
+    b = next;
+  }
+  fputs("\n]}\n", f);
+  bool ok = !ferror(f);
+  ok = fclose(f) == 0 && ok;
+  trace_file = NULL;
+  trace_buffers = NULL;
+  trace_thread_buffer = NULL;
+  return ok;
+}
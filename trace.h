@@ -0,0 +1,68 @@
+#pragma once
+#include "base.h"
+
+// With --trace <file>, orca and cli record spans of what they're doing, like
+// each tick, the VM, drawing and file I/O, and write them out on exit as
+// Chrome trace-event JSON. The file can be opened in Perfetto
+// (https://ui.perfetto.dev) or chrome://tracing.
+//
+// Each thread records into a buffer of its own, so recording takes no locks.
+// The buffer is allocated up front, by trace_open() for the thread that calls
+// it and by trace_name_thread() for the others, so that it isn't allocated in
+// the middle of the first tick that's traced. A thread that records without
+// being named gets its buffer then, as a fallback. The buffer is a ring that
+// keeps the most recent Trace_buffer_events events if it fills up. When
+// tracing is off, trace_begin() and trace_end() only check a flag.
+//
+// Everything recorded is written by trace_close(), which has to be called
+// after any other threads that recorded have stopped.
+
+// Events kept per thread. Each one is 48 bytes on 64-bit targets, so this is
+// 12 MiB per traced thread. The TUI records around 10 events per frame and
+// tick, which makes this several minutes of a busy session.
+enum { Trace_buffer_events = 1 << 18 };
+
+extern bool trace_is_on;
+
+typedef struct {
+  char const *name;
+  U64 start; // ns
+} Trace_span;
+
+// Returns false if the file couldn't be created, and tracing stays off.
+bool trace_open(char const *path);
+// Writes the file and turns tracing off. Returns false if writing failed.
+bool trace_close(void);
+
+U64 trace_now(void);
+// Names the calling thread in the trace, and allocates its buffer if tracing
+// is on. Threads should call this when they start, after trace_open().
+// `name` should be a string literal.
+void trace_name_thread(char const *name);
+void trace_record_span(char const *name, U64 start, char const *arg_name,
+                       I64 arg);
+// A value that's plotted over time, like how late each tick started.
+void trace_record_counter(char const *name, I64 value);
+
+// `name` should be a string literal, since only the pointer is kept.
+static inline Trace_span trace_begin(char const *name) {
+  Trace_span span = {name, 0};
+  if (ORCA_UNLIKELY(trace_is_on))
+    span.start = trace_now();
+  return span;
+}
+static inline void trace_end(Trace_span span) {
+  if (ORCA_UNLIKELY(trace_is_on))
+    trace_record_span(span.name, span.start, NULL, 0);
+}
+// Same as trace_end(), with a number attached to the span, like the tick
+// number.
+static inline void trace_end_arg(Trace_span span, char const *arg_name,
+                                 I64 arg) {
+  if (ORCA_UNLIKELY(trace_is_on))
+    trace_record_span(span.name, span.start, arg_name, arg);
+}
+static inline void trace_counter(char const *name, I64 value) {
+  if (ORCA_UNLIKELY(trace_is_on))
+    trace_record_counter(name, value);
+}
@@ -1,14 +1,26 @@
+#include "alloc_audit.h"
+#include "arena.h"
 #include "base.h"
+#include "checkpoint.h"
+#include "cost.h"
 #include "field.h"
 #include "gbuffer.h"
+#include "hdr_hist.h"
+#include "io_worker.h"
+#include "metrics_server.h"
 #include "osc_out.h"
 #include "oso.h"
 #include "sim.h"
 #include "sysmisc.h"
 #include "term_util.h"
+#include "trace.h"
+#include "undo.h"
 #include "vmio.h"
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <locale.h>
+#include <sys/stat.h>
 
 #define SOKOL_IMPL
 #include "sokol_time.h"
@@ -23,30 +35,58 @@ int _nc_has_mouse(void);
 #define has_mouse _nc_has_mouse
 #endif
 
-#define TIME_DEBUG 0
-#if TIME_DEBUG
-static int spin_track_timeout = 0;
-#endif
-
 #define staticni ORCA_NOINLINE static
 
 staticni void usage(void) { // clang-format off
 fprintf(stderr,
 "Usage: orca [options] [file]\n\n"
 "General options:\n"
-"    --undo-limit <number>  Set the maximum number of undo steps.\n"
-"                           If you plan to work with large files,\n"
-"                           set this to a low number.\n"
-"                           Default: 100\n"
+"    --undo-limit <size>    Set the maximum memory used by undo history,\n"
+"                           in bytes. Can end in k, m or g.\n"
+"                           Set to 0 to turn off undo.\n"
+"                           Default: 64m\n"
 "    --initial-size <nxn>   When creating a new grid file, use these\n"
 "                           starting dimensions.\n"
 "    --bpm <number>         Set the tempo (beats per minute).\n"
 "                           Default: 120\n"
 "    --seed <number>        Set the seed for the random function.\n"
 "                           Default: 1\n"
+"    --mmap                 Edit the file in place instead of loading a\n"
+"                           copy of it. Changes are written to the file\n"
+"                           as you go. Meant for very large grids.\n"
+"    --timing-file <path>   On exit, write histograms of how late ticks\n"
+"                           started and how long the VM, output and\n"
+"                           drawing took. Ctrl+T shows them live.\n"
+"    --trace <path>         Record what each tick, drawing and file I/O\n"
+"                           did and when, and write it on exit as a\n"
+"                           Chrome trace for Perfetto or chrome://tracing.\n"
+"    --metrics-port <port>  Serve metrics for Prometheus over HTTP on\n"
+"                           127.0.0.1, at this port.\n"
 "    -h or --help           Print this message and exit.\n"
 "\n"
 "OSC/MIDI options:\n"
+"    --event-budget <number>\n"
+"        Set the maximum number of events a single step can output.\n"
+"        Events past this are dropped. 0 for no limit.\n"
+"        Default: 0\n"
+"\n"
+"    --midi-rate <number>\n"
+"    --osc-rate <number>\n"
+"    --udp-rate <number>\n"
+"        Set the maximum number of events per second sent to MIDI,\n"
+"        OSC or UDP. Events over the limit are dropped, except for\n"
+"        MIDI note-offs. 0 for no limit.\n"
+"        Default: 0\n"
+"\n"
+"    --event-rate <number>\n"
+"        Same as giving this to each of --midi-rate, --osc-rate and\n"
+"        --udp-rate.\n"
+"\n"
+"    --event-burst <number>\n"
+"        Set how many events can be sent to a destination at once\n"
+"        before its rate starts limiting them.\n"
+"        Default: 256\n"
+"\n"
 "    --strict-timing\n"
 "        Attempt to reduce timing jitter of outgoing MIDI and OSC\n"
 "        messages. Uses more CPU time. May have no effect.\n"
@@ -183,8 +223,9 @@ static void ged_cursor_move_relative(Ged_cursor *tc, Usz field_h, Usz field_w,
 
 staticni void draw_grid_cursor(WINDOW *win, int draw_y, int draw_x, int draw_h,
                                int draw_w, Glyph const *gbuffer, Usz field_h,
-                               Usz field_w, int scroll_y, int scroll_x,
-                               Usz cursor_y, Usz cursor_x, Usz cursor_h,
+                               Usz field_w, Usz stride, int scroll_y,
+                               int scroll_x, Usz cursor_y, Usz cursor_x,
+                               Usz cursor_h,
                                Usz cursor_w, Ged_input_mode input_mode,
                                bool is_playing) {
   (void)input_mode;
@@ -209,7 +250,7 @@ staticni void draw_grid_cursor(WINDOW *win, int draw_y, int draw_x, int draw_h,
     Usz cdraw_y = cursor_y - offset_y + (Usz)draw_y;
     Usz cdraw_x = cursor_x - offset_x + (Usz)draw_x;
     if (cdraw_y < (Usz)draw_h && cdraw_x < (Usz)draw_w) {
-      Glyph beneath = gbuffer[cursor_y * field_w + cursor_x];
+      Glyph beneath = gbuffer[cursor_y * stride + cursor_x];
       char displayed;
       if (beneath == '.') {
         displayed = is_playing ? '@' : '~';
@@ -298,98 +339,6 @@ staticni void draw_grid_cursor(WINDOW *win, int draw_y, int draw_x, int draw_h,
   }
 }
 
-typedef struct Undo_node {
-  Field field;
-  Usz tick_num;
-  struct Undo_node *prev, *next;
-} Undo_node;
-
-typedef struct {
-  Undo_node *first, *last;
-  Usz count, limit;
-} Undo_history;
-
-static void undo_history_init(Undo_history *hist, Usz limit) {
-  *hist = (Undo_history){0};
-  hist->limit = limit;
-}
-static void undo_history_deinit(Undo_history *hist) {
-  Undo_node *a = hist->first;
-  while (a) {
-    Undo_node *b = a->next;
-    field_deinit(&a->field);
-    free(a);
-    a = b;
-  }
-}
-
-staticni bool undo_history_push(Undo_history *hist, Field *field,
-                                Usz tick_num) {
-  if (hist->limit == 0)
-    return false;
-  Undo_node *new_node;
-  if (hist->count == hist->limit) {
-    new_node = hist->first;
-    if (new_node == hist->last) {
-      hist->first = NULL;
-      hist->last = NULL;
-    } else {
-      hist->first = new_node->next;
-      hist->first->prev = NULL;
-    }
-  } else {
-    new_node = malloc(sizeof(Undo_node));
-    if (!new_node)
-      return false;
-    ++hist->count;
-    field_init(&new_node->field);
-  }
-  field_copy(field, &new_node->field);
-  new_node->tick_num = tick_num;
-  if (hist->last) {
-    hist->last->next = new_node;
-    new_node->prev = hist->last;
-  } else {
-    hist->first = new_node;
-    hist->last = new_node;
-    new_node->prev = NULL;
-  }
-  new_node->next = NULL;
-  hist->last = new_node;
-  return true;
-}
-
-staticni void undo_history_pop(Undo_history *hist, Field *out_field,
-                               Usz *out_tick_num) {
-  Undo_node *last = hist->last;
-  if (!last)
-    return;
-  field_copy(&last->field, out_field);
-  *out_tick_num = last->tick_num;
-  if (hist->first == last) {
-    hist->first = NULL;
-    hist->last = NULL;
-  } else {
-    Undo_node *new_last = last->prev;
-    new_last->next = NULL;
-    hist->last = new_last;
-  }
-  field_deinit(&last->field);
-  free(last);
-  --hist->count;
-}
-
-staticni void undo_history_apply(Undo_history *hist, Field *out_field,
-                                 Usz *out_tick_num) {
-  Undo_node *last = hist->last;
-  if (!last)
-    return;
-  field_copy(&last->field, out_field);
-  *out_tick_num = last->tick_num;
-}
-
-static Usz undo_history_count(Undo_history *hist) { return hist->count; }
-
 staticni void print_activity_indicator(WINDOW *win, Usz activity_counter) {
   // 7 segments that can each light up as Colors different colors.
   // This gives us Colors^Segments total configurations.
@@ -459,7 +408,8 @@ staticni void draw_hud(WINDOW *win, int win_y, int win_x, int height, int width,
                        char const *filename, Usz field_h, Usz field_w,
                        Usz ruler_spacing_y, Usz ruler_spacing_x, Usz tick_num,
                        Usz bpm, Ged_cursor const *ged_cursor,
-                       Ged_input_mode input_mode, Usz activity_counter) {
+                       Ged_input_mode input_mode, Usz activity_counter,
+                       Usz suppressed_count) {
   (void)height;
   (void)width;
   enum { Tabstop = 8 };
@@ -473,6 +423,12 @@ staticni void draw_hud(WINDOW *win, int win_y, int win_x, int height, int width,
   wprintw(win, "%zu", bpm);
   advance_faketab(win, win_x, Tabstop);
   print_activity_indicator(win, activity_counter);
+  if (suppressed_count > 0) {
+    advance_faketab(win, win_x, Tabstop);
+    wattrset(win, A_bold);
+    wprintw(win, "%zu dropped", suppressed_count);
+    wattrset(win, A_normal);
+  }
   wmove(win, win_y + 1, win_x);
   wprintw(win, "%zu,%zu", ged_cursor->x, ged_cursor->y);
   advance_faketab(win, win_x, Tabstop);
@@ -501,17 +457,39 @@ staticni void draw_hud(WINDOW *win, int win_y, int win_x, int height, int width,
   waddstr(win, filename);
 }
 
+// Colors from cool to hot, by the cell's share of the hottest cell's heat.
+static attr_t heatmap_attrs(float heat, float max_heat) {
+  if (!(heat > max_heat * (1.0f / 64.0f)))
+    return 0;
+  float frac = heat / max_heat;
+  if (frac > 0.5f)
+    return A_bold | fg_bg(C_white, C_red);
+  if (frac > 0.25f)
+    return A_bold | fg_bg(C_black, C_yellow);
+  if (frac > 0.0625f)
+    return A_normal | fg_bg(C_black, C_green);
+  return A_normal | fg_bg(C_white, C_blue);
+}
+
+// `step` is the distance between one cell and the next in `gbuffer` and
+// `mbuffer`, and `stride` is the distance between rows in the same units. For
+// separate glyph and mark buffers, `step` is 1. For an interleaved Cell buffer
+// (see gbuffer.h), pass &cells->glyph and &cells->mark, with `step` as
+// sizeof(Cell) and `stride` as the width times sizeof(Cell).
+// `heat`, if not NULL, is laid out like `gbuffer` and colors the cells by
+// heatmap_attrs() instead of by their glyphs.
 staticni void draw_glyphs_grid(WINDOW *win, int draw_y, int draw_x, int draw_h,
                                int draw_w, Glyph const *restrict gbuffer,
                                Mark const *restrict mbuffer, Usz field_h,
-                               Usz field_w, Usz offset_y, Usz offset_x,
-                               Usz ruler_spacing_y, Usz ruler_spacing_x,
-                               bool use_fancy_dots, bool use_fancy_rulers) {
+                               Usz field_w, Usz stride, Usz step, Usz offset_y,
+                               Usz offset_x, Usz ruler_spacing_y,
+                               Usz ruler_spacing_x, bool use_fancy_dots,
+                               bool use_fancy_rulers, float const *heat,
+                               float max_heat) {
   assert(draw_y >= 0 && draw_x >= 0);
   assert(draw_h >= 0 && draw_w >= 0);
   enum { Bufcount = 4096 };
   chtype chbuffer[Bufcount];
-  // todo buffer limit
   if (offset_y >= field_h || offset_x >= field_w)
     return;
   if (draw_y >= draw_h || draw_x >= draw_w)
@@ -522,8 +500,6 @@ staticni void draw_glyphs_grid(WINDOW *win, int draw_y, int draw_x, int draw_h,
   Usz cols = (Usz)(draw_w - draw_x);
   if (field_w - offset_x < cols)
     cols = field_w - offset_x;
-  if (Bufcount < cols)
-    cols = Bufcount;
   if (rows == 0 || cols == 0)
     return;
   bool use_rulers = ruler_spacing_y != 0 && ruler_spacing_x != 0;
@@ -545,41 +521,51 @@ staticni void draw_glyphs_grid(WINDOW *win, int draw_y, int draw_x, int draw_h,
     }
   }
   for (Usz iy = 0; iy < rows; ++iy) {
-    Usz line_offset = (offset_y + iy) * field_w + offset_x;
+    Usz line_offset = (offset_y + iy) * stride + offset_x * step;
     Glyph const *g_row = gbuffer + line_offset;
     Mark const *m_row = mbuffer + line_offset;
     bool use_y_ruler = use_rulers && (iy + offset_y) % ruler_spacing_y == 0;
-    for (Usz ix = 0; ix < cols; ++ix) {
-      Glyph g = g_row[ix];
-      Mark m = m_row[ix];
-      chtype ch;
-      if (g == '.') {
-        if (use_y_ruler && (ix + offset_x) % ruler_spacing_x == 0) {
-          int p = 0; // clang-format off
-          if (iy + offset_y     == 0      ) p |= T;
-          if (iy + offset_y + 1 == field_h) p |= B;
-          if (ix + offset_x     == 0      ) p |= L;
-          if (ix + offset_x + 1 == field_w) p |= R;
-          ch = rs[p]; // clang-format on
+    // Very wide terminals are drawn Bufcount columns at a time.
+    for (Usz chunk_x = 0; chunk_x < cols; chunk_x += Bufcount) {
+      Usz chunk_end = cols - chunk_x < Bufcount ? cols : chunk_x + Bufcount;
+      for (Usz ix = chunk_x; ix < chunk_end; ++ix) {
+        Glyph g = g_row[ix * step];
+        Mark m = m_row[ix * step];
+        chtype ch;
+        if (g == '.') {
+          if (use_y_ruler && (ix + offset_x) % ruler_spacing_x == 0) {
+            int p = 0; // clang-format off
+            if (iy + offset_y     == 0      ) p |= T;
+            if (iy + offset_y + 1 == field_h) p |= B;
+            if (ix + offset_x     == 0      ) p |= L;
+            if (ix + offset_x + 1 == field_w) p |= R;
+            ch = rs[p]; // clang-format on
+          } else {
+            ch = bullet;
+          }
         } else {
-          ch = bullet;
+          ch = (chtype)g;
         }
-      } else {
-        ch = (chtype)g;
+        attr_t attrs = 0;
+        if (heat)
+          attrs = heatmap_attrs(heat[line_offset + ix * step], max_heat);
+        if (!attrs)
+          attrs = term_attrs_of_cell(g, m);
+        chbuffer[ix - chunk_x] = ch | attrs;
       }
-      attr_t attrs = term_attrs_of_cell(g, m);
-      chbuffer[ix] = ch | attrs;
+      // waddchnstr() doesn't advance the cursor, so move for each chunk.
+      wmove(win, draw_y + (int)iy, draw_x + (int)chunk_x);
+      waddchnstr(win, chbuffer, (int)(chunk_end - chunk_x));
     }
-    wmove(win, draw_y + (int)iy, draw_x);
-    waddchnstr(win, chbuffer, (int)cols);
   }
 }
 
 staticni void draw_glyphs_grid_scrolled(
     WINDOW *win, int draw_y, int draw_x, int draw_h, int draw_w,
     Glyph const *restrict gbuffer, Mark const *restrict mbuffer, Usz field_h,
-    Usz field_w, int scroll_y, int scroll_x, Usz ruler_spacing_y,
-    Usz ruler_spacing_x, bool use_fancy_dots, bool use_fancy_rulers) {
+    Usz field_w, Usz stride, Usz step, int scroll_y, int scroll_x,
+    Usz ruler_spacing_y, Usz ruler_spacing_x, bool use_fancy_dots,
+    bool use_fancy_rulers, float const *heat, float max_heat) {
   if (scroll_y < 0) {
     draw_y += -scroll_y;
     scroll_y = 0;
@@ -589,9 +575,9 @@ staticni void draw_glyphs_grid_scrolled(
     scroll_x = 0;
   }
   draw_glyphs_grid(win, draw_y, draw_x, draw_h, draw_w, gbuffer, mbuffer,
-                   field_h, field_w, (Usz)scroll_y, (Usz)scroll_x,
-                   ruler_spacing_y, ruler_spacing_x, use_fancy_dots,
-                   use_fancy_rulers);
+                   field_h, field_w, stride, step, (Usz)scroll_y,
+                   (Usz)scroll_x, ruler_spacing_y, ruler_spacing_x,
+                   use_fancy_dots, use_fancy_rulers, heat, max_heat);
 }
 
 static void ged_cursor_confine(Ged_cursor *tc, Usz height, Usz width) {
@@ -603,16 +589,26 @@ static void ged_cursor_confine(Ged_cursor *tc, Usz height, Usz width) {
     tc->x = width - 1;
 }
 
-staticni void draw_oevent_list(WINDOW *win, Oevent_list const *oevent_list) {
+staticni void draw_oevent_list(WINDOW *win, Oevent_list const *oevent_list,
+                               Usz tick_heap_calls, Usz ticks_since_heap_call,
+                               Usz audited_heap_calls) {
   wmove(win, 0, 0);
   int win_h = getmaxy(win);
-  wprintw(win, "Count: %d", (int)oevent_list->count);
-  for (Usz i = 0, num_events = oevent_list->count; i < num_events; ++i) {
+  wprintw(win, "Count: %d\tHeap calls while playing: %d (none in last %d)",
+          (int)oevent_list->count, (int)tick_heap_calls,
+          (int)ticks_since_heap_call);
+#ifdef FEAT_ALLOC_AUDIT
+  wprintw(win, "\tAudited: %d", (int)audited_heap_calls);
+#else
+  (void)audited_heap_calls;
+#endif
+  Oevent_iter it;
+  oevent_iter_init(&it, oevent_list);
+  for (Oevent const *ev; (ev = oevent_iter_next(&it));) {
     int cury = getcury(win);
     if (cury + 1 >= win_h)
       return;
     wmove(win, cury + 1, 0);
-    Oevent const *ev = oevent_list->buffer + i;
     Oevent_types evt = ev->any.oevent_type;
     switch (evt) {
     case Oevent_type_midi_note: {
@@ -668,8 +664,9 @@ staticni void ged_resize_grid(Field *field, Mbuf_reusable *mbr, Usz new_height,
   memset(field->buffer, '.', new_height * new_width * sizeof(Glyph));
   gbuffer_copy_subrect(scratch_field->buffer, field->buffer,
                        scratch_field->height, scratch_field->width,
-                       field->height, field->width, 0, 0, 0, 0,
-                       scratch_field->height, scratch_field->width);
+                       scratch_field->width, field->height, field->width,
+                       field->width, 0, 0, 0, 0, scratch_field->height,
+                       scratch_field->width);
   ged_cursor_confine(ged_cursor, new_height, new_width);
   mbuf_reusable_ensure_size(mbr, new_height, new_width);
 }
@@ -870,15 +867,124 @@ staticni void midi_mode_deinit(Midi_mode *mm) {
   }
 }
 
+// The most MIDI note-ons send_output_events() handles from one tick.
+enum { Midi_on_capacity = 512 };
+// Ticks which aren't watched by alloc_audit.h after playing starts, while the
+// scratch memory grows to fit the patch.
+enum { Alloc_audit_warmup_ticks = 4 };
+
+typedef enum {
+  Heatmap_mode_off = 0,
+  Heatmap_mode_vm_time,
+  Heatmap_mode_writes,
+} Heatmap_mode;
+
+enum { Heatmap_window_ticks = 32 };
+
+// Per-cell heat for the heatmap overlay, laid out like the grid, with rows
+// `stride` cells apart. After each tick, every cell's heat decays by
+// 1/Heatmap_window_ticks and what the cell did in that tick is added, so it's
+// roughly a sum over the last Heatmap_window_ticks ticks. In VM time mode,
+// that's the time its operator took. In writes mode, it's 1 if its glyph was
+// changed.
+typedef struct {
+  float *heat;
+  U32 *cell_time; // This tick's operator times, in VM time mode
+  Glyph *prev;    // The grid before this tick ran, in writes mode
+  Usz height, stride;
+  float max_heat;
+  Heatmap_mode mode;
+} Heatmap;
+
+static void heatmap_init(Heatmap *hm) {
+  *hm = (Heatmap){.heat = NULL, .mode = Heatmap_mode_off};
+}
+
+static void heatmap_deinit(Heatmap *hm) {
+  free(hm->heat);
+  free(hm->cell_time);
+  free(hm->prev);
+  heatmap_init(hm);
+}
+
+static void heatmap_set_mode(Heatmap *hm, Heatmap_mode mode) {
+  heatmap_deinit(hm);
+  hm->mode = mode;
+}
+
+// Clears the heat and makes room for the grid, if its size changed.
+static void heatmap_fit(Heatmap *hm, Usz height, Usz stride) {
+  if (hm->heat && hm->height == height && hm->stride == stride)
+    return;
+  Usz cells = height * stride;
+  hm->heat = realloc(hm->heat, cells * sizeof(float));
+  for (Usz i = 0; i < cells; ++i)
+    hm->heat[i] = 0.0f;
+  hm->max_heat = 0.0f;
+  if (hm->mode == Heatmap_mode_vm_time) {
+    hm->cell_time = realloc(hm->cell_time, cells * sizeof(U32));
+    memset(hm->cell_time, 0, cells * sizeof(U32));
+  } else {
+    hm->prev = realloc(hm->prev, cells * sizeof(Glyph));
+  }
+  hm->height = height;
+  hm->stride = stride;
+}
+
+static void heatmap_begin_tick(Heatmap *hm, Glyph const *gbuf, Usz height,
+                               Usz stride) {
+  if (hm->mode == Heatmap_mode_off)
+    return;
+  heatmap_fit(hm, height, stride);
+  if (hm->mode == Heatmap_mode_writes)
+    memcpy(hm->prev, gbuf, height * stride * sizeof(Glyph));
+}
+
+staticni void heatmap_end_tick(Heatmap *hm, Glyph const *gbuf) {
+  if (hm->mode == Heatmap_mode_off)
+    return;
+  float const keep = 1.0f - 1.0f / (float)Heatmap_window_ticks;
+  float *restrict heat = hm->heat;
+  float max_heat = 0.0f;
+  Usz cells = hm->height * hm->stride;
+  for (Usz i = 0; i < cells; ++i) {
+    float add;
+    if (hm->mode == Heatmap_mode_vm_time) {
+      add = (float)hm->cell_time[i];
+      hm->cell_time[i] = 0;
+    } else {
+      add = gbuf[i] != hm->prev[i] ? 1.0f : 0.0f;
+    }
+    float h = heat[i] * keep + add;
+    heat[i] = h;
+    if (h > max_heat)
+      max_heat = h;
+  }
+  hm->max_heat = max_heat;
+}
+
 typedef struct {
   Field field;
   Field scratch_field;
   Field clipboard_field;
+  Field_mapping field_map; // addr is non-NULL if `field` views a mapped file
+  U64 field_map_sync_clock;
   Mbuf_reusable mbuf_r;
   Undo_history undo_hist;
+  Arena tick_arena; // Reset at the start of each tick. Holds oevent_list
   Oevent_list oevent_list;
   Oevent_list scratch_oevent_list;
   Susnote_list susnote_list;
+  Usz tick_heap_calls;       // Made by ticks while playing, for debugging
+  Usz ticks_since_heap_call; // Since the last tick which made any
+  Usz ticks_played;          // Since the program started
+  Usz audited_heap_calls;    // Seen by alloc_audit.h, after warming up
+  // In nanoseconds, since the program started. Lateness is how far past its
+  // deadline each tick (or MIDI beat clock pulse) started.
+  Hdr_hist tick_lateness, vm_time, send_time, draw_time;
+  Oprofile oprofile; // Since the profile page was opened
+  Heatmap heatmap;
+  Oguard oguard;
   Ged_cursor ged_cursor;
   Usz tick_num;
   Usz ruler_spacing_y, ruler_spacing_x;
@@ -888,6 +994,10 @@ typedef struct {
   double accum_secs;
   double time_to_next_note_off;
   Oosc_dev *oosc_dev;
+  Io_worker *io_worker; // Owned by Tui. NULL until it's started
+  Metrics_server *metrics; // Owned by Tui. NULL unless --metrics-port
+  U64 late_ticks;          // Later than Metrics_late_tick_ns
+  U64 events_by_type[Oevent_type_count]; // Only counted for metrics
   Midi_mode midi_mode;
   Usz activity_counter;
   Usz random_seed;
@@ -902,6 +1012,8 @@ typedef struct {
   bool is_playing : 1;
   bool midi_bclock : 1;
   bool draw_event_list : 1;
+  bool draw_timing : 1;
+  bool draw_profile : 1;
   bool is_mouse_down : 1;
   bool is_mouse_dragging : 1;
   bool is_hud_visible : 1;
@@ -911,11 +1023,28 @@ static void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed) {
   field_init(&a->field);
   field_init(&a->scratch_field);
   field_init(&a->clipboard_field);
+  a->field_map = (Field_mapping){0};
+  a->field_map_sync_clock = 0;
   mbuf_reusable_init(&a->mbuf_r);
   undo_history_init(&a->undo_hist, undo_limit);
+  arena_init(&a->tick_arena);
   oevent_list_init(&a->oevent_list);
+  oevent_list_use_arena(&a->oevent_list, &a->tick_arena);
+  arena_reserve(&a->tick_arena, 64 * 1024);
   oevent_list_init(&a->scratch_oevent_list);
   susnote_list_init(&a->susnote_list);
+  susnote_list_reserve(&a->susnote_list,
+                       Susnote_max_count + 2 * Midi_on_capacity);
+  a->tick_heap_calls = 0;
+  a->ticks_since_heap_call = 0;
+  a->ticks_played = 0;
+  a->audited_heap_calls = 0;
+  heatmap_init(&a->heatmap);
+  hdr_hist_reset(&a->tick_lateness);
+  hdr_hist_reset(&a->vm_time);
+  hdr_hist_reset(&a->send_time);
+  hdr_hist_reset(&a->draw_time);
+  oguard_init(&a->oguard);
   ged_cursor_init(&a->ged_cursor);
   a->tick_num = 0;
   a->ruler_spacing_y = a->ruler_spacing_x = 8;
@@ -925,6 +1054,10 @@ static void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed) {
   a->accum_secs = 0.0;
   a->time_to_next_note_off = 1.0;
   a->oosc_dev = NULL;
+  a->io_worker = NULL;
+  a->metrics = NULL;
+  a->late_ticks = 0;
+  memset(a->events_by_type, 0, sizeof a->events_by_type);
   midi_mode_init_null(&a->midi_mode);
   a->activity_counter = 0;
   a->random_seed = init_seed;
@@ -939,20 +1072,99 @@ static void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed) {
   a->is_playing = false;
   a->midi_bclock = false;
   a->draw_event_list = false;
+  a->draw_timing = false;
+  a->draw_profile = false;
   a->is_mouse_down = false;
   a->is_mouse_dragging = false;
   a->is_hud_visible = false;
 }
 
+// `tick_budget` and the rates of 0 mean no limit. `rates` is indexed by
+// Oguard_dests.
+static void ged_set_event_limits(Ged *a, Usz tick_budget,
+                                 double const rates[Oguard_dest_count],
+                                 double burst) {
+  Usz limit = tick_budget > 0 ? tick_budget : SIZE_MAX;
+  a->oevent_list.count_limit = limit;
+  a->scratch_oevent_list.count_limit = limit;
+  oguard_init(&a->oguard);
+  for (Usz i = 0; i < Oguard_dest_count; ++i)
+    oguard_set_rate(&a->oguard, (Oguard_dests)i, rates[i], burst);
+}
+
+// Frees the grid, or writes it back and unmaps it if it's a mapped file.
+// `field` is left empty.
+static void ged_release_field(Ged *a) {
+  if (a->field_map.addr) {
+    // A background save might still be syncing the mapping.
+    if (a->io_worker)
+      io_worker_wait_idle(a->io_worker);
+    field_unmap(&a->field_map, &a->field);
+  } else {
+    field_deinit(&a->field);
+    field_init(&a->field);
+  }
+}
+
+// Replaces the grid with a live view of the file, if it can be mapped.
+staticni Field_load_error ged_map_file(Ged *a, char const *filepath) {
+  Field mapped;
+  Field_mapping fm;
+  Field_load_error fle = field_map_file(filepath, &mapped, &fm);
+  if (fle != Field_load_error_ok)
+    return fle;
+  ged_release_field(a);
+  a->field = mapped;
+  a->field_map = fm;
+  a->field_map_sync_clock = stm_now();
+  undo_history_clear(&a->undo_hist);
+  mbuf_reusable_ensure_size(&a->mbuf_r, mapped.height, mapped.stride);
+  a->needs_remarking = true;
+  a->is_draw_dirty = true;
+  return Field_load_error_ok;
+}
+
+// If the grid is a mapped file, switches to a private copy of it and unmaps
+// the file. Has to be done before the grid is resized or replaced. If
+// `keep_grid` is false, the grid is left empty instead of copied.
+staticni void ged_unmap_field(Ged *a, bool keep_grid) {
+  if (!a->field_map.addr)
+    return;
+  Field copy;
+  field_init(&copy);
+  if (keep_grid)
+    field_copy(&a->field, &copy);
+  if (a->io_worker)
+    io_worker_wait_idle(a->io_worker);
+  field_unmap(&a->field_map, &a->field);
+  a->field = copy;
+  a->needs_remarking = true;
+}
+
+// Asks the OS to start writing a mapped grid back to its file, about once a
+// second. MS_ASYNC doesn't wait for the writes, so this doesn't hold up the
+// main loop.
+staticni void ged_sync_mapped_field(Ged *a) {
+  if (!a->field_map.addr)
+    return;
+  U64 now = stm_now();
+  if (stm_sec(stm_diff(now, a->field_map_sync_clock)) < 1.0)
+    return;
+  a->field_map_sync_clock = now;
+  field_mapping_sync(&a->field_map, false);
+}
+
 static void ged_deinit(Ged *a) {
-  field_deinit(&a->field);
+  ged_release_field(a);
   field_deinit(&a->scratch_field);
   field_deinit(&a->clipboard_field);
   mbuf_reusable_deinit(&a->mbuf_r);
   undo_history_deinit(&a->undo_hist);
   oevent_list_deinit(&a->oevent_list);
   oevent_list_deinit(&a->scratch_oevent_list);
+  arena_deinit(&a->tick_arena);
   susnote_list_deinit(&a->susnote_list);
+  heatmap_deinit(&a->heatmap);
   if (a->oosc_dev)
     oosc_dev_destroy(a->oosc_dev);
   midi_mode_deinit(&a->midi_mode);
@@ -1064,6 +1276,35 @@ staticni void ged_stop_all_sustained_notes(Ged *a) {
   a->time_to_next_note_off = 1.0;
 }
 
+// Replaces the grid, tick number, random seed, BPM and sustained notes with
+// the ones from a checkpoint file. Nothing is changed if it fails. The caller
+// is responsible for updating anything that depends on the grid size.
+staticni Checkpoint_error ged_load_checkpoint(Ged *a, char const *filepath) {
+  Susnote_list loaded_notes;
+  susnote_list_init(&loaded_notes);
+  Checkpoint_vars vars;
+  Checkpoint_error err = checkpoint_load(filepath, &a->field, &a->mbuf_r,
+                                         &loaded_notes, &vars);
+  if (err != Checkpoint_error_ok) {
+    susnote_list_deinit(&loaded_notes);
+    return err;
+  }
+  // The notes that are sounding now won't be tracked anymore, so stop them.
+  ged_stop_all_sustained_notes(a);
+  susnote_list_deinit(&a->susnote_list);
+  a->susnote_list = loaded_notes;
+  susnote_list_reserve(&a->susnote_list,
+                       Susnote_max_count + 2 * Midi_on_capacity);
+  a->time_to_next_note_off = susnote_list_soonest_deadline(&a->susnote_list);
+  a->tick_num = vars.tick_num;
+  a->random_seed = vars.random_seed;
+  if (vars.bpm > 0)
+    a->bpm = vars.bpm;
+  a->needs_remarking = true;
+  a->is_draw_dirty = true;
+  return Checkpoint_error_ok;
+}
+
 // The way orca handles MIDI sustains, timing, and overlapping note-ons (plus
 // the 'mono' thing being added) has changed multiple times over time. Now we
 // are in a situation where this function is a complete mess and needs an
@@ -1073,8 +1314,7 @@ staticni void ged_stop_all_sustained_notes(Ged *a) {
 
 staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
                                  Usz bpm, Susnote_list *susnote_list,
-                                 Oevent const *events, Usz count) {
-  enum { Midi_on_capacity = 512 };
+                                 Oguard *oguard, Oevent_list const *events) {
   typedef struct {
     U8 channel;
     U8 note_number;
@@ -1092,12 +1332,17 @@ staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
   Usz monofied_chans = 0; // bitset of channels with new mono notes
   double frame_secs = 60.0 / (double)bpm / 4.0;
 
-  for (Usz i = 0; i < count; ++i) {
-    Oevent const *e = events + i;
+  Oevent_iter it;
+  oevent_iter_init(&it, events);
+  for (Oevent const *e; (e = oevent_iter_next(&it));) {
     switch ((Oevent_types)e->any.oevent_type) {
     case Oevent_type_midi_note: {
       if (midi_note_count == Midi_on_capacity)
         break;
+      // Note-offs caused by these note-ons bypass the guard. Checking here
+      // means a suppressed note-on never gets a sustain entry.
+      if (!oguard_admit(oguard, Oguard_dest_midi))
+        break;
       Oevent_midi_note const *em = &e->midi_note;
       Usz note_number = (Usz)(12u * em->octave + em->note);
       if (note_number > 127)
@@ -1125,6 +1370,8 @@ staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
       break;
     }
     case Oevent_type_midi_cc: {
+      if (!oguard_admit(oguard, Oguard_dest_midi))
+        break;
       Oevent_midi_cc const *ec = &e->midi_cc;
       // Note that we're not preserving the exact order of MIDI events as
       // emitted by the orca VM. Notes and CCs that are emitted in the same
@@ -1137,6 +1384,8 @@ staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
       break;
     }
     case Oevent_type_midi_pb: {
+      if (!oguard_admit(oguard, Oguard_dest_midi))
+        break;
       Oevent_midi_pb const *ep = &e->midi_pb;
       // Same caveat regarding ordering with MIDI CC also applies here.
       send_midi_chan_msg(oosc_dev, midi_mode, 0xe, ep->channel, ep->lsb,
@@ -1145,7 +1394,7 @@ staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
     }
     case Oevent_type_osc_ints: {
       // kinda lame
-      if (!oosc_dev)
+      if (!oosc_dev || !oguard_admit(oguard, Oguard_dest_osc))
         continue;
       Oevent_osc_ints const *eo = &e->osc_ints;
       char path[] = {'/', eo->glyph, '\0'};
@@ -1158,7 +1407,7 @@ staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
       break;
     }
     case Oevent_type_udp_string: {
-      if (!oosc_dev)
+      if (!oosc_dev || !oguard_admit(oguard, Oguard_dest_udp))
         continue;
       Oevent_udp_string const *eo = &e->udp_string;
       oosc_send_datagram(oosc_dev, eo->chars, eo->count);
@@ -1259,11 +1508,59 @@ static double ged_secs_to_deadline(Ged const *a) {
 }
 
 staticni void clear_and_run_vm(Glyph *restrict gbuf, Mark *restrict mbuf,
-                               Usz height, Usz width, Usz tick_number,
-                               Oevent_list *oevent_list, Usz random_seed) {
-  mbuffer_clear(mbuf, height, width);
+                               Usz height, Usz width, Usz stride,
+                               Usz tick_number, Oevent_list *oevent_list,
+                               Usz random_seed) {
+  mbuffer_clear(mbuf, height, stride);
   oevent_list_clear(oevent_list);
-  orca_run(gbuf, mbuf, height, width, tick_number, oevent_list, random_seed);
+  orca_run_strided(gbuf, mbuf, height, width, stride, tick_number, oevent_list,
+                   random_seed);
+}
+
+// Runs the tick for the grid being edited. The VM is only profiled while the
+// profile page or the VM time heatmap is showing, since it's slower.
+staticni void ged_run_vm(Ged *a) {
+  Heatmap *hm = &a->heatmap;
+  Usz height = a->field.height, stride = a->field.stride;
+  heatmap_begin_tick(hm, a->field.buffer, height, stride);
+  if (a->draw_profile || hm->mode == Heatmap_mode_vm_time) {
+    mbuffer_clear(a->mbuf_r.buffer, height, stride);
+    oevent_list_clear(&a->oevent_list);
+    orca_run_profiled(a->field.buffer, a->mbuf_r.buffer, height,
+                      a->field.width, stride, a->tick_num, &a->oevent_list,
+                      a->random_seed, &a->oprofile, hm->cell_time);
+  } else {
+    clear_and_run_vm(a->field.buffer, a->mbuf_r.buffer, height,
+                     a->field.width, stride, a->tick_num, &a->oevent_list,
+                     a->random_seed);
+  }
+  heatmap_end_tick(hm, a->field.buffer);
+}
+
+// Frees the previous tick's scratch memory, which includes its events.
+static void ged_reset_tick_arena(Ged *a) {
+  arena_reset(&a->tick_arena);
+  oevent_list_use_arena(&a->oevent_list, &a->tick_arena);
+}
+
+static Usz ged_heap_calls(Ged const *a) {
+  return a->tick_arena.heap_calls + a->susnote_list.heap_calls;
+}
+
+staticni void ged_publish_metrics(Ged *a) {
+  if (!a->metrics)
+    return;
+  static Metrics_snapshot snap; // Too big to want on the stack
+  snap.ticks = a->ticks_played;
+  snap.late_ticks = a->late_ticks;
+  memcpy(snap.events, a->events_by_type, sizeof snap.events);
+  snap.dropped_events = oguard_suppressed_count(&a->oguard);
+  snap.sustained_notes = a->susnote_list.count;
+  snap.bpm = a->bpm;
+  snap.is_playing = a->is_playing;
+  snap.tick_lateness = a->tick_lateness;
+  snap.vm_time = a->vm_time;
+  metrics_server_publish(a->metrics, &snap);
 }
 
 staticni void ged_do_stuff(Ged *a) {
@@ -1275,11 +1572,6 @@ staticni void ged_do_stuff(Ged *a) {
   Oosc_dev *oosc_dev = a->oosc_dev;
   Midi_mode *midi_mode = &a->midi_mode;
   bool crossed_deadline = false;
-#if TIME_DEBUG
-  Usz spins = 0;
-  U64 spin_start = stm_now();
-  (void)spin_start;
-#endif
   for (;;) {
     U64 now = stm_now();
     U64 diff = stm_diff(now, a->clock);
@@ -1287,29 +1579,16 @@ staticni void ged_do_stuff(Ged *a) {
     if (sdiff >= secs_span) {
       a->clock = now;
       a->accum_secs = sdiff - secs_span;
-#if TIME_DEBUG
-      if (a->accum_secs > 0.000001) {
-        fprintf(stderr, "late: %.2f u-secs\n", a->accum_secs * 1000 * 1000);
-        if (a->accum_secs > 0.00005) {
-          fprintf(stderr, "guilty timeout: %d\n", spin_track_timeout);
-        }
-      }
-#endif
+      hdr_hist_record(&a->tick_lateness, (U64)(a->accum_secs * 1e9));
+      trace_counter("lateness_us", (I64)(a->accum_secs * 1e6));
+      if (a->accum_secs * 1e9 > (double)Metrics_late_tick_ns)
+        ++a->late_ticks;
       crossed_deadline = true;
       break;
     }
     if (secs_span - sdiff > ms_to_sec(0.1))
       break;
-#if TIME_DEBUG
-    ++spins;
-#endif
-  }
-#if TIME_DEBUG
-  if (spins > 0) {
-    fprintf(stderr, "%d spins in %f us with timeout %d\n", (int)spins,
-            stm_us(stm_since(spin_start)), spin_track_timeout);
   }
-#endif
   if (!crossed_deadline)
     return;
   if (a->midi_bclock) {
@@ -1319,21 +1598,56 @@ staticni void ged_do_stuff(Ged *a) {
     if (sixths != 0)
       return;
   }
+  bool is_audited = a->ticks_played >= Alloc_audit_warmup_ticks;
+  if (is_audited)
+    alloc_audit_begin("ged_do_stuff", a->tick_num);
+  Usz heap_calls = ged_heap_calls(a);
+  Trace_span tick_span = trace_begin("tick");
+  ged_reset_tick_arena(a);
+  U64 send_start = stm_now();
+  Trace_span span = trace_begin("susnotes");
   apply_time_to_sustained_notes(oosc_dev, midi_mode, secs_span,
                                 &a->susnote_list, &a->time_to_next_note_off);
-  clear_and_run_vm(a->field.buffer, a->mbuf_r.buffer, a->field.height,
-                   a->field.width, a->tick_num, &a->oevent_list,
-                   a->random_seed);
+  trace_end(span);
+  U64 send_time = stm_since(send_start);
+  U64 vm_start = stm_now();
+  span = trace_begin("orca_run");
+  ged_run_vm(a);
+  trace_end(span);
+  hdr_hist_record(&a->vm_time, (U64)stm_ns(stm_since(vm_start)));
   ++a->tick_num;
   a->needs_remarking = true;
   a->is_draw_dirty = true;
 
+  a->oguard.vm_dropped_count += a->oevent_list.dropped_count;
+  oguard_advance_time(&a->oguard, 60.0 / (double)a->bpm / 4.0);
   Usz count = a->oevent_list.count;
   if (count > 0) {
+    send_start = stm_now();
+    span = trace_begin("send_output_events");
     send_output_events(oosc_dev, midi_mode, a->bpm, &a->susnote_list,
-                       a->oevent_list.buffer, count);
+                       &a->oguard, &a->oevent_list);
+    trace_end_arg(span, "events", (I64)count);
+    send_time += stm_since(send_start);
     a->activity_counter += count;
   }
+  hdr_hist_record(&a->send_time, (U64)stm_ns(send_time));
+  trace_end_arg(tick_span, "tick", (I64)a->tick_num - 1);
+  // Once the arena and the lists have grown to fit the patch, this should
+  // stay at 0. It's shown with the event list.
+  heap_calls = ged_heap_calls(a) - heap_calls;
+  a->tick_heap_calls += heap_calls;
+  a->ticks_since_heap_call = heap_calls ? 0 : a->ticks_since_heap_call + 1;
+  if (is_audited)
+    a->audited_heap_calls += alloc_audit_end();
+  ++a->ticks_played;
+  if (a->metrics) {
+    Oevent_iter it;
+    oevent_iter_init(&it, &a->oevent_list);
+    for (Oevent const *ev; (ev = oevent_iter_next(&it));)
+      ++a->events_by_type[ev->any.oevent_type];
+    ged_publish_metrics(a);
+  }
 }
 
 static inline Isz isz_clamp(Isz x, Isz low, Isz high) {
@@ -1407,6 +1721,137 @@ staticni void ged_set_window_size(Ged *a, int win_h, int win_w,
   ged_make_cursor_visible(a);
 }
 
+// Rows of the timing page and of the --timing-file summary.
+static int timing_header_print(char *buf, Usz size) {
+  return snprintf(buf, size, "%-14s%10s%10s%10s%10s%10s%10s", "Timing (us)",
+                  "count", "p50", "p90", "p99", "p99.9", "max");
+}
+
+static int timing_row_print(char *buf, Usz size, char const *name,
+                            Hdr_hist const *h) {
+  double const pcts[] = {50.0, 90.0, 99.0, 99.9};
+  int n = snprintf(buf, size, "%-14s%10llu", name,
+                   (unsigned long long)h->total_count);
+  for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(pcts) && n >= 0 && (Usz)n < size;
+       ++i)
+    n += snprintf(buf + n, size - (Usz)n, "%10.1f",
+                  (double)hdr_hist_percentile(h, pcts[i]) / 1000.0);
+  if (n >= 0 && (Usz)n < size)
+    n += snprintf(buf + n, size - (Usz)n, "%10.1f", (double)h->max / 1000.0);
+  return n;
+}
+
+// How much of a tick the p99 of lateness, VM time and send time add up to.
+// Past 100%, ticks are being missed.
+static double ged_timing_budget_used(Ged const *a) {
+  double tick_ns = 60.0 / (double)a->bpm / 4.0 * 1e9;
+  U64 used = hdr_hist_percentile(&a->tick_lateness, 99.0) +
+             hdr_hist_percentile(&a->vm_time, 99.0) +
+             hdr_hist_percentile(&a->send_time, 99.0);
+  return 100.0 * (double)used / tick_ns;
+}
+
+static void ged_timing_rows(Ged const *a, char const **names,
+                            Hdr_hist const **hists) {
+  names[0] = "Lateness", hists[0] = &a->tick_lateness;
+  names[1] = "VM", hists[1] = &a->vm_time;
+  names[2] = "Send", hists[2] = &a->send_time;
+  names[3] = "Draw", hists[3] = &a->draw_time;
+}
+
+enum { Timing_row_count = 4 };
+
+staticni void draw_timing_page(WINDOW *win, Ged const *a) {
+  char buf[128];
+  char const *names[Timing_row_count];
+  Hdr_hist const *hists[Timing_row_count];
+  ged_timing_rows(a, names, hists);
+  int win_h = getmaxy(win);
+  int y = 0;
+  timing_header_print(buf, sizeof buf);
+  mvwaddstr(win, y++, 0, buf);
+  for (Usz i = 0; i < Timing_row_count && y < win_h; ++i) {
+    timing_row_print(buf, sizeof buf, names[i], hists[i]);
+    mvwaddstr(win, y++, 0, buf);
+  }
+  if (y < win_h)
+    mvwprintw(win, y, 0, "Tick: %.1f us at %d BPM\tp99 budget used: %.1f%%",
+              60.0 / (double)a->bpm / 4.0 * 1e6, (int)a->bpm,
+              ged_timing_budget_used(a));
+}
+
+// The operators that took the most time, then the event types. Times are per
+// tick, averaged since the page was opened.
+staticni void draw_profile_page(WINDOW *win, Oprofile const *prof) {
+  Oprofile_summary sum;
+  oprofile_summarize(prof, &sum);
+  int win_h = getmaxy(win);
+  int y = 0;
+  mvwprintw(win, y++, 0,
+            "Profile: %d ticks, %.0f %s/tick, %.1f%% in operators",
+            (int)sum.ticks, sum.tick_time, orca_profile_unit, sum.oper_share);
+  int events_h = 1 + (int)sum.event_count;
+  if (y < win_h)
+    mvwprintw(win, y++, 0, "%-10s%12s%12s%8s", "Operator", "calls/tick",
+              "time/tick", "share");
+  for (Usz i = 0; i < sum.oper_count && y < win_h - events_h; ++i) {
+    Oprofile_row const *r = &sum.opers[i];
+    mvwprintw(win, y++, 0, "%-10c%12.2f%12.0f%7.1f%%", (char)r->key,
+              r->count, r->time, r->share);
+  }
+  if (y < win_h)
+    mvwprintw(win, y++, 0, "%-10s%12s%12s%8s", "Event", "count/tick",
+              "time/tick", "share");
+  for (Usz i = 0; i < sum.event_count && y < win_h; ++i) {
+    Oprofile_row const *r = &sum.events[i];
+    mvwprintw(win, y++, 0, "%-10s%12.2f%12.0f%7.1f%%",
+              oevent_type_name((Oevent_types)r->key), r->count, r->time,
+              r->share);
+  }
+}
+
+// In the top right corner, so it doesn't cover the pages on the left.
+staticni void draw_heatmap_legend(WINDOW *win, Heatmap_mode mode, int win_w) {
+  char const *name = mode == Heatmap_mode_vm_time ? "VM time" : "Writes";
+  int w = 10 + (int)strlen(name) + 9;
+  if (win_w < w)
+    return;
+  wmove(win, 0, win_w - w);
+  wattrset(win, A_normal);
+  wprintw(win, " Heatmap: %s ", name);
+  float const levels[] = {0.05f, 0.2f, 0.4f, 1.0f};
+  for (Usz i = 0; i < ORCA_ARRAY_COUNTOF(levels); ++i)
+    waddch(win, ' ' | heatmap_attrs(levels[i], 1.0f));
+  wprintw(win, " %d", (int)Heatmap_window_ticks);
+}
+
+// Writes the timing histograms, for --timing-file.
+staticni bool ged_write_timing_file(Ged const *a, char const *path) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  char buf[128];
+  char const *names[Timing_row_count];
+  Hdr_hist const *hists[Timing_row_count];
+  ged_timing_rows(a, names, hists);
+  fprintf(f, "%zu ticks played, last at %d BPM\n", a->ticks_played,
+          (int)a->bpm);
+  fprintf(f, "p99 budget used: %.1f%%\n\n", ged_timing_budget_used(a));
+  timing_header_print(buf, sizeof buf);
+  fprintf(f, "%s\n", buf);
+  for (Usz i = 0; i < Timing_row_count; ++i) {
+    timing_row_print(buf, sizeof buf, names[i], hists[i]);
+    fprintf(f, "%s\n", buf);
+  }
+  for (Usz i = 0; i < Timing_row_count; ++i) {
+    fprintf(f, "\n%s (ns)\n  %12s %12s %10s %9s\n", names[i], "from", "to",
+            "count", "percent");
+    hdr_hist_fput_buckets(f, hists[i]);
+  }
+  bool ok = !ferror(f);
+  return fclose(f) == 0 && ok;
+}
+
 staticni void ged_draw(Ged *a, WINDOW *win, char const *filename,
                        bool use_fancy_dots, bool use_fancy_rulers) {
   // We can predictavely step the next simulation tick and then use the
@@ -1421,36 +1866,57 @@ staticni void ged_draw(Ged *a, WINDOW *win, char const *filename,
   // mark buffer that it produces, then roll back the glyph buffer to where it
   // was before. This should produce results similar to having specialized UI
   // code that looks at each glyph and figures out the ports, etc.
+  //
+  // A mapped grid is skipped, since the point of mapping it is to not have a
+  // second copy of it. It's drawn without the port colors while paused.
   if (a->needs_remarking && !a->is_playing) {
-    field_resize_raw_if_necessary(&a->scratch_field, a->field.height,
-                                  a->field.width);
-    field_copy(&a->field, &a->scratch_field);
-    mbuf_reusable_ensure_size(&a->mbuf_r, a->field.height, a->field.width);
-    clear_and_run_vm(a->scratch_field.buffer, a->mbuf_r.buffer, a->field.height,
-                     a->field.width, a->tick_num, &a->scratch_oevent_list,
-                     a->random_seed);
+    if (a->field_map.addr) {
+      mbuffer_clear(a->mbuf_r.buffer, a->field.height, a->field.stride);
+    } else {
+      field_resize_raw_if_necessary(&a->scratch_field, a->field.height,
+                                    a->field.width);
+      field_copy(&a->field, &a->scratch_field);
+      mbuf_reusable_ensure_size(&a->mbuf_r, a->field.height, a->field.width);
+      clear_and_run_vm(a->scratch_field.buffer, a->mbuf_r.buffer,
+                       a->field.height, a->field.width, a->field.width,
+                       a->tick_num, &a->scratch_oevent_list, a->random_seed);
+    }
     a->needs_remarking = false;
   }
   int win_w = a->win_w;
+  Heatmap const *hm = &a->heatmap;
+  // Until the next tick, the heat might be for a grid of a different size.
+  bool use_heat = hm->heat && hm->height == a->field.height &&
+                  hm->stride == a->field.stride;
   draw_glyphs_grid_scrolled(
       win, 0, 0, a->grid_h, win_w, a->field.buffer, a->mbuf_r.buffer,
-      a->field.height, a->field.width, a->grid_scroll_y, a->grid_scroll_x,
-      a->ruler_spacing_y, a->ruler_spacing_x, use_fancy_dots, use_fancy_rulers);
+      a->field.height, a->field.width, a->field.stride, 1, a->grid_scroll_y,
+      a->grid_scroll_x, a->ruler_spacing_y, a->ruler_spacing_x,
+      use_fancy_dots, use_fancy_rulers, use_heat ? hm->heat : NULL,
+      hm->max_heat);
   draw_grid_cursor(win, 0, 0, a->grid_h, win_w, a->field.buffer,
-                   a->field.height, a->field.width, a->grid_scroll_y,
-                   a->grid_scroll_x, a->ged_cursor.y, a->ged_cursor.x,
-                   a->ged_cursor.h, a->ged_cursor.w, a->input_mode,
-                   a->is_playing);
+                   a->field.height, a->field.width, a->field.stride,
+                   a->grid_scroll_y, a->grid_scroll_x, a->ged_cursor.y,
+                   a->ged_cursor.x, a->ged_cursor.h, a->ged_cursor.w,
+                   a->input_mode, a->is_playing);
   if (a->is_hud_visible) {
     filename = filename ? filename : "unnamed";
     int hud_x = win_w > 50 + a->softmargin_x * 2 ? a->softmargin_x : 0;
     draw_hud(win, a->grid_h, hud_x, Hud_height, win_w, filename,
              a->field.height, a->field.width, a->ruler_spacing_y,
              a->ruler_spacing_x, a->tick_num, a->bpm, &a->ged_cursor,
-             a->input_mode, a->activity_counter);
+             a->input_mode, a->activity_counter,
+             oguard_suppressed_count(&a->oguard));
   }
   if (a->draw_event_list)
-    draw_oevent_list(win, &a->oevent_list);
+    draw_oevent_list(win, &a->oevent_list, a->tick_heap_calls,
+                     a->ticks_since_heap_call, a->audited_heap_calls);
+  if (a->draw_timing)
+    draw_timing_page(win, a);
+  if (a->draw_profile)
+    draw_profile_page(win, &a->oprofile);
+  if (hm->mode != Heatmap_mode_off)
+    draw_heatmap_legend(win, hm->mode, win_w);
   a->is_draw_dirty = false;
 }
 
@@ -1535,12 +2001,22 @@ staticni bool ged_slide_selection(Ged *a, int delta_y, int delta_x) {
   if (curs_y_0 == curs_y_1 && curs_x_0 == curs_x_1 && curs_h_0 == curs_h_1 &&
       curs_w_0 == curs_w_1)
     return false;
-  undo_history_push(&a->undo_hist, &a->field, a->tick_num);
+  // The slide only touches the old and new selection rectangles, so saving the
+  // box around both of them is enough.
+  Usz undo_y = curs_y_0 < curs_y_1 ? curs_y_0 : curs_y_1;
+  Usz undo_x = curs_x_0 < curs_x_1 ? curs_x_0 : curs_x_1;
+  Usz undo_b = curs_y_0 + curs_h_0 > curs_y_1 + curs_h_1 ? curs_y_0 + curs_h_0
+                                                         : curs_y_1 + curs_h_1;
+  Usz undo_r = curs_x_0 + curs_w_0 > curs_x_1 + curs_w_1 ? curs_x_0 + curs_w_0
+                                                         : curs_x_1 + curs_w_1;
+  undo_history_push_rect(&a->undo_hist, &a->field, a->tick_num, undo_y, undo_x,
+                         undo_b - undo_y, undo_r - undo_x);
   Usz field_h = a->field.height;
   Usz field_w = a->field.width;
+  Usz field_stride = a->field.stride;
   gbuffer_copy_subrect(a->field.buffer, a->field.buffer, field_h, field_w,
-                       field_h, field_w, curs_y_0, curs_x_0, curs_y_1, curs_x_1,
-                       curs_h_0, curs_w_0);
+                       field_stride, field_h, field_w, field_stride, curs_y_0,
+                       curs_x_0, curs_y_1, curs_x_1, curs_h_0, curs_w_0);
   // Erase/clear the area that was within the selection rectangle in the
   // starting position, but wasn't written to during the copy. (In other words,
   // this is the area that was 'left behind' when we moved the selection
@@ -1562,10 +2038,10 @@ staticni bool ged_slide_selection(Ged *a, int delta_y, int delta_x) {
     ex = curs_x_1 + curs_w_0;
     ew = (curs_x_0 + curs_w_0) - ex;
   }
-  gbuffer_fill_subrect(a->field.buffer, field_h, field_w, ey, curs_x_0, eh,
-                       curs_w_0, '.');
-  gbuffer_fill_subrect(a->field.buffer, field_h, field_w, curs_y_0, ex,
-                       curs_h_0, ew, '.');
+  gbuffer_fill_subrect(a->field.buffer, field_h, field_w, field_stride, ey,
+                       curs_x_0, eh, curs_w_0, '.');
+  gbuffer_fill_subrect(a->field.buffer, field_h, field_w, field_stride,
+                       curs_y_0, ex, curs_h_0, ew, '.');
   a->needs_remarking = true;
   return true;
 }
@@ -1738,6 +2214,7 @@ staticni void ged_adjust_rulers_relative(Ged *a, Isz delta_y, Isz delta_x) {
 }
 
 staticni void ged_resize_grid_relative(Ged *a, Isz delta_y, Isz delta_x) {
+  ged_unmap_field(a, true);
   ged_resize_grid_snap_ruler(&a->field, &a->mbuf_r, a->ruler_spacing_y,
                              a->ruler_spacing_x, delta_y, delta_x, a->tick_num,
                              &a->scratch_field, &a->undo_hist, &a->ged_cursor);
@@ -1748,9 +2225,10 @@ staticni void ged_resize_grid_relative(Ged *a, Isz delta_y, Isz delta_x) {
 }
 
 staticni void ged_write_character(Ged *a, char c) {
-  undo_history_push(&a->undo_hist, &a->field, a->tick_num);
+  undo_history_push_rect(&a->undo_hist, &a->field, a->tick_num,
+                         a->ged_cursor.y, a->ged_cursor.x, 1, 1);
   gbuffer_poke(a->field.buffer, a->field.height, a->field.width,
-               a->ged_cursor.y, a->ged_cursor.x, c);
+               a->field.stride, a->ged_cursor.y, a->ged_cursor.x, c);
   // Indicate we want the next simulation step to be run predictavely,
   // so that we can use the reulsting mark buffer for UI visualization.
   // This is "expensive", so it could be skipped for non-interactive
@@ -1768,8 +2246,10 @@ staticni bool ged_fill_selection_with_char(Ged *a, Glyph c) {
   if (!ged_try_selection_clipped_to_field(a, &curs_y, &curs_x, &curs_h,
                                           &curs_w))
     return false;
-  gbuffer_fill_subrect(a->field.buffer, a->field.height, a->field.width, curs_y,
-                       curs_x, curs_h, curs_w, c);
+  undo_history_push_rect(&a->undo_hist, &a->field, a->tick_num, curs_y, curs_x,
+                         curs_h, curs_w);
+  gbuffer_fill_subrect(a->field.buffer, a->field.height, a->field.width,
+                       a->field.stride, curs_y, curs_x, curs_h, curs_w, c);
   return true;
 }
 
@@ -1783,7 +2263,8 @@ staticni bool ged_copy_selection_to_clipbard(Ged *a) {
   Field *cb_field = &a->clipboard_field;
   field_resize_raw_if_necessary(cb_field, curs_h, curs_w);
   gbuffer_copy_subrect(a->field.buffer, cb_field->buffer, field_h, field_w,
-                       curs_h, curs_w, curs_y, curs_x, 0, 0, curs_h, curs_w);
+                       a->field.stride, curs_h, curs_w, curs_w, curs_y, curs_x,
+                       0, 0, curs_h, curs_w);
   return true;
 }
 
@@ -1798,7 +2279,6 @@ staticni void ged_input_character(Ged *a, char c) {
     if (a->ged_cursor.h <= 1 && a->ged_cursor.w <= 1) {
       ged_write_character(a, c);
     } else {
-      undo_history_push(&a->undo_hist, &a->field, a->tick_num);
       ged_fill_selection_with_char(a, c);
       a->needs_remarking = true;
       a->is_draw_dirty = true;
@@ -1809,11 +2289,15 @@ staticni void ged_input_character(Ged *a, char c) {
 
 typedef enum {
   Ged_input_cmd_undo,
+  Ged_input_cmd_redo,
   Ged_input_cmd_toggle_append_mode,
   Ged_input_cmd_toggle_selresize_mode,
   Ged_input_cmd_toggle_slide_mode,
   Ged_input_cmd_step_forward,
   Ged_input_cmd_toggle_show_event_list,
+  Ged_input_cmd_toggle_show_timing,
+  Ged_input_cmd_toggle_show_profile,
+  Ged_input_cmd_cycle_heatmap,
   Ged_input_cmd_toggle_play_pause,
   Ged_input_cmd_cut,
   Ged_input_cmd_copy,
@@ -1845,18 +2329,31 @@ staticni void ged_set_playing(Ged *a, bool playing) {
       send_midi_byte(a->oosc_dev, &a->midi_mode, 0xFC); // "stop"
   }
   a->is_draw_dirty = true;
+  ged_publish_metrics(a);
 }
 
 staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
   switch (ev) {
   case Ged_input_cmd_undo:
-    if (undo_history_count(&a->undo_hist) == 0)
-      break;
-    if (a->is_playing)
-      undo_history_apply(&a->undo_hist, &a->field, &a->tick_num);
-    else
-      undo_history_pop(&a->undo_hist, &a->field, &a->tick_num);
+  case Ged_input_cmd_redo:
+    if (ev == Ged_input_cmd_undo) {
+      if (undo_history_count(&a->undo_hist) == 0)
+        break;
+      if (undo_history_undo_resizes(&a->undo_hist, &a->field))
+        ged_unmap_field(a, true);
+      if (a->is_playing)
+        undo_history_apply(&a->undo_hist, &a->field, &a->tick_num);
+      else
+        undo_history_undo(&a->undo_hist, &a->field, &a->tick_num);
+    } else {
+      if (a->is_playing || !undo_history_can_redo(&a->undo_hist))
+        break;
+      if (undo_history_redo_resizes(&a->undo_hist, &a->field))
+        ged_unmap_field(a, true);
+      undo_history_redo(&a->undo_hist, &a->field, &a->tick_num);
+    }
     ged_cursor_confine(&a->ged_cursor, a->field.height, a->field.width);
+    mbuf_reusable_ensure_size(&a->mbuf_r, a->field.height, a->field.stride);
     ged_update_internal_geometry(a);
     ged_make_cursor_visible(a);
     a->needs_remarking = true;
@@ -1882,9 +2379,8 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
     break;
   case Ged_input_cmd_step_forward:
     undo_history_push(&a->undo_hist, &a->field, a->tick_num);
-    clear_and_run_vm(a->field.buffer, a->mbuf_r.buffer, a->field.height,
-                     a->field.width, a->tick_num, &a->oevent_list,
-                     a->random_seed);
+    ged_reset_tick_arena(a);
+    ged_run_vm(a);
     ++a->tick_num;
     a->activity_counter += a->oevent_list.count;
     a->needs_remarking = true;
@@ -1895,11 +2391,26 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
     break;
   case Ged_input_cmd_toggle_show_event_list:
     a->draw_event_list = !a->draw_event_list;
+    a->draw_timing = a->draw_profile = false;
+    a->is_draw_dirty = true;
+    break;
+  case Ged_input_cmd_toggle_show_timing:
+    a->draw_timing = !a->draw_timing;
+    a->draw_event_list = a->draw_profile = false;
+    a->is_draw_dirty = true;
+    break;
+  case Ged_input_cmd_toggle_show_profile:
+    a->draw_profile = !a->draw_profile;
+    a->draw_event_list = a->draw_timing = false;
+    memset(&a->oprofile, 0, sizeof(Oprofile));
+    a->is_draw_dirty = true;
+    break;
+  case Ged_input_cmd_cycle_heatmap:
+    heatmap_set_mode(&a->heatmap, (Heatmap_mode)((a->heatmap.mode + 1) % 3));
     a->is_draw_dirty = true;
     break;
   case Ged_input_cmd_cut:
     if (ged_copy_selection_to_clipbard(a)) {
-      undo_history_push(&a->undo_hist, &a->field, a->tick_num);
       ged_fill_selection_with_char(a, '.');
       a->needs_remarking = true;
       a->is_draw_dirty = true;
@@ -1926,10 +2437,11 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
       cpy_w = field_w - curs_x;
     if (cpy_h == 0 || cpy_w == 0)
       break;
-    undo_history_push(&a->undo_hist, &a->field, a->tick_num);
+    undo_history_push_rect(&a->undo_hist, &a->field, a->tick_num, curs_y,
+                           curs_x, cpy_h, cpy_w);
     gbuffer_copy_subrect(cb_field->buffer, a->field.buffer, cbfield_h,
-                         cbfield_w, field_h, field_w, 0, 0, curs_y, curs_x,
-                         cpy_h, cpy_w);
+                         cbfield_w, cbfield_w, field_h, field_w,
+                         a->field.stride, 0, 0, curs_y, curs_x, cpy_h, cpy_w);
     a->ged_cursor.h = cpy_h;
     a->ged_cursor.w = cpy_w;
     a->needs_remarking = true;
@@ -1949,19 +2461,6 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
   }
 }
 
-static bool hacky_try_save(Field *field, char const *filename) {
-  if (!filename)
-    return false;
-  if (field->height == 0 || field->width == 0)
-    return false;
-  FILE *f = fopen(filename, "w");
-  if (!f)
-    return false;
-  field_fput(field, f);
-  fclose(f);
-  return true;
-}
-
 //
 // menu stuff
 //
@@ -1970,6 +2469,7 @@ enum {
   Main_menu_id = 1,
   Open_form_id,
   Save_as_form_id,
+  Save_checkpoint_form_id,
   Set_tempo_form_id,
   Set_grid_dims_form_id,
   Autofit_menu_id,
@@ -2002,6 +2502,7 @@ enum {
   Main_menu_open,
   Main_menu_save,
   Main_menu_save_as,
+  Main_menu_save_checkpoint,
   Main_menu_set_tempo,
   Main_menu_set_grid_dims,
   Main_menu_autofit_grid,
@@ -2009,6 +2510,7 @@ enum {
   Main_menu_cosmetics,
   Main_menu_playback,
   Main_menu_osc,
+  Main_menu_estimate_cost,
 #ifdef FEAT_PORTMIDI
   Main_menu_choose_portmidi_output,
 #endif
@@ -2021,6 +2523,7 @@ static void push_main_menu(void) {
   qmenu_add_choice(qm, Main_menu_open, "Open...");
   qmenu_add_choice(qm, Main_menu_save, "Save");
   qmenu_add_choice(qm, Main_menu_save_as, "Save As...");
+  qmenu_add_choice(qm, Main_menu_save_checkpoint, "Save Checkpoint...");
   qmenu_add_spacer(qm);
   qmenu_add_choice(qm, Main_menu_set_tempo, "Set BPM...");
   qmenu_add_choice(qm, Main_menu_set_grid_dims, "Set Grid Size...");
@@ -2032,6 +2535,7 @@ static void push_main_menu(void) {
 #endif
   qmenu_add_spacer(qm);
   qmenu_add_choice(qm, Main_menu_playback, "Clock & Timing...");
+  qmenu_add_choice(qm, Main_menu_estimate_cost, "Estimate Tick Cost...");
   qmenu_add_choice(qm, Main_menu_cosmetics, "Appearance...");
   qmenu_add_spacer(qm);
   qmenu_add_choice(qm, Main_menu_controls, "Controls...");
@@ -2181,12 +2685,16 @@ static void push_controls_msg(void) {
       {"! : % / = # *", NULL},
       {"Spacebar", "Play/Pause"},
       {"Ctrl+Z or Ctrl+U", "Undo"},
+      {"Ctrl+Y", "Redo"},
       {"Ctrl+X", "Cut"},
       {"Ctrl+C", "Copy"},
       {"Ctrl+V", "Paste"},
       {"Ctrl+S", "Save"},
       {"Ctrl+F", "Frame Step Forward"},
       {"Ctrl+R", "Reset Frame Number"},
+      {"Ctrl+T", "Show Timing"},
+      {"Ctrl+P", "Show Operator Profile"},
+      {"Ctrl+W", "Heatmap: VM Time/Writes/Off"},
       {"Ctrl+I or Insert", "Append/Overwrite Mode"},
       // {"/", "Key Trigger Mode"},
       {"' (quote)", "Rectangle Selection Mode"},
@@ -2295,25 +2803,61 @@ static void push_opers_guide_msg(void) {
     waddstr(w, items[i].desc);
   }
 }
+// Checked against the tempo and the event limits that are set now.
+static void push_estimate_cost_msg(Ged const *a) {
+  Usz count_limit = a->oevent_list.count_limit;
+  Cost_limits limits = {
+      .bpm = a->bpm,
+      .event_budget = count_limit == SIZE_MAX ? 0 : count_limit,
+      .midi_rate = a->oguard.buckets[Oguard_dest_midi].rate,
+      .osc_rate = a->oguard.buckets[Oguard_dest_osc].rate,
+      .udp_rate = a->oguard.buckets[Oguard_dest_udp].rate,
+  };
+  Cost_estimate est;
+  cost_estimate(a->field.buffer, a->field.height, a->field.width,
+                a->field.stride, &limits, &est);
+  char buf[2048];
+  cost_report(&est, &limits, buf, sizeof buf);
+  int rows = 0, cols = 0;
+  for (char const *line = buf; *line;) {
+    char const *end = strchr(line, '\n');
+    int len = end ? (int)(end - line) : (int)strlen(line);
+    if (len > cols)
+      cols = len;
+    ++rows;
+    line += len + (end ? 1 : 0);
+  }
+  int left_pad = 1, right_pad = 1;
+  Qmsg *qm = qmsg_push(rows, left_pad + cols + right_pad);
+  qmsg_set_title(qm, "Tick Cost Estimate");
+  WINDOW *w = qmsg_window(qm);
+  int row = 0;
+  for (char const *line = buf; *line; ++row) {
+    char const *end = strchr(line, '\n');
+    int len = end ? (int)(end - line) : (int)strlen(line);
+    wmove(w, row, left_pad);
+    waddnstr(w, line, len);
+    line += len + (end ? 1 : 0);
+  }
+}
 static void push_open_form(char const *initial) {
   qform_single_line_input(Open_form_id, "Open", initial);
 }
-staticni bool try_save_with_msg(Field *field, oso const *str) {
-  if (!osolen(str))
-    return false;
-  bool ok = hacky_try_save(field, osoc(str));
-  if (ok) {
-    Qmsg *qm = qmsg_printf_push(NULL, "Saved to:\n%s", osoc(str));
-    qmsg_set_dismiss_mode(qm, Qmsg_dismiss_mode_passthrough);
-  } else {
-    qmsg_printf_push("Error Saving File", "Unable to save file to:\n%s",
-                     osoc(str));
-  }
-  return ok;
-}
 static void push_save_as_form(char const *initial) {
   qform_single_line_input(Save_as_form_id, "Save As", initial);
 }
+staticni void push_save_checkpoint_form(oso const *file_name,
+                                        bool file_is_checkpoint) {
+  oso *initial = NULL;
+  if (osolen(file_name)) {
+    osoputoso(&initial, file_name);
+    if (!file_is_checkpoint)
+      osocat(&initial, ".ckpt");
+  }
+  qform_single_line_input(Save_checkpoint_form_id, "Save Checkpoint",
+                          osoc(initial));
+  osofree(initial);
+}
 static void push_set_tempo_form(Usz initial) {
   char buff[64];
   int snres = snprintf(buff, sizeof buff, "%zu", initial);
@@ -2378,6 +2922,39 @@ staticni bool read_int(char const *str, int *out) {
   return true;
 }
 
+// Reads a number of bytes, like '4096', '512k' or '64m'. Returns false on
+// error.
+staticni bool read_byte_size(char const *str, Usz *out) {
+  unsigned long long a;
+  char suffix = 0, extra;
+  int res = sscanf(str, "%llu%c%c", &a, &suffix, &extra);
+  if (res < 1 || res > 2 || str[0] == '-')
+    return false;
+  unsigned shift = 0;
+  switch (suffix) {
+  case 0:
+    break;
+  case 'k':
+  case 'K':
+    shift = 10;
+    break;
+  case 'm':
+  case 'M':
+    shift = 20;
+    break;
+  case 'g':
+  case 'G':
+    shift = 30;
+    break;
+  default:
+    return false;
+  }
+  if (a > (SIZE_MAX >> shift))
+    return false;
+  *out = (Usz)(a << shift);
+  return true;
+}
+
 // Reads something like '5x3' or '5'. Writes the same value to both outputs if
 // only one is specified. Returns false on error.
 staticni bool read_nxn_or_n(char const *str, int *out_a, int *out_b) {
@@ -2505,7 +3082,7 @@ typedef struct {
   Ged ged;
   oso *file_name;
   oso *osc_address, *osc_port, *osc_midi_bidule_path;
-  int undo_history_limit;
+  Usz undo_history_limit; // In bytes
   int softmargin_y, softmargin_x;
   int hardmargin_y, hardmargin_x;
   U32 prefs_touched;
@@ -2513,8 +3090,268 @@ typedef struct {
   bool strict_timing;
   bool osc_output_enabled;
   bool fancy_grid_dots, fancy_grid_rulers;
+  bool file_is_checkpoint; // Save writes a checkpoint instead of text
+  bool use_mmap;           // Edit files in place with ged_map_file()
 } Tui;
 
+// Saving happens on the I/O worker thread. Each job gets its own copy of
+// whatever it writes, taken when the save is requested, so that the grid can
+// keep running and be edited while the write is in progress. The result is
+// shown as a message when the main loop picks up the finished job.
+typedef enum {
+  Tui_io_save_text,
+  Tui_io_save_checkpoint,
+  Tui_io_sync_mapped,
+  Tui_io_save_prefs,
+} Tui_io_type;
+
+typedef struct {
+  Io_job io; // Must be first
+  Tui_io_type type;
+  oso *path;
+  Field field;            // text, checkpoint
+  Mbuf_reusable mbuf_r;   // checkpoint
+  Susnote_list susnotes;  // checkpoint
+  Checkpoint_vars vars;   // checkpoint
+  Field_mapping mapping;  // sync
+  U32 prefs_touched;      // prefs
+  oso *prefs[Confoptslen];
+  bool remap_when_saved;  // text: Save As from a mapped grid
+  bool ok;
+  int errno_value;
+  Checkpoint_error checkpoint_error;
+  Ezconf_w_error prefs_error;
+} Tui_io_job;
+
+static Tui_io_job *tui_io_job_new(Tui_io_type type) {
+  Tui_io_job *job = calloc(1, sizeof(Tui_io_job));
+  job->type = type;
+  field_init(&job->field);
+  mbuf_reusable_init(&job->mbuf_r);
+  susnote_list_init(&job->susnotes);
+  return job;
+}
+
+static void tui_io_job_free(Io_job *io) {
+  Tui_io_job *job = (Tui_io_job *)io;
+  osofree(job->path);
+  field_deinit(&job->field);
+  mbuf_reusable_deinit(&job->mbuf_r);
+  susnote_list_deinit(&job->susnotes);
+  for (Usz i = 0; i < Confoptslen; ++i)
+    osofree(job->prefs[i]);
+  free(job);
+}
+
+// Writes to a temp file next to the real one, and moves it into place once
+// it's safely on disk, so that a failed save never leaves a half-written file.
+// If the path is a symlink, the file it points to is the one replaced, and an
+// existing file keeps its permissions.
+staticni bool tui_io_write_text_file(Field *field, char const *path,
+                                     int *out_errno) {
+  char resolved[PATH_MAX];
+  if (realpath(path, resolved))
+    path = resolved;
+  struct stat st;
+  bool existed = stat(path, &st) == 0;
+  oso *temppath = NULL;
+  osoputprintf(&temppath, "%s.tmp", path);
+  bool ok = false;
+  FILE *f = fopen(osoc(temppath), "w");
+  if (f) {
+    field_fput(field, f);
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (ok && existed)
+      ok = fchmod(fileno(f), st.st_mode & 07777) == 0;
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(osoc(temppath), path) == 0;
+    if (!ok) {
+      int e = errno;
+      unlink(osoc(temppath));
+      errno = e;
+    }
+  }
+  *out_errno = ok ? 0 : errno;
+  osofree(temppath);
+  return ok;
+}
+
+static void tui_io_job_run(Io_job *io) {
+  Tui_io_job *job = (Tui_io_job *)io;
+  static char const *const span_names[] = {
+      [Tui_io_save_text] = "save text",
+      [Tui_io_save_checkpoint] = "save checkpoint",
+      [Tui_io_sync_mapped] = "sync mapped file",
+      [Tui_io_save_prefs] = "save prefs",
+  };
+  Trace_span span = trace_begin(span_names[job->type]);
+  switch (job->type) {
+  case Tui_io_save_text:
+    job->ok = tui_io_write_text_file(&job->field, osoc(job->path),
+                                     &job->errno_value);
+    break;
+  case Tui_io_save_checkpoint:
+    job->checkpoint_error =
+        checkpoint_save(osoc(job->path), &job->field, job->mbuf_r.buffer,
+                        &job->susnotes, &job->vars);
+    job->ok = job->checkpoint_error == Checkpoint_error_ok;
+    break;
+  case Tui_io_sync_mapped:
+    job->ok = field_mapping_sync(&job->mapping, true);
+    job->errno_value = job->ok ? 0 : errno;
+    break;
+  case Tui_io_save_prefs: {
+    Ezconf_opt optsbuff[Confoptslen];
+    Ezconf_w ez;
+    ezconf_w_start(&ez, optsbuff, ORCA_ARRAY_COUNTOF(optsbuff),
+                   conf_file_name);
+    for (int i = 0; i < Confoptslen; i++) {
+      if (job->prefs_touched & TOUCHFLAG(i))
+        ezconf_w_addopt(&ez, confopts[i], i);
+    }
+    while (ezconf_w_step(&ez)) {
+      oso const *val = job->prefs[ez.optid];
+      if (osolen(val))
+        fputs(osoc(val), ez.file);
+    }
+    job->prefs_error = ez.error;
+    job->ok = !ez.error;
+    break;
+  }
+  }
+  trace_end(span);
+}
+
+// Writes a message describing the result of a finished job into `buf`.
+staticni void tui_io_job_describe(Tui_io_job const *job, char const **title,
+                                  char *buf, Usz bufsize) {
+  char const *path = osoc(job->path);
+  *title = NULL;
+  if (job->ok) {
+    snprintf(buf, bufsize, "%s to:\n%s",
+             job->type == Tui_io_save_checkpoint ? "Saved checkpoint"
+                                                 : "Saved",
+             path);
+    return;
+  }
+  switch (job->type) {
+  case Tui_io_save_text:
+  case Tui_io_sync_mapped:
+    *title = "Error Saving File";
+    snprintf(buf, bufsize, "Unable to save file to:\n%s\n%s", path,
+             strerror(job->errno_value));
+    break;
+  case Tui_io_save_checkpoint:
+    *title = "Error Saving Checkpoint";
+    snprintf(buf, bufsize, "%s:\n%s", path,
+             checkpoint_error_string(job->checkpoint_error));
+    break;
+  case Tui_io_save_prefs:
+    *title = "Config Error";
+    snprintf(buf, bufsize, "Error when writing configuration file:\n%s",
+             ezconf_w_errorstring(job->prefs_error));
+    break;
+  }
+}
+
+static void tui_push_io_job(Tui *t, Tui_io_job *job) {
+  job->io.run = tui_io_job_run;
+  io_worker_push(t->ged.io_worker, &job->io);
+}
+
+staticni void tui_save_text(Tui *t, oso const *path, bool remap_when_saved) {
+  if (t->ged.field.height == 0 || t->ged.field.width == 0) {
+    qmsg_printf_push("Error Saving File", "Unable to save file to:\n%s",
+                     osoc(path));
+    return;
+  }
+  Tui_io_job *job = tui_io_job_new(Tui_io_save_text);
+  osoputoso(&job->path, path);
+  field_copy(&t->ged.field, &job->field);
+  job->remap_when_saved = remap_when_saved;
+  tui_push_io_job(t, job);
+}
+
+staticni void tui_save_checkpoint(Tui *t, oso const *path) {
+  Ged *a = &t->ged;
+  Tui_io_job *job = tui_io_job_new(Tui_io_save_checkpoint);
+  osoputoso(&job->path, path);
+  // Packed copies, so the marks line up with the copied field.
+  field_copy(&a->field, &job->field);
+  Usz h = a->field.height, w = a->field.width;
+  mbuf_reusable_ensure_size(&job->mbuf_r, h, w);
+  for (Usz iy = 0; iy < h; ++iy)
+    memcpy(job->mbuf_r.buffer + iy * w,
+           a->mbuf_r.buffer + iy * a->field.stride, w);
+  Usz sn_count = a->susnote_list.count;
+  if (sn_count > 0) {
+    job->susnotes.buffer = malloc(sn_count * sizeof(Susnote));
+    memcpy(job->susnotes.buffer, a->susnote_list.buffer,
+           sn_count * sizeof(Susnote));
+    job->susnotes.count = job->susnotes.capacity = sn_count;
+  }
+  job->vars = (Checkpoint_vars){
+      .tick_num = a->tick_num, .random_seed = a->random_seed, .bpm = a->bpm};
+  tui_push_io_job(t, job);
+}
+
+// A mapped grid is already in its file, so saving only has to wait for the
+// changes to be written out.
+staticni void tui_sync_mapped(Tui *t, oso const *path) {
+  Tui_io_job *job = tui_io_job_new(Tui_io_sync_mapped);
+  osoputoso(&job->path, path);
+  job->mapping = t->ged.field_map;
+  tui_push_io_job(t, job);
+}
+
+// After a Save As from a mapped grid, go back to editing in place, in the new
+// file. Edits made while the save was in progress are copied into it. Skipped
+// if the grid was resized or replaced in the meantime.
+staticni void tui_remap_saved_file(Tui *t, Tui_io_job const *job) {
+  Ged *a = &t->ged;
+  if (a->field_map.addr || strcmp(osoc(t->file_name), osoc(job->path)) != 0 ||
+      a->field.height != job->field.height ||
+      a->field.width != job->field.width)
+    return;
+  Field edited = a->field;
+  field_init(&a->field);
+  // The history is kept. It can hold entries from before a resize, but undo
+  // and redo unmap the grid again before restoring one of those.
+  Undo_history hist = a->undo_hist;
+  undo_history_init(&a->undo_hist, hist.limit);
+  if (ged_map_file(a, osoc(job->path)) != Field_load_error_ok ||
+      a->field.height != edited.height || a->field.width != edited.width) {
+    ged_release_field(a);
+    a->field = edited;
+  } else {
+    gbuffer_copy_subrect(edited.buffer, a->field.buffer, edited.height,
+                         edited.width, edited.stride, a->field.height,
+                         a->field.width, a->field.stride, 0, 0, 0, 0,
+                         edited.height, edited.width);
+    field_deinit(&edited);
+  }
+  a->undo_hist = hist;
+}
+
+staticni void tui_finish_io_jobs(Tui *t) {
+  Io_job *io;
+  while ((io = io_worker_pop_done(t->ged.io_worker))) {
+    Tui_io_job *job = (Tui_io_job *)io;
+    char buf[1024];
+    char const *title;
+    tui_io_job_describe(job, &title, buf, sizeof buf);
+    // Saving preferences is only worth a message if it failed.
+    if (!job->ok || job->type != Tui_io_save_prefs) {
+      Qmsg *qm = qmsg_printf_push(title, "%s", buf);
+      if (job->ok)
+        qmsg_set_dismiss_mode(qm, Qmsg_dismiss_mode_passthrough);
+    }
+    if (job->ok && job->remap_when_saved)
+      tui_remap_saved_file(t, job);
+    tui_io_job_free(io);
+  }
+}
+
 ORCA_OK_IF_UNUSED staticni void print_loading_message(char const *s) {
   Usz len = strlen(s);
   if (len > INT_MAX)
@@ -2637,11 +3474,10 @@ staticni void tui_load_conf(Tui *t) {
   osofree(osc_output_port);
 }
 
+// The values are rendered to strings here, and written to the conf file by the
+// I/O worker.
 staticni void tui_save_prefs(Tui *t) {
-  Ezconf_opt optsbuff[Confoptslen];
-  Ezconf_w ez;
-  ezconf_w_start(&ez, optsbuff, ORCA_ARRAY_COUNTOF(optsbuff), conf_file_name);
-  oso *midi_output_device_name = NULL;
+  Tui_io_job *job = tui_io_job_new(Tui_io_save_prefs);
   switch (t->ged.midi_mode.any.type) {
   case Midi_mode_type_null:
     break;
@@ -2651,14 +3487,15 @@ staticni void tui_save_prefs(Tui *t) {
 #ifdef FEAT_PORTMIDI
   case Midi_mode_type_portmidi: {
     PmError pmerror;
+    oso *midi_output_device_name = NULL;
     if (!portmidi_find_name_of_device_id(t->ged.midi_mode.portmidi.device_id,
                                          &pmerror, &midi_output_device_name) ||
         osolen(midi_output_device_name) < 1) {
-      osowipe(&midi_output_device_name);
+      osofree(midi_output_device_name);
       break;
     }
-    ezconf_w_addopt(&ez, confopts[Confopt_portmidi_output_device],
-                    Confopt_portmidi_output_device);
+    job->prefs[Confopt_portmidi_output_device] = midi_output_device_name;
+    job->prefs_touched |= TOUCHFLAG(Confopt_portmidi_output_device);
     break;
   }
 #endif
@@ -2671,48 +3508,38 @@ staticni void tui_save_prefs(Tui *t) {
     if (i == Confopt_portmidi_output_device)
       // This has its own special logic
       continue;
-    if (t->prefs_touched & TOUCHFLAG(i))
-      ezconf_w_addopt(&ez, confopts[i], i);
-  }
-  while (ezconf_w_step(&ez)) {
-    switch (ez.optid) {
+    if (!(t->prefs_touched & TOUCHFLAG(i)))
+      continue;
+    job->prefs_touched |= TOUCHFLAG(i);
+    oso **val = &job->prefs[i];
+    switch (i) {
     case Confopt_osc_output_address:
       // Fine to not write anything here
       if (osolen(t->osc_address))
-        fputs(osoc(t->osc_address), ez.file);
+        osoputoso(val, t->osc_address);
       break;
     case Confopt_osc_output_port:
       if (osolen(t->osc_port))
-        fputs(osoc(t->osc_port), ez.file);
+        osoputoso(val, t->osc_port);
       break;
     case Confopt_osc_output_enabled:
-      fputc(t->osc_output_enabled ? '1' : '0', ez.file);
+      osoput(val, t->osc_output_enabled ? "1" : "0");
       break;
-#ifdef FEAT_PORTMIDI
-    case Confopt_portmidi_output_device:
-      fputs(osoc(midi_output_device_name), ez.file);
-      break;
-#endif
     case Confopt_midi_beat_clock:
-      fputc(t->ged.midi_bclock ? '1' : '0', ez.file);
+      osoput(val, t->ged.midi_bclock ? "1" : "0");
       break;
     case Confopt_margins:
-      fprintf(ez.file, "%dx%d", t->softmargin_x, t->softmargin_y);
+      osoputprintf(val, "%dx%d", t->softmargin_x, t->softmargin_y);
       break;
     case Confopt_grid_dot_type:
-      fputs(t->fancy_grid_dots ? prefval_fancy : prefval_plain, ez.file);
+      osoput(val, t->fancy_grid_dots ? prefval_fancy : prefval_plain);
       break;
     case Confopt_grid_ruler_type:
-      fputs(t->fancy_grid_rulers ? prefval_fancy : prefval_plain, ez.file);
+      osoput(val, t->fancy_grid_rulers ? prefval_fancy : prefval_plain);
       break;
     }
   }
-  osofree(midi_output_device_name);
-  if (ez.error) {
-    char const *msg = ezconf_w_errorstring(ez.error);
-    qmsg_printf_push("Config Error",
-                     "Error when writing configuration file:\n%s", msg);
-  }
+  tui_push_io_job(t, job);
 }
 
 staticni bool tui_suggest_nice_grid_size(Tui *t, int win_h, int win_w,
@@ -2838,8 +3665,12 @@ staticni void tui_adjust_term_size(Tui *t, WINDOW **cont_window) {
 }
 
 static void tui_try_save(Tui *t) {
-  if (osolen(t->file_name) > 0)
-    try_save_with_msg(&t->ged.field, t->file_name);
+  if (t->ged.field_map.addr)
+    tui_sync_mapped(t, t->file_name);
+  else if (osolen(t->file_name) > 0 && t->file_is_checkpoint)
+    tui_save_checkpoint(t, t->file_name);
+  else if (osolen(t->file_name) > 0)
+    tui_save_text(t, t->file_name, false);
   else
     push_save_as_form("");
 }
@@ -2899,6 +3730,9 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
         case Main_menu_osc:
           push_osc_menu(ged_is_using_osc_udp(&t->ged));
           break;
+        case Main_menu_estimate_cost:
+          push_estimate_cost_msg(&t->ged);
+          break;
         case Main_menu_controls:
           push_controls_msg();
           break;
@@ -2920,6 +3754,9 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
         case Main_menu_save_as:
           push_save_as_form(osoc(t->file_name));
           break;
+        case Main_menu_save_checkpoint:
+          push_save_checkpoint_form(t->file_name, t->file_is_checkpoint);
+          break;
         case Main_menu_set_tempo:
           push_set_tempo_form(t->ged.bpm);
           break;
@@ -2950,6 +3787,7 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           break;
         }
         if (did_get_ok_size) {
+          ged_unmap_field(&t->ged, true);
           ged_resize_grid(&t->ged.field, &t->ged.mbuf_r, new_field_h,
                           new_field_w, t->ged.tick_num, &t->ged.scratch_field,
                           &t->ged.undo_hist, &t->ged.ged_cursor);
@@ -2971,6 +3809,7 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           Usz new_field_h, new_field_w;
           if (tui_suggest_nice_grid_size(t, t->ged.win_h, t->ged.win_w,
                                          &new_field_h, &new_field_w)) {
+            ged_unmap_field(&t->ged, false);
             undo_history_push(&t->ged.undo_hist, &t->ged.field,
                               t->ged.tick_num);
             field_resize_raw(&t->ged.field, new_field_h, new_field_w);
@@ -3097,15 +3936,36 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           expand_home_tilde(&temp_name);
           if (!temp_name)
             break;
-          bool added_hist = undo_history_push(&t->ged.undo_hist, &t->ged.field,
-                                              t->ged.tick_num);
-          Field_load_error fle =
-              field_load_file(osoc(temp_name), &t->ged.field);
-          if (fle == Field_load_error_ok) {
+          Checkpoint_error cke = Checkpoint_error_not_a_checkpoint;
+          Field_load_error fle = Field_load_error_not_mappable;
+          bool added_hist = false;
+          Trace_span span = trace_begin("open file");
+          if (t->use_mmap)
+            fle = ged_map_file(&t->ged, osoc(temp_name));
+          if (fle == Field_load_error_not_mappable) {
+            ged_unmap_field(&t->ged, true);
+            added_hist = undo_history_push(&t->ged.undo_hist, &t->ged.field,
+                                           t->ged.tick_num);
+            cke = ged_load_checkpoint(&t->ged, osoc(temp_name));
+            fle = Field_load_error_ok;
+            if (cke == Checkpoint_error_not_a_checkpoint ||
+                cke == Checkpoint_error_cant_open_file)
+              fle = field_load_file(osoc(temp_name), &t->ged.field);
+          }
+          trace_end(span);
+          char const *load_err = NULL;
+          if (fle != Field_load_error_ok)
+            load_err = field_load_error_string(fle);
+          else if (cke != Checkpoint_error_ok &&
+                   cke != Checkpoint_error_not_a_checkpoint &&
+                   cke != Checkpoint_error_cant_open_file)
+            load_err = checkpoint_error_string(cke);
+          if (!load_err) {
             qnav_stack_pop();
             osoputoso(&t->file_name, temp_name);
+            t->file_is_checkpoint = cke == Checkpoint_error_ok;
             mbuf_reusable_ensure_size(&t->ged.mbuf_r, t->ged.field.height,
-                                      t->ged.field.width);
+                                      t->ged.field.stride);
             ged_cursor_confine(&t->ged.ged_cursor, t->ged.field.height,
                                t->ged.field.width);
             ged_update_internal_geometry(&t->ged);
@@ -3118,7 +3978,7 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
               undo_history_pop(&t->ged.undo_hist, &t->ged.field,
                                &t->ged.tick_num);
             qmsg_printf_push("Error Loading File", "%s:\n%s", osoc(temp_name),
-                             field_load_error_string(fle));
+                             load_err);
           }
           osofree(temp_name);
           break;
@@ -3128,9 +3988,26 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           if (!temp_name)
             break;
           qnav_stack_pop();
-          bool saved_ok = try_save_with_msg(&t->ged.field, temp_name);
-          if (saved_ok)
-            osoputoso(&t->file_name, temp_name);
+          // The new file can't be mapped until it has been written. Until
+          // then, edit a private copy, and switch back to editing in place
+          // when the save finishes.
+          bool was_mapped = t->ged.field_map.addr != NULL;
+          ged_unmap_field(&t->ged, true);
+          tui_save_text(t, temp_name, was_mapped);
+          osoputoso(&t->file_name, temp_name);
+          t->file_is_checkpoint = false;
+          osofree(temp_name);
+          break;
+        }
+        case Save_checkpoint_form_id: {
+          oso *temp_name = qform_get_nonempty_single_line_input(qf);
+          if (!temp_name)
+            break;
+          expand_home_tilde(&temp_name);
+          if (!temp_name)
+            break;
+          qnav_stack_pop();
+          tui_save_checkpoint(t, temp_name);
           osofree(temp_name);
           break;
         }
@@ -3184,6 +4061,7 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
               newwidth < ORCA_X_MAX) {
             if (t->ged.field.height != (Usz)newheight ||
                 t->ged.field.width != (Usz)newwidth) {
+              ged_unmap_field(&t->ged, true);
               ged_resize_grid(&t->ged.field, &t->ged.mbuf_r, (Usz)newheight,
                               (Usz)newwidth, t->ged.tick_num,
                               &t->ged.scratch_field, &t->ged.undo_hist,
@@ -3243,6 +4121,16 @@ enum {
   Argopt_strict_timing,
   Argopt_bpm,
   Argopt_seed,
+  Argopt_event_budget,
+  Argopt_event_rate,
+  Argopt_midi_rate,
+  Argopt_osc_rate,
+  Argopt_udp_rate,
+  Argopt_event_burst,
+  Argopt_mmap,
+  Argopt_timing_file,
+  Argopt_trace,
+  Argopt_metrics_port,
   Argopt_portmidi_deprecated,
   Argopt_osc_deprecated,
 };
@@ -3257,6 +4145,16 @@ int main(int argc, char **argv) {
       {"strict-timing", no_argument, 0, Argopt_strict_timing},
       {"bpm", required_argument, 0, Argopt_bpm},
       {"seed", required_argument, 0, Argopt_seed},
+      {"event-budget", required_argument, 0, Argopt_event_budget},
+      {"event-rate", required_argument, 0, Argopt_event_rate},
+      {"midi-rate", required_argument, 0, Argopt_midi_rate},
+      {"osc-rate", required_argument, 0, Argopt_osc_rate},
+      {"udp-rate", required_argument, 0, Argopt_udp_rate},
+      {"event-burst", required_argument, 0, Argopt_event_burst},
+      {"mmap", no_argument, 0, Argopt_mmap},
+      {"timing-file", required_argument, 0, Argopt_timing_file},
+      {"trace", required_argument, 0, Argopt_trace},
+      {"metrics-port", required_argument, 0, Argopt_metrics_port},
       {"portmidi-list-devices", no_argument, 0, Argopt_portmidi_deprecated},
       {"portmidi-output-device", required_argument, 0,
        Argopt_portmidi_deprecated},
@@ -3265,11 +4163,17 @@ int main(int argc, char **argv) {
       {NULL, 0, NULL, 0}};
   int init_bpm = 120;
   int init_seed = 1;
+  int event_budget = Oguard_default_tick_budget;
+  int event_burst = Oguard_default_burst;
+  int event_rates[Oguard_dest_count] = {
+      Oguard_default_rate, Oguard_default_rate, Oguard_default_rate};
   int init_grid_dim_y = 25, init_grid_dim_x = 57;
   bool explicit_initial_grid_size = false;
+  char const *timing_file = NULL, *trace_file = NULL;
+  int metrics_port = 0;
 
   Tui t = {.file_name = NULL}; // Weird because of clang warning
-  t.undo_history_limit = 100;
+  t.undo_history_limit = (Usz)64 << 20;
   t.softmargin_y = 1;
   t.softmargin_x = 2;
   t.use_gui_cboard = true;
@@ -3302,9 +4206,9 @@ int main(int argc, char **argv) {
         break;
       OPTFAIL("Must be 0 or positive integer.");
     case Argopt_undo_limit:
-      if (read_int(optarg, &t.undo_history_limit) && t.undo_history_limit >= 0)
+      if (read_byte_size(optarg, &t.undo_history_limit))
         break;
-      OPTFAIL("Must be 0 or positive integer.");
+      OPTFAIL("Must be 0 or positive integer, optionally ending in k, m or g.");
     case Argopt_bpm:
       if (read_int(optarg, &init_bpm) && init_bpm >= 1)
         break;
@@ -3313,6 +4217,47 @@ int main(int argc, char **argv) {
       if (read_int(optarg, &init_seed) && init_seed >= 0)
         break;
       OPTFAIL("Must be 0 or positive integer.");
+    case Argopt_event_budget:
+      if (read_int(optarg, &event_budget) && event_budget >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
+    case Argopt_event_rate: {
+      int rate;
+      if (read_int(optarg, &rate) && rate >= 0) {
+        for (Usz i = 0; i < Oguard_dest_count; ++i)
+          event_rates[i] = rate;
+        break;
+      }
+      OPTFAIL("Must be 0 or positive integer.");
+    }
+    case Argopt_midi_rate:
+    case Argopt_osc_rate:
+    case Argopt_udp_rate: {
+      Oguard_dests dest = c == Argopt_midi_rate  ? Oguard_dest_midi
+                          : c == Argopt_osc_rate ? Oguard_dest_osc
+                                                 : Oguard_dest_udp;
+      if (read_int(optarg, &event_rates[dest]) && event_rates[dest] >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
+    }
+    case Argopt_event_burst:
+      if (read_int(optarg, &event_burst) && event_burst >= 1)
+        break;
+      OPTFAIL("Must be positive integer.");
+    case Argopt_mmap:
+      t.use_mmap = true;
+      break;
+    case Argopt_timing_file:
+      timing_file = optarg;
+      break;
+    case Argopt_trace:
+      trace_file = optarg;
+      break;
+    case Argopt_metrics_port:
+      if (read_int(optarg, &metrics_port) && metrics_port >= 1 &&
+          metrics_port <= UINT16_MAX)
+        break;
+      OPTFAIL("Must be a port number from 1 to 65535.");
     case Argopt_init_grid_size:
       if (sscanf(optarg, "%dx%d", &init_grid_dim_x, &init_grid_dim_y) != 2)
         OPTFAIL("Bad format or count. Expected something like: 40x30");
@@ -3353,9 +4298,31 @@ int main(int argc, char **argv) {
     fprintf(stderr, "Expected only 1 file argument.\n");
     exit(1);
   }
+  if (trace_file) {
+    if (!trace_open(trace_file)) {
+      fprintf(stderr, "Couldn't create trace file: %s\n", trace_file);
+      exit(1);
+    }
+    trace_name_thread("main");
+  }
   qnav_init(); // Initialize the menu/navigation global state
   // Initialize the 'Grid EDitor' stuff. This sits underneath the TUI.
-  ged_init(&t.ged, (Usz)t.undo_history_limit, (Usz)init_bpm, (Usz)init_seed);
+  ged_init(&t.ged, t.undo_history_limit, (Usz)init_bpm, (Usz)init_seed);
+  t.ged.io_worker = io_worker_create();
+  if (metrics_port) {
+    t.ged.metrics = metrics_server_start((U16)metrics_port);
+    if (!t.ged.metrics) {
+      fprintf(stderr, "Couldn't listen for metrics on port %d: %s\n",
+              metrics_port, strerror(errno));
+      exit(1);
+    }
+    ged_publish_metrics(&t.ged);
+  }
+  alloc_audit_open_log("orca_alloc_audit.log");
+  double rates[Oguard_dest_count];
+  for (Usz i = 0; i < Oguard_dest_count; ++i)
+    rates[i] = (double)event_rates[i];
+  ged_set_event_limits(&t.ged, (Usz)event_budget, rates, (double)event_burst);
   // This will need to be changed to work with conf/menu
   if (osolen(t.osc_midi_bidule_path) > 0) {
     midi_mode_deinit(&t.ged.midi_mode);
@@ -3404,7 +4371,36 @@ int main(int argc, char **argv) {
 
   bool grid_initialized = false;
   if (osolen(t.file_name)) {
+    if (t.use_mmap) {
+      Field_load_error fle = ged_map_file(&t.ged, osoc(t.file_name));
+      if (fle == Field_load_error_ok) {
+        grid_initialized = true;
+        goto grid_loaded;
+      }
+      if (fle != Field_load_error_not_mappable &&
+          fle != Field_load_error_cant_open_file) {
+        qmsg_printf_push("File Load Error", "File load error:\n%s.",
+                         field_load_error_string(fle));
+        goto grid_loaded;
+      }
+    }
+    Trace_span span = trace_begin("load checkpoint");
+    Checkpoint_error cke = ged_load_checkpoint(&t.ged, osoc(t.file_name));
+    trace_end(span);
+    if (cke == Checkpoint_error_ok) {
+      grid_initialized = true;
+      t.file_is_checkpoint = true;
+      goto grid_loaded;
+    }
+    if (cke != Checkpoint_error_not_a_checkpoint &&
+        cke != Checkpoint_error_cant_open_file) {
+      qmsg_printf_push("Checkpoint Load Error", "Checkpoint load error:\n%s.",
+                       checkpoint_error_string(cke));
+      goto grid_loaded;
+    }
+    span = trace_begin("load file");
     Field_load_error fle = field_load_file(osoc(t.file_name), &t.ged.field);
+    trace_end(span);
     switch (fle) {
     case Field_load_error_ok:
       if (t.ged.field.height < 1 || t.ged.field.width < 1) {
@@ -3431,6 +4427,7 @@ int main(int argc, char **argv) {
       break;
     }
   }
+grid_loaded:
   // If we haven't yet initialized the grid, because we were waiting for the
   // terminal size, do it now.
   if (!grid_initialized) {
@@ -3444,7 +4441,7 @@ int main(int argc, char **argv) {
     field_init_fill(&t.ged.field, (Usz)new_field_h, (Usz)new_field_w, '.');
   }
   mbuf_reusable_ensure_size(&t.ged.mbuf_r, t.ged.field.height,
-                            t.ged.field.width);
+                            t.ged.field.stride);
   ged_make_cursor_visible(&t.ged);
   ged_send_osc_bpm(&t.ged, (I32)t.ged.bpm); // Send initial BPM
   ged_set_playing(&t.ged, true);            // Auto-play
@@ -3459,16 +4456,25 @@ event_loop:;
   case ERR: { // ERR indicates no more events.
     ged_do_stuff(&t.ged);
     bool drew_any = false;
+    U64 draw_start = stm_now();
     if (ged_is_draw_dirty(&t.ged) || qnav_stack.occlusion_dirty) {
+      Trace_span span = trace_begin("ged_draw");
       werase(cont_window);
       ged_draw(&t.ged, cont_window, osoc(t.file_name), t.fancy_grid_dots,
                t.fancy_grid_rulers);
       wnoutrefresh(cont_window);
+      trace_end(span);
       drew_any = true;
     }
     drew_any |= qnav_draw(); // clears qnav_stack.occlusion_dirty
-    if (drew_any)
+    if (drew_any) {
+      Trace_span span = trace_begin("doupdate");
       doupdate();
+      trace_end(span);
+      hdr_hist_record(&t.ged.draw_time, (U64)stm_ns(stm_since(draw_start)));
+    }
+    ged_sync_mapped_field(&t.ged);
+    tui_finish_io_jobs(&t);
     double secs_to_d = ged_secs_to_deadline(&t.ged);
 #define DEADTIME(_millisecs, _new_timeout)                                     \
   else if (secs_to_d < ms_to_sec(_millisecs)) new_timeout = _new_timeout;
@@ -3513,9 +4519,6 @@ event_loop:;
     if (new_timeout != cur_timeout) {
       wtimeout(stdscr, new_timeout);
       cur_timeout = new_timeout;
-#if TIME_DEBUG
-      spin_track_timeout = cur_timeout;
-#endif
     }
     goto event_loop;
   }
@@ -3593,7 +4596,8 @@ event_loop:;
         if (brackpaste_y < t.ged.field.height &&
             brackpaste_x < t.ged.field.width) {
           gbuffer_poke(t.ged.field.buffer, t.ged.field.height,
-                       t.ged.field.width, brackpaste_y, brackpaste_x, cleaned);
+                       t.ged.field.width, t.ged.field.stride, brackpaste_y,
+                       brackpaste_x, cleaned);
           // Could move this out one level if we wanted the final selection
           // size to reflect even the pasted area which didn't fit on the
           // grid.
@@ -3631,6 +4635,9 @@ event_loop:;
   case CTRL_PLUS('u'):
     ged_input_cmd(&t.ged, Ged_input_cmd_undo);
     break;
+  case CTRL_PLUS('y'):
+    ged_input_cmd(&t.ged, Ged_input_cmd_redo);
+    break;
   case CTRL_PLUS('r'):
     t.ged.tick_num = 0;
     t.ged.needs_remarking = true;
@@ -3687,6 +4694,15 @@ event_loop:;
   case CTRL_PLUS('e'):
     ged_input_cmd(&t.ged, Ged_input_cmd_toggle_show_event_list);
     break;
+  case CTRL_PLUS('t'):
+    ged_input_cmd(&t.ged, Ged_input_cmd_toggle_show_timing);
+    break;
+  case CTRL_PLUS('p'):
+    ged_input_cmd(&t.ged, Ged_input_cmd_toggle_show_profile);
+    break;
+  case CTRL_PLUS('w'):
+    ged_input_cmd(&t.ged, Ged_input_cmd_cycle_heatmap);
+    break;
   case CTRL_PLUS('x'):
     ged_input_cmd(&t.ged, Ged_input_cmd_cut);
     try_send_to_gui_clipboard(&t.ged, &t.use_gui_cboard);
@@ -3697,12 +4713,15 @@ event_loop:;
     break;
   case CTRL_PLUS('v'):
     if (t.use_gui_cboard) {
-      bool added_hist =
-          undo_history_push(&t.ged.undo_hist, &t.ged.field, t.ged.tick_num);
+      // The paste can only reach from the cursor to the bottom right.
+      bool added_hist = undo_history_push_rect(
+          &t.ged.undo_hist, &t.ged.field, t.ged.tick_num, t.ged.ged_cursor.y,
+          t.ged.ged_cursor.x, t.ged.field.height, t.ged.field.width);
       Usz pasted_h, pasted_w;
       Cboard_error cberr = cboard_paste(
           t.ged.field.buffer, t.ged.field.height, t.ged.field.width,
-          t.ged.ged_cursor.y, t.ged.ged_cursor.x, &pasted_h, &pasted_w);
+          t.ged.field.stride, t.ged.ged_cursor.y, t.ged.ged_cursor.x,
+          &pasted_h, &pasted_w);
       if (cberr) {
         if (added_hist)
           undo_history_pop(&t.ged.undo_hist, &t.ged.field, &t.ged.tick_num);
@@ -3738,7 +4757,9 @@ event_loop:;
     // handle. Such as bracketed paste.
     if (brackpaste_seq_getungetch(stdscr) == Brackpaste_seq_begin) {
       is_in_brackpaste = true;
-      undo_history_push(&t.ged.undo_hist, &t.ged.field, t.ged.tick_num);
+      undo_history_push_rect(&t.ged.undo_hist, &t.ged.field, t.ged.tick_num,
+                             t.ged.ged_cursor.y, t.ged.ged_cursor.x,
+                             t.ged.field.height, t.ged.field.width);
       brackpaste_y = t.ged.ged_cursor.y;
       brackpaste_x = t.ged.ged_cursor.x;
       brackpaste_starting_x = brackpaste_x;
@@ -3860,6 +4881,42 @@ quit:
 #endif
   printf("\033[?2004h\n"); // Tell terminal to not use bracketed paste
   endwin();
+  // Let any saves that are still in progress finish. The message UI is gone,
+  // so only errors are reported.
+  io_worker_wait_idle(t.ged.io_worker);
+  for (Io_job *io; (io = io_worker_pop_done(t.ged.io_worker));) {
+    Tui_io_job *job = (Tui_io_job *)io;
+    if (!job->ok) {
+      char buf[1024];
+      char const *title;
+      tui_io_job_describe(job, &title, buf, sizeof buf);
+      fprintf(stderr, "%s: %s\n", title, buf);
+    }
+    tui_io_job_free(io);
+  }
+  io_worker_destroy(t.ged.io_worker, NULL);
+  t.ged.io_worker = NULL;
+  if (t.ged.metrics)
+    metrics_server_stop(t.ged.metrics);
+  t.ged.metrics = NULL;
+  // The I/O worker has stopped, so its spans can be written too.
+  if (!trace_close())
+    fprintf(stderr, "Error writing trace file: %s\n", trace_file);
+  {
+    Usz suppressed = oguard_suppressed_count(&t.ged.oguard);
+    if (suppressed > 0)
+      fprintf(stderr, "%zu output events were dropped by the event limits.\n",
+              suppressed);
+  }
+#ifdef FEAT_ALLOC_AUDIT
+  if (t.ged.audited_heap_calls > 0)
+    fprintf(stderr,
+            "%zu heap calls were made by ticks. See orca_alloc_audit.log.\n",
+            t.ged.audited_heap_calls);
+#endif
+  alloc_audit_close_log();
+  if (timing_file && !ged_write_timing_file(&t.ged, timing_file))
+    fprintf(stderr, "Error writing timing file: %s\n", timing_file);
   ged_deinit(&t.ged);
   osofree(t.file_name);
   osofree(t.osc_address);
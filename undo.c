@@ -0,0 +1,344 @@
+#include "undo.h"
+#include <stddef.h>
+
+struct Undo_node {
+  struct Undo_node *prev, *next;
+  Usz tick_num;
+  Usz size; // Bytes used by this node, including the header
+  U16 grid_h, grid_w, y, x, h, w;
+  U8 rle[];
+};
+
+// Each row is encoded separately, as a list of chunks. A header byte below 128
+// is followed by that many plus one literal glyphs. A header byte of 128 or
+// more is followed by a single glyph which is repeated (header - 125) times.
+enum {
+  Undo_rle_max_literal = 128,
+  Undo_rle_min_run = 3,
+  Undo_rle_max_run = 255 - 125,
+};
+
+static Usz undo_rle_bound(Usz h, Usz w) {
+  return h * (w + (w + Undo_rle_max_literal - 1) / Undo_rle_max_literal);
+}
+
+static Usz undo_rle_encode(Glyph const *gbuf, Usz stride, Usz y, Usz x, Usz h,
+                           Usz w, U8 *out) {
+  U8 *o = out;
+  for (Usz iy = 0; iy < h; ++iy) {
+    Glyph const *row = gbuf + (y + iy) * stride + x;
+    Usz i = 0, lit_start = 0;
+    while (i < w) {
+      Usz run = 1;
+      while (i + run < w && run < Undo_rle_max_run && row[i + run] == row[i])
+        ++run;
+      if (run < Undo_rle_min_run && i + run < w) {
+        i += run;
+        continue;
+      }
+      if (run < Undo_rle_min_run)
+        i += run; // End of the row, so these go in the last literal chunk
+      while (lit_start < i) {
+        Usz n = i - lit_start;
+        if (n > Undo_rle_max_literal)
+          n = Undo_rle_max_literal;
+        *o++ = (U8)(n - 1);
+        memcpy(o, row + lit_start, n);
+        o += n;
+        lit_start += n;
+      }
+      if (run >= Undo_rle_min_run) {
+        *o++ = (U8)(run + 125);
+        *o++ = (U8)row[i];
+        i += run;
+        lit_start = i;
+      }
+    }
+  }
+  return (Usz)(o - out);
+}
+
+static void undo_rle_decode(U8 const *in, Glyph *gbuf, Usz stride, Usz y, Usz x,
+                            Usz h, Usz w) {
+  for (Usz iy = 0; iy < h; ++iy) {
+    Glyph *row = gbuf + (y + iy) * stride + x;
+    Usz i = 0;
+    while (i < w) {
+      U8 hdr = *in++;
+      if (hdr < Undo_rle_max_literal) {
+        Usz n = (Usz)hdr + 1;
+        memcpy(row + i, in, n);
+        in += n;
+        i += n;
+      } else {
+        Usz n = (Usz)hdr - 125;
+        memset(row + i, *in++, n);
+        i += n;
+      }
+    }
+  }
+}
+
+// Saves the rectangle from the field into a new node. Returns NULL if the
+// rectangle is empty.
+static Undo_node *undo_node_create(Field const *field, Usz tick_num, Usz y,
+                                   Usz x, Usz h, Usz w) {
+  Usz field_h = field->height, field_w = field->width;
+  if (y >= field_h || x >= field_w)
+    return NULL;
+  if (h > field_h - y)
+    h = field_h - y;
+  if (w > field_w - x)
+    w = field_w - x;
+  if (h == 0 || w == 0)
+    return NULL;
+  Undo_node *node = malloc(offsetof(Undo_node, rle) + undo_rle_bound(h, w));
+  Usz rle_size =
+      undo_rle_encode(field->buffer, field->stride, y, x, h, w, node->rle);
+  node->size = offsetof(Undo_node, rle) + rle_size;
+  node = realloc(node, node->size);
+  node->prev = node->next = NULL;
+  node->tick_num = tick_num;
+  node->grid_h = (U16)field_h;
+  node->grid_w = (U16)field_w;
+  node->y = (U16)y;
+  node->x = (U16)x;
+  node->h = (U16)h;
+  node->w = (U16)w;
+  return node;
+}
+
+// Puts the node's glyphs back into the field, resizing it first if the node
+// is from a grid of a different size. (Nodes like that always cover the whole
+// grid.)
+static void undo_node_restore(Undo_node const *node, Field *field,
+                              Usz *out_tick_num) {
+  if (field->height != node->grid_h || field->width != node->grid_w)
+    field_resize_raw(field, node->grid_h, node->grid_w);
+  undo_rle_decode(node->rle, field->buffer, field->stride, node->y, node->x,
+                  node->h, node->w);
+  *out_tick_num = node->tick_num;
+}
+
+// Saves what the node would overwrite, so that restoring the node can be
+// reversed.
+static Undo_node *undo_node_create_inverse(Undo_node const *node,
+                                           Field const *field, Usz tick_num) {
+  if (field->height != node->grid_h || field->width != node->grid_w)
+    return undo_node_create(field, tick_num, 0, 0, field->height, field->width);
+  return undo_node_create(field, tick_num, node->y, node->x, node->h, node->w);
+}
+
+void undo_history_init(Undo_history *hist, Usz limit) {
+  *hist = (Undo_history){0};
+  hist->limit = limit;
+}
+
+static void undo_history_clear_redo(Undo_history *hist) {
+  Undo_node *a = hist->redo;
+  while (a) {
+    Undo_node *b = a->next;
+    free(a);
+    a = b;
+  }
+  hist->bytes -= hist->redo_bytes;
+  hist->redo = hist->redo_last = NULL;
+  hist->redo_bytes = 0;
+}
+
+void undo_history_clear(Undo_history *hist) {
+  undo_history_clear_redo(hist);
+  Undo_node *a = hist->first;
+  while (a) {
+    Undo_node *b = a->next;
+    free(a);
+    a = b;
+  }
+  hist->first = hist->last = NULL;
+  hist->count = 0;
+  hist->bytes = 0;
+}
+
+void undo_history_deinit(Undo_history *hist) { undo_history_clear(hist); }
+
+static void undo_history_drop_oldest(Undo_history *hist) {
+  Undo_node *node = hist->first;
+  hist->first = node->next;
+  if (hist->first)
+    hist->first->prev = NULL;
+  else
+    hist->last = NULL;
+  hist->bytes -= node->size;
+  --hist->count;
+  free(node);
+}
+
+static void undo_history_drop_furthest_redo(Undo_history *hist) {
+  Undo_node *node = hist->redo_last;
+  hist->redo_last = node->prev;
+  if (hist->redo_last)
+    hist->redo_last->next = NULL;
+  else
+    hist->redo = NULL;
+  hist->bytes -= node->size;
+  hist->redo_bytes -= node->size;
+  free(node);
+}
+
+// Drops entries until the limit is met, from the stack using more of it, but
+// never `keep`.
+static void undo_history_trim(Undo_history *hist, Undo_node const *keep) {
+  while (hist->bytes > hist->limit) {
+    bool can_drop_undo = hist->first && hist->first != keep;
+    bool can_drop_redo = hist->redo_last && hist->redo_last != keep;
+    if (can_drop_undo &&
+        (!can_drop_redo || hist->bytes - hist->redo_bytes >= hist->redo_bytes))
+      undo_history_drop_oldest(hist);
+    else if (can_drop_redo)
+      undo_history_drop_furthest_redo(hist);
+    else
+      break;
+  }
+}
+
+static void undo_history_append(Undo_history *hist, Undo_node *node) {
+  node->next = NULL;
+  node->prev = hist->last;
+  if (hist->last)
+    hist->last->next = node;
+  else
+    hist->first = node;
+  hist->last = node;
+  hist->bytes += node->size;
+  ++hist->count;
+  undo_history_trim(hist, node);
+}
+
+static Undo_node *undo_history_take_last(Undo_history *hist) {
+  Undo_node *node = hist->last;
+  hist->last = node->prev;
+  if (hist->last)
+    hist->last->next = NULL;
+  else
+    hist->first = NULL;
+  hist->bytes -= node->size;
+  --hist->count;
+  return node;
+}
+
+static void undo_history_push_redo(Undo_history *hist, Undo_node *node) {
+  node->prev = NULL;
+  node->next = hist->redo;
+  if (hist->redo)
+    hist->redo->prev = node;
+  else
+    hist->redo_last = node;
+  hist->redo = node;
+  hist->bytes += node->size;
+  hist->redo_bytes += node->size;
+  undo_history_trim(hist, node);
+}
+
+static Undo_node *undo_history_take_redo(Undo_history *hist) {
+  Undo_node *node = hist->redo;
+  hist->redo = node->next;
+  if (hist->redo)
+    hist->redo->prev = NULL;
+  else
+    hist->redo_last = NULL;
+  hist->bytes -= node->size;
+  hist->redo_bytes -= node->size;
+  return node;
+}
+
+bool undo_history_push_rect(Undo_history *hist, Field const *field,
+                            Usz tick_num, Usz y, Usz x, Usz h, Usz w) {
+  if (hist->limit == 0)
+    return false;
+  Undo_node *node = undo_node_create(field, tick_num, y, x, h, w);
+  if (!node)
+    return false;
+  undo_history_clear_redo(hist);
+  if (node->size > hist->limit) {
+    // Older entries can't be undone without this one, so they're useless.
+    undo_history_clear(hist);
+    free(node);
+    return false;
+  }
+  undo_history_append(hist, node);
+  return true;
+}
+
+bool undo_history_push(Undo_history *hist, Field const *field, Usz tick_num) {
+  return undo_history_push_rect(hist, field, tick_num, 0, 0, field->height,
+                                field->width);
+}
+
+void undo_history_pop(Undo_history *hist, Field *out_field,
+                      Usz *out_tick_num) {
+  if (!hist->last)
+    return;
+  Undo_node *node = undo_history_take_last(hist);
+  undo_node_restore(node, out_field, out_tick_num);
+  free(node);
+}
+
+void undo_history_apply(Undo_history *hist, Field *out_field,
+                        Usz *out_tick_num) {
+  if (!hist->last)
+    return;
+  undo_node_restore(hist->last, out_field, out_tick_num);
+}
+
+void undo_history_undo(Undo_history *hist, Field *field, Usz *io_tick_num) {
+  if (!hist->last)
+    return;
+  Undo_node *node = undo_history_take_last(hist);
+  Undo_node *inverse = undo_node_create_inverse(node, field, *io_tick_num);
+  undo_node_restore(node, field, io_tick_num);
+  free(node);
+  if (!inverse)
+    return;
+  if (inverse->size > hist->limit) {
+    // Can't be kept, and the redo entries after it are useless without it.
+    undo_history_clear_redo(hist);
+    free(inverse);
+    return;
+  }
+  undo_history_push_redo(hist, inverse);
+}
+
+void undo_history_redo(Undo_history *hist, Field *field, Usz *io_tick_num) {
+  if (!hist->redo)
+    return;
+  Undo_node *node = undo_history_take_redo(hist);
+  Undo_node *inverse = undo_node_create_inverse(node, field, *io_tick_num);
+  undo_node_restore(node, field, io_tick_num);
+  free(node);
+  if (!inverse)
+    return;
+  if (inverse->size > hist->limit) {
+    // The undo entries before it are useless without it.
+    while (hist->first)
+      undo_history_drop_oldest(hist);
+    free(inverse);
+    return;
+  }
+  undo_history_append(hist, inverse);
+}
+
+Usz undo_history_count(Undo_history const *hist) { return hist->count; }
+bool undo_history_can_redo(Undo_history const *hist) {
+  return hist->redo != NULL;
+}
+
+static bool undo_node_resizes(Undo_node const *node, Field const *field) {
+  return node &&
+         (field->height != node->grid_h || field->width != node->grid_w);
+}
+bool undo_history_undo_resizes(Undo_history const *hist, Field const *field) {
+  return undo_node_resizes(hist->last, field);
+}
+bool undo_history_redo_resizes(Undo_history const *hist, Field const *field) {
+  return undo_node_resizes(hist->redo, field);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "base.h"
+#include "field.h"
+
+// Undo entries don't hold a copy of the whole grid. Each one holds the glyphs
+// of the rectangle that an edit is about to change, as they were before the
+// edit, run-length encoded. Typing a character saves a single cell, so it
+// costs the same on any size of grid. Edits that change the size of the grid
+// (or replace it) save all of it, along with the old size.
+//
+// Undoing an entry first saves the rectangle as it is now into a new entry on
+// the redo stack, then restores the old glyphs. Redoing does the same thing in
+// the other direction. Entries only hold plain glyphs, not deltas against the
+// next state, because the VM keeps changing the grid between edits while it's
+// playing.
+//
+// The limit is the number of bytes used by all of the entries, on both
+// stacks. When it's gone over, entries are dropped from the far end of
+// whichever stack is using more of it: the oldest undo entries, or the redo
+// entries furthest from the current state.
+
+typedef struct Undo_node Undo_node;
+
+typedef struct {
+  Undo_node *first, *last; // Undo stack, oldest first
+  // Redo stack, linked by `next` from newest to furthest, and by `prev` back
+  Undo_node *redo, *redo_last;
+  Usz count, bytes, limit;
+  Usz redo_bytes; // The part of `bytes` used by the redo stack
+} Undo_history;
+
+void undo_history_init(Undo_history *hist, Usz limit);
+void undo_history_clear(Undo_history *hist);
+void undo_history_deinit(Undo_history *hist);
+// Call this before an edit which only changes glyphs inside of the rectangle.
+// The rectangle is clipped to the field. Returns false if nothing was saved.
+bool undo_history_push_rect(Undo_history *hist, Field const *field,
+                            Usz tick_num, Usz y, Usz x, Usz h, Usz w);
+// Saves the whole grid. Call this before resizing or replacing it.
+bool undo_history_push(Undo_history *hist, Field const *field, Usz tick_num);
+// Restores the most recent entry and discards it, without making a redo entry.
+// Used to back out of an edit that failed.
+void undo_history_pop(Undo_history *hist, Field *out_field, Usz *out_tick_num);
+// Restores the most recent entry, but keeps it. While the VM is running, this
+// can be used to keep going back to the same state.
+void undo_history_apply(Undo_history *hist, Field *out_field,
+                        Usz *out_tick_num);
+void undo_history_undo(Undo_history *hist, Field *field, Usz *io_tick_num);
+void undo_history_redo(Undo_history *hist, Field *field, Usz *io_tick_num);
+Usz undo_history_count(Undo_history const *hist);
+bool undo_history_can_redo(Undo_history const *hist);
+// True if undoing (or applying) or redoing would change the size of the grid.
+// A field viewing a mapped file can't be resized, so it has to be unmapped
+// before then.
+bool undo_history_undo_resizes(Undo_history const *hist, Field const *field);
+bool undo_history_redo_resizes(Undo_history const *hist, Field const *field);
@@ -3,31 +3,89 @@
 void oevent_list_init(Oevent_list *olist) {
   olist->buffer = NULL;
   olist->count = 0;
+  olist->size = 0;
   olist->capacity = 0;
+  olist->count_limit = SIZE_MAX;
+  olist->dropped_count = 0;
+  olist->arena = NULL;
+}
+void oevent_list_deinit(Oevent_list *olist) {
+  if (!olist->arena)
+    free(olist->buffer);
+}
+void oevent_list_use_arena(Oevent_list *olist, Arena *arena) {
+  if (!olist->arena)
+    free(olist->buffer);
+  olist->buffer = NULL;
+  olist->capacity = 0;
+  olist->arena = arena;
+  oevent_list_clear(olist);
+}
+static void oevent_list_set_capacity(Oevent_list *olist, Usz capacity) {
+  if (olist->arena) {
+    U8 *buffer = arena_alloc(olist->arena, capacity);
+    if (olist->size > 0)
+      memcpy(buffer, olist->buffer, olist->size);
+    olist->buffer = buffer;
+  } else {
+    olist->buffer = realloc(olist->buffer, capacity);
+  }
+  olist->capacity = capacity;
+}
+void oevent_list_clear(Oevent_list *olist) {
+  olist->count = 0;
+  olist->size = 0;
+  olist->dropped_count = 0;
 }
-void oevent_list_deinit(Oevent_list *olist) { free(olist->buffer); }
-void oevent_list_clear(Oevent_list *olist) { olist->count = 0; }
 void oevent_list_copy(Oevent_list const *src, Oevent_list *dest) {
-  Usz src_count = src->count;
-  if (dest->capacity < src_count) {
-    Usz new_cap = orca_round_up_power2(src_count);
-    dest->buffer = realloc(dest->buffer, new_cap * sizeof(Oevent));
-    dest->capacity = new_cap;
+  Usz src_size = src->size;
+  if (dest->capacity < src_size) {
+    dest->size = 0;
+    oevent_list_set_capacity(dest, orca_round_up_power2(src_size));
   }
-  memcpy(dest->buffer, src->buffer, src_count * sizeof(Oevent));
-  dest->count = src_count;
+  if (src_size > 0)
+    memcpy(dest->buffer, src->buffer, src_size);
+  dest->count = src->count;
+  dest->size = src_size;
+}
+void oevent_list_reserve(Oevent_list *olist, Usz size) {
+  if (olist->capacity >= size)
+    return;
+  oevent_list_set_capacity(olist, orca_round_up_power2(size));
 }
-Oevent *oevent_list_alloc_item(Oevent_list *olist) {
-  Usz count = olist->count;
-  if (olist->capacity == count) {
+Oevent *oevent_list_alloc_item(Oevent_list *olist, Usz size) {
+  assert(size > 0 && size <= Oevent_max_size);
+  if (olist->count >= olist->count_limit) {
+    ++olist->dropped_count;
+    return NULL;
+  }
+  Usz old_size = olist->size;
+  Usz new_size = old_size + size;
+  if (olist->capacity < new_size) {
     // Note: no overflow check, but you're probably out of memory if this
     // happens anyway. Like other uses of realloc in orca, we also don't check
     // for a failed allocation.
-    Usz capacity = count < 16 ? 16 : orca_round_up_power2(count + 1);
-    olist->buffer = realloc(olist->buffer, capacity * sizeof(Oevent));
-    olist->capacity = capacity;
+    oevent_list_set_capacity(
+        olist, new_size < 256 ? 256 : orca_round_up_power2(new_size));
   }
-  Oevent *result = olist->buffer + count;
-  olist->count = count + 1;
+  Oevent *result = (Oevent *)(void *)(olist->buffer + old_size);
+  olist->size = new_size;
+  olist->count++;
   return result;
 }
+
+char const *oevent_type_name(Oevent_types type) {
+  switch (type) {
+  case Oevent_type_midi_note:
+    return "MIDI note";
+  case Oevent_type_midi_cc:
+    return "MIDI CC";
+  case Oevent_type_midi_pb:
+    return "MIDI PB";
+  case Oevent_type_osc_ints:
+    return "OSC";
+  case Oevent_type_udp_string:
+    return "UDP";
+  }
+  return "?";
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include "arena.h"
 #include "base.h"
+#include <stddef.h> // offsetof
 
 typedef enum {
   Oevent_type_midi_note,
@@ -9,6 +11,11 @@ typedef enum {
   Oevent_type_udp_string,
 } Oevent_types;
 
+enum { Oevent_type_count = 5 };
+
+// A short name for display, like "MIDI note".
+char const *oevent_type_name(Oevent_types type);
+
 typedef struct {
   U8 oevent_type;
 } Oevent_any;
@@ -54,15 +61,98 @@ typedef union {
   Oevent_udp_string udp_string;
 } Oevent;
 
+// The largest size an encoded event can be. (An OSC event with the maximum
+// number of ints.)
+enum { Oevent_max_size = sizeof(Oevent) };
+
+// Oevent_list is a packed stream of variable-length events. Each event only
+// takes up as many bytes as its type needs: a MIDI CC is 4 bytes, while an OSC
+// event is 3 bytes plus 1 for each int. All of the event structs are made only
+// of byte-sized fields, so they can be placed at any byte offset without
+// alignment concerns. Use Oevent_iter to walk through the events, and
+// oevent_size() to find out how much space one takes up.
+//
+// The Oevent union is still used as the type for a single event, but only the
+// first oevent_size() bytes of an event in the list are valid.
+//
+// `count_limit` caps the number of events the list will accept, so that a
+// runaway patch can't make it grow without bound. It defaults to no limit.
+// Events that don't fit are counted in `dropped_count` instead, which is reset
+// by oevent_list_clear().
+//
+// The buffer normally comes from the heap. oevent_list_use_arena() makes it
+// come from an Arena instead, so that a list which is refilled every tick
+// doesn't need any heap calls to grow.
 typedef struct {
-  Oevent *buffer;
-  Usz count, capacity;
+  U8 *buffer;
+  Usz count;          // Number of events
+  Usz size, capacity; // In bytes
+  Usz count_limit, dropped_count;
+  Arena *arena; // NULL if the buffer is on the heap
 } Oevent_list;
 
 void oevent_list_init(Oevent_list *olist);
+// Empties the list and makes it take its memory from `arena` from now on.
+// The buffer becomes invalid when the arena is reset, so this has to be
+// called again after each reset. `count_limit` is kept.
+void oevent_list_use_arena(Oevent_list *olist, Arena *arena);
 void oevent_list_deinit(Oevent_list *olist);
 void oevent_list_clear(Oevent_list *olist);
 ORCA_NOINLINE
 void oevent_list_copy(Oevent_list const *src, Oevent_list *dest);
+// Grows the capacity up front so that at least `size` bytes of events can be
+// added with `oevent_list_alloc_item()` without it needing to call `realloc`.
+// Used by code that needs to run `orca_run()` without touching the heap.
+// `event_count * Oevent_max_size` is always enough for `event_count` events.
+void oevent_list_reserve(Oevent_list *olist, Usz size);
+// `size` is the encoded size of the event that will be written, as it will be
+// returned by oevent_size() after it's filled in. Returns NULL if the list
+// already holds `count_limit` events.
 ORCA_NOINLINE
-Oevent *oevent_list_alloc_item(Oevent_list *olist);
+Oevent *oevent_list_alloc_item(Oevent_list *olist, Usz size);
+
+static inline Usz oevent_size(Oevent const *ev) {
+  switch ((Oevent_types)ev->any.oevent_type) {
+  case Oevent_type_midi_note:
+    return sizeof(Oevent_midi_note);
+  case Oevent_type_midi_cc:
+    return sizeof(Oevent_midi_cc);
+  case Oevent_type_midi_pb:
+    return sizeof(Oevent_midi_pb);
+  case Oevent_type_osc_ints:
+    return offsetof(Oevent_osc_ints, numbers) + ev->osc_ints.count;
+  case Oevent_type_udp_string:
+    return offsetof(Oevent_udp_string, chars) + ev->udp_string.count;
+  }
+  assert(false);
+  return sizeof(Oevent_any);
+}
+
+typedef struct {
+  U8 const *pos, *end;
+} Oevent_iter;
+
+static inline void oevent_iter_init(Oevent_iter *it, Oevent_list const *olist) {
+  it->pos = olist->buffer;
+  it->end = olist->buffer + olist->size;
+}
+
+// Iterates over the events within the byte offsets [begin, end) of the list.
+// The offsets must be on event boundaries, such as those recorded by
+// orca_run_ticks().
+static inline void oevent_iter_init_range(Oevent_iter *it,
+                                          Oevent_list const *olist, Usz begin,
+                                          Usz end) {
+  assert(begin <= end && end <= olist->size);
+  it->pos = olist->buffer + begin;
+  it->end = olist->buffer + end;
+}
+
+// Returns NULL when there are no more events.
+static inline Oevent const *oevent_iter_next(Oevent_iter *it) {
+  if (it->pos == it->end)
+    return NULL;
+  Oevent const *ev = (Oevent const *)(void const *)it->pos;
+  it->pos += oevent_size(ev);
+  return ev;
+}